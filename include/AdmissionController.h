@@ -0,0 +1,61 @@
+/**
+ * @file
+ * @brief token bucket that limits call admission rate
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+namespace ddgen {
+
+/**
+ * @brief Call admission controller
+ *
+ * Tokens are added at requested calls per second rate and a call can only be created by taking a token.
+ * Bucket holds at most burst tokens, so that calls are admitted in small batches every tick instead of a
+ * large batch after an idle period. Time is given by caller, so that same controller works on wall clock
+ * and on virtual clock of offline mode.
+ */
+class AdmissionController
+{
+public:
+    /**
+     * @brief Constructor, bucket starts full
+     *
+     * @param callsPerSecond INPUT requested call admission rate
+     * @param burst INPUT maximum number of calls that can be admitted at once, at least 1
+     */
+    AdmissionController(unsigned int callsPerSecond, unsigned int burst);
+
+    /**
+     * @brief Take as many tokens as possible up to requested number of calls
+     *
+     * @param now INPUT current time in usec, should not decrease between calls
+     * @param numberOfCalls INPUT number of calls that caller wants to create
+     * @return number of calls that can be created now
+     */
+    unsigned int Acquire(unsigned long long int now, unsigned int numberOfCalls);
+
+    unsigned int GetCallsPerSecond() const
+    {
+        return _callsPerSecond;
+    }
+
+    /**
+     * @brief Total number of calls admitted so far
+     */
+    unsigned long long int GetAdmittedCalls() const
+    {
+        return _admittedCalls;
+    }
+
+private:
+    const unsigned int _callsPerSecond;
+    const unsigned long long int _capacity; /**< bucket size in micro tokens */
+    unsigned long long int _tokens;         /**< available tokens, scaled by 1e6 to stay in integer arithmetic */
+    unsigned long long int _lastTime;       /**< time of last refill in usec */
+    unsigned long long int _admittedCalls;
+};
+
+} // namespace ddgen
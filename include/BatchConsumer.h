@@ -0,0 +1,64 @@
+/**
+ * @file
+ * @brief consumer that collects packets of a tick and hands them over as a single batch
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include "Clock.h"
+#include "consumer.h"
+
+#include <memory>
+#include <vector>
+
+namespace ddgen {
+
+#define BATCH_BUFFER_SIZE (1 << 18) /**< packets of a batch are built in a 256KB buffer, a full buffer is handed over early */
+
+/**
+ * @brief Consumer that collects packets and hands them to its consumer with a single ConsumeBatch() at Flush()
+ *
+ * Packets are written in place into buffer of batch and stamped with time they are committed at, so that per packet
+ * cost of consumer (a system call in particular) is paid once per tick instead of once per packet. A batch consumer is
+ * used by a single thread.
+ */
+class BatchConsumer : public IConsumer
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param consumer INPUT consumer that batches are handed to
+     * @param clock INPUT clock that packets are stamped with, system clock is used if omitted
+     */
+    explicit BatchConsumer(const std::shared_ptr<IConsumer>& consumer, const std::shared_ptr<IClock>& clock = nullptr);
+
+    /**
+     * @brief Destructor, hands over packets that are not flushed yet
+     */
+    ~BatchConsumer();
+
+    virtual bool Consume(const unsigned char* data_ptr, unsigned short int data_size);
+
+    virtual unsigned char* Acquire(unsigned short int data_size);
+
+    virtual bool Commit(unsigned short int data_size);
+
+    virtual bool Flush();
+
+    std::size_t GetNumberOfPackets() const
+    {
+        return _packets.size();
+    }
+
+private:
+    const std::shared_ptr<IConsumer> _consumer;
+    const std::shared_ptr<IClock> _clock;
+    std::unique_ptr<unsigned char[]> _buffer; /**< packets of batch, back to back */
+    std::size_t _bufferUsed;
+    std::vector<PacketDescriptor> _packets;
+};
+
+} // namespace ddgen
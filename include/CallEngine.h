@@ -0,0 +1,295 @@
+/**
+ * @file
+ * @brief multi threaded call engine, calls are sharded over worker threads
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include "BatchConsumer.h"
+#include "Clock.h"
+#include "ConsumerFactory.h"
+#include "EncodeBatcher.h"
+#include "PacketSchedule.h"
+#include "TimingWheel.h"
+#include "Transmitter.h"
+#include "WorkStealingPool.h"
+#include "callleg.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ddgen {
+
+#define TICK_DURATION 20       /**< Default tick duration is 20ms */
+#define PACING_TICK_DURATION 1 /**< Tick duration is 1ms when packets are paced */
+#define OVERLOAD_THRESHOLD 20  /**< A packet is late if it is sent more than 20ms after its deadline */
+
+/**
+ * @brief A shard of calls that is stepped by its own worker thread.
+ *
+ * Shard owns its calls and its consumer, nothing is shared with other shards.
+ * The only entry point from other threads is Admit(), that hands a newly created call to the shard.
+ * Packet deadlines of all legs are kept in a structure of arrays that is scanned at each advance, and only call
+ * expiries are kept in timing wheel.
+ * In pacing mode each leg gets a stable phase inside its packetization interval and shard ticks every 1ms,
+ * so that packets are spread over interval instead of being sent in a burst at every 20ms tick.
+ * In offline mode (a virtual clock is given) worker does not follow wall clock, it advances only when AdvanceTo() is called
+ * and sets virtual clock to deadline of each packet before sending it.
+ * Packet deadlines are anchored to tick grid of worker, so that an on time packet is sent within wake up jitter of its
+ * deadline and a packet is late only when worker misses a tick. Packets that are late are handled with overload policy
+ * of shard, and each leg counts its bursted, deferred and dropped packets, every late packet in exactly one of them.
+ * Counters of a call are logged and added to shard statistics when call ends.
+ * When shard is given more than one consumer, worker thread only decides which packets are due, and sending them is split
+ * into per call tasks that are executed by a work stealing pool having one worker per consumer. Each call is bound to a
+ * consumer when it is admitted, so that its streams stay on that consumer whichever worker executes its task. Tasks are
+ * ordered by consumer, so that a worker mostly sends through the consumer of its own range, and a consumer is locked
+ * while a task sends through it.
+ * With a lookahead, shard runs ahead of wall clock and tells consumers the monotonic time each packet is due at,
+ * so that a buffering consumer can hold packets till then.
+ * Once a G722 leg is due in an advance, it and later legs are gathered before their packets are sent, so that G722
+ * legs are encoded together in batches, by the pool if there is one. Legs of other codecs are sent right away.
+ */
+class CallShard
+{
+public:
+    struct Options
+    {
+        unsigned int capacity; /**< maximum number of calls shard may have, call table is reserved for it */
+        bool pacing;           /**< whether packets of call legs are spread over packetization interval */
+        OverloadPolicy overloadPolicy;
+        unsigned int maxBurst;  /**< maximum number of packets a leg sends in a tick while catching up */
+        unsigned int lookahead; /**< how many ms ahead of their due time packets are generated, 0 to send as generated */
+    };
+
+    /**
+     * @brief Counters of a shard, written by worker thread and read by control thread
+     */
+    struct Statistics
+    {
+        std::atomic<unsigned int> activeCalls;            /**< calls admitted to shard and not yet completed */
+        std::atomic<unsigned long long> completedCalls;   /**< calls that are timed out and removed */
+        std::atomic<unsigned long long> generatedPackets; /**< packets handed to consumer */
+        std::atomic<unsigned long long> missedDeadlines;  /**< tick deadlines that are skipped since worker was too late */
+        std::atomic<unsigned long long> driftUsec;        /**< cumulative wake up latency of worker past tick deadlines */
+        std::atomic<unsigned long long> burstedPackets;   /**< late packets of completed calls that are sent in catch up bursts */
+        std::atomic<unsigned long long> deferredPackets;  /**< late packets of completed calls that are sent in a later tick */
+        std::atomic<unsigned long long> droppedPackets;   /**< packets of completed calls that are never sent */
+        std::atomic<unsigned long long> stretchUsec;      /**< how much time of shard is behind wall clock in stretch policy */
+        std::atomic<unsigned long long> stolenTasks;      /**< call tasks that are executed by a worker other than their owner */
+
+        Statistics()
+            : activeCalls(0)
+            , completedCalls(0)
+            , generatedPackets(0)
+            , missedDeadlines(0)
+            , driftUsec(0)
+            , burstedPackets(0)
+            , deferredPackets(0)
+            , droppedPackets(0)
+            , stretchUsec(0)
+            , stolenTasks(0)
+        {
+        }
+    };
+
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param index INPUT index of shard, used in logs
+     * @param consumers INPUT consumers of shard, work is shared by a work stealing pool having a worker per consumer if there are many
+     * @param clock INPUT virtual clock of consumer in offline mode, null in real time mode
+     * @param options INPUT scheduling options of shard
+     */
+    CallShard(unsigned int index,
+              const std::vector<std::shared_ptr<IConsumer>>& consumers,
+              const std::shared_ptr<VirtualClock>& clock,
+              const Options& options);
+
+    /**
+     * @brief Destructor, stops worker thread if it is still running
+     */
+    ~CallShard();
+
+    /**
+     * @brief Hand a call to shard, can be called from any thread
+     *
+     * @param call INPUT call that will be stepped by this shard
+     */
+    void Admit(std::unique_ptr<Call> call);
+
+    /**
+     * @brief Start worker thread of shard
+     */
+    void Start();
+
+    /**
+     * @brief Request worker thread to stop and wait for it
+     */
+    void Stop();
+
+    /**
+     * @brief Request worker to advance to given time, offline mode only
+     *
+     * @param now INPUT virtual time in usec since start
+     */
+    void AdvanceTo(unsigned long long int now);
+
+    /**
+     * @brief Wait till worker reaches time requested by AdvanceTo(), offline mode only
+     */
+    void WaitAdvance();
+
+    /**
+     * @brief Number of calls admitted to shard and not completed yet
+     */
+    unsigned int GetLoad() const;
+
+    const Statistics& GetStatistics() const;
+
+    const std::shared_ptr<IConsumer>& GetConsumer() const;
+
+private:
+    void _run();
+    void _runOffline();
+    void _admitPendingCalls(unsigned long long int now);
+    void _schedule(Call& call, unsigned long long int now);
+    void _remove(Call& call);
+    void _advance(unsigned long long int now, unsigned long long int realNow);
+    unsigned int _admitPackets(CallLeg& callLeg, unsigned long long int lateness);
+    bool _acquireBurst(OverloadState& overloadState);
+    void _addWork(CallLeg& callLeg, unsigned int numberOfPackets, unsigned long long int deadline);
+    static void _sendDuePackets(void* owner, void* context, unsigned int worker);
+    void _encodeBatches();
+    static void _encodeBatch(void* owner, void* context, unsigned int worker);
+
+private:
+    /**
+     * @brief Packets of a leg that are due in an advance, when shard sends its packets by itself
+     */
+    struct DueLeg
+    {
+        CallLeg* callLeg;
+        unsigned int numberOfPackets;
+        unsigned long long int deadline;
+    };
+
+    const unsigned int _index;
+    const std::shared_ptr<IConsumer> _consumer;
+    const std::vector<std::shared_ptr<IConsumer>> _workerConsumers; /**< consumers that calls are bound to, one per worker */
+    std::vector<std::mutex> _consumerMutexes;                       /**< held by a task while it sends through a consumer */
+    const std::shared_ptr<VirtualClock> _clock;
+    const Options _options;
+    const unsigned int _tickUsec;        /**< tick of worker, deadlines of legs are on its grid */
+    unsigned int _numberOfScheduledLegs; /**< used to assign a distinct packet phase to each leg */
+    unsigned int _numberOfAdmittedCalls; /**< used to bind calls to consumers round robin */
+    unsigned int _advanceStamp;          /**< incremented at each advance, used in limiting bursts of legs */
+    unsigned long long int _timeBase;    /**< monotonic time in usec that time of shard is counted from */
+
+    std::mutex _advanceMutex;
+    std::condition_variable _advanceCondition;
+    unsigned long long int _targetTime;  /**< virtual time that worker is requested to advance to */
+    unsigned long long int _reachedTime; /**< virtual time that worker has advanced to */
+
+    std::mutex _pendingCallsMutex;
+    std::vector<std::unique_ptr<Call>> _pendingCalls; /**< calls admitted by control thread, waiting to be taken by worker */
+    std::vector<std::unique_ptr<Call>> _calls;        /**< calls owned by worker thread, swap removed so that table stays dense */
+    PacketSchedule _packets;                          /**< packet deadlines of legs of owned calls */
+    TimingWheel _wheel;                               /**< expiry deadlines of owned calls */
+    std::vector<DueLeg> _dueLegs;                     /**< legs that are due in advance, in order they are sent */
+    EncodeBatcher _batcher;                           /**< G722 packets that are due in advance, a round per packet of bursts */
+    unsigned int _encodingRound;                      /**< round of batcher whose batches are being encoded */
+
+    std::unique_ptr<WorkStealingPool> _pool; /**< null if shard sends its packets by itself */
+    std::vector<WorkStealingPool::Task> _work;
+    std::vector<std::vector<WorkStealingPool::Task>> _consumerWork; /**< tasks of advance per consumer, joined into _work */
+    std::vector<WorkStealingPool::Task> _batchWork; /**< encoding of batches, done before sending */
+    std::vector<Call*> _expiredCalls; /**< calls that are removed after work of advance is completed */
+
+    Statistics _statistics;
+    std::atomic<bool> _shallStop;
+    std::thread _worker;
+};
+
+/**
+ * @brief Call engine that distributes calls over a number of shards
+ *
+ * Control thread (the one that owns the engine) creates calls and admits them to the least loaded shard.
+ * Each shard is stepped by its own worker thread.
+ * In offline mode shards follow a virtual clock moved by control thread with AdvanceTo(), packets are stamped with virtual
+ * time and generation runs as fast as possible.
+ * With a lookahead, shards only generate packets into per consumer rings and a transmitter thread sends them when they
+ * fall due, so that jitter of generation is hidden from wire timing.
+ * With batching, packets a consumer gets in a tick (or in a transmit round with lookahead) are handed to it at once.
+ */
+class CallEngine
+{
+public:
+    struct Options
+    {
+        unsigned int numberOfThreads;
+        ConsumerFactory::Options consumerOptions;
+        CallShard::Options shardOptions;
+        bool offline;
+        bool steal;               /**< a single shard shares its work over numberOfThreads workers instead of a shard per thread */
+        bool batch;               /**< packets are handed to consumers in batches instead of one by one */
+        unsigned int legsPerCall; /**< maximum number of legs of a call, lookahead rings are sized for it */
+        unsigned int packetSize;  /**< size of packets of legs together with their headers, lookahead rings are sized for it */
+    };
+
+    /**
+     * @brief Aggregated progress of all shards
+     */
+    struct Progress
+    {
+        unsigned int activeCalls;
+        unsigned long long completedCalls;
+        unsigned long long generatedPackets;
+        unsigned long long missedDeadlines;
+        unsigned long long driftUsec;
+        unsigned long long burstedPackets;
+        unsigned long long deferredPackets;
+        unsigned long long droppedPackets;
+        unsigned long long stretchUsec; /**< maximum over shards */
+        unsigned long long stolenTasks;
+        unsigned long long transmittedPackets; /**< packets sent by transmitter in lookahead mode */
+        unsigned long long overflowPackets;    /**< packets dropped in lookahead mode since a ring was full */
+    };
+
+public:
+    explicit CallEngine(const Options& options);
+    ~CallEngine() = default;
+
+    /**
+     * @brief Select the shard that has least number of calls
+     *
+     * @return shard that next call should be admitted to
+     */
+    CallShard& SelectShard();
+
+    void Start();
+    void Stop();
+
+    /**
+     * @brief Advance all shards to given virtual time and wait for them, offline mode only
+     *
+     * @param now INPUT virtual time in usec since start
+     */
+    void AdvanceTo(unsigned long long int now);
+
+    unsigned int GetNumberOfCalls() const;
+    Progress GetProgress() const;
+
+private:
+    std::vector<std::unique_ptr<CallShard>> _shards;
+    std::vector<std::shared_ptr<LookaheadConsumer>> _lookaheadConsumers;
+    std::unique_ptr<Transmitter> _transmitter; /**< null if there is no lookahead */
+};
+
+} // namespace ddgen
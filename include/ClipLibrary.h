@@ -0,0 +1,96 @@
+/**
+ * @file
+ * @brief library of pre encoded audio clips that are memory mapped and shared by all legs
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ddgen {
+
+#define CLIP_PACKET_SIZE 160 /**< clip packets are 20ms, 160 bytes of G711 at 8kHz or of G722 at 64kbps */
+
+/**
+ * @brief A pre encoded clip, raw rtp payload bytes of a single codec
+ *
+ * Clip is cut into CLIP_PACKET_SIZE byte packets, a trailing partial packet is not used. Ones complement sum of each
+ * packet is calculated once at load, so that udp checksum of a clip packet needs no pass over its payload.
+ */
+struct Clip
+{
+    std::string name;
+    unsigned char payloadType;     /**< rtp payload type of codec of clip */
+    const unsigned char* payloads; /**< mapped clip file, read only */
+    unsigned int numberOfPackets;
+    std::vector<unsigned short int> sums; /**< ones complement sum of each packet */
+};
+
+/**
+ * @brief Directory of pre encoded clips, each mapped read only once and shared by all legs
+ *
+ * Codec of a clip is determined by extension of its file; .pcma or .alaw for G711a, .pcmu or .ulaw for G711u and .g722
+ * for G722. Files are expected to hold raw payload with no container header. Legs keep only a pointer to their clip and
+ * a packet index, so that memory does not grow with number of calls, and pages of clips are shared through page cache.
+ * Clips are loaded before legs are formed and are not changed afterwards.
+ */
+class ClipLibrary
+{
+public:
+    ClipLibrary();
+
+    /**
+     * @brief Destructor, unmaps clips, should outlive legs using them
+     */
+    ~ClipLibrary();
+
+    ClipLibrary(const ClipLibrary&) = delete;
+    ClipLibrary& operator=(const ClipLibrary&) = delete;
+
+    /**
+     * @brief Map clips in a directory
+     *
+     * Files with unknown extensions or shorter than a packet are skipped.
+     * @param directory INPUT directory of clip files
+     * @return false if directory can not be read or has no clips
+     */
+    bool Load(const std::string& directory);
+
+    /**
+     * @brief Pick clip of a new leg, clips are handed out round robin
+     *
+     * @return clip, null if library is empty
+     */
+    const Clip* SelectClip();
+
+    unsigned int GetNumberOfClips() const
+    {
+        return _clips.size();
+    }
+
+    /**
+     * @brief Total size of mapped clip files in bytes
+     */
+    unsigned long long int GetMappedSize() const;
+
+private:
+    bool _mapClip(const std::string& path, const std::string& name, unsigned char payloadType);
+
+    struct Mapping
+    {
+        void* address;
+        std::size_t size;
+    };
+
+    std::vector<std::unique_ptr<Clip>> _clips;
+    std::vector<Mapping> _mappings;
+    std::atomic<unsigned int> _nextClip; /**< round robin index of clip to be selected next */
+};
+
+} // namespace ddgen
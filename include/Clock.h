@@ -0,0 +1,73 @@
+/**
+ * @file
+ * @brief clocks that consumers use to stamp packets
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+namespace ddgen {
+
+/**
+ * @brief Abstract clock interface
+ *
+ * @see SystemClock()
+ * @see VirtualClock()
+ */
+class IClock
+{
+public:
+    virtual ~IClock() = default;
+
+    /**
+     * @brief Gets current time of clock in sec and usec
+     *
+     * @param sec OUTPUT seconds part
+     * @param usec OUTPUT micro seconds part
+     */
+    virtual void GetTime(unsigned int& sec, unsigned int& usec) const = 0;
+};
+
+/**
+ * @brief Clock that reads wall clock time of system
+ */
+class SystemClock : public IClock
+{
+public:
+    void GetTime(unsigned int& sec, unsigned int& usec) const override;
+};
+
+/**
+ * @brief Clock that is moved explicitly by its owner, used for generating pcap files faster than real time
+ *
+ * Time is kept as an offset to a start time, so that simulated timeline looks like a real time run that started at start time.
+ */
+class VirtualClock : public IClock
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param startUsec INPUT epoch time in usec that corresponds to offset 0
+     */
+    explicit VirtualClock(unsigned long long int startUsec);
+
+    /**
+     * @brief Set current time of clock
+     *
+     * @param offsetUsec INPUT time in usec relative to start time
+     */
+    void SetTime(unsigned long long int offsetUsec)
+    {
+        _offsetUsec = offsetUsec;
+    }
+
+    void GetTime(unsigned int& sec, unsigned int& usec) const override;
+
+private:
+    const unsigned long long int _startUsec;
+    unsigned long long int _offsetUsec;
+};
+
+} // namespace ddgen
@@ -16,6 +16,8 @@ public:
         std::vector<IpPort> dstIpPortVector;
         bool useS3;
         std::string stackName;
+        std::string tag;               /**< appended to generated file names, to distinguish consumers of different shards */
+        std::shared_ptr<IClock> clock; /**< clock that pcap packets are stamped with, system clock if null */
     };
 
 public:
@@ -0,0 +1,108 @@
+/**
+ * @file
+ * @brief due legs of a shard whose payloads are encoded together in batches
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include "g722encoder.h"
+
+#include <memory>
+#include <vector>
+
+namespace ddgen {
+
+class CallLeg;
+
+/**
+ * @brief Codes of a packet of a leg that is encoded in a batch
+ */
+struct BatchPayload
+{
+    unsigned char codes[G722_PACKET_SIZE / 2];
+    BatchPayload* next; /**< payload of next packet of same leg in a later round, null if there is none */
+    bool encoded;       /**< false if pcm of leg could not be generated, leg then encodes its packets by itself */
+};
+
+/**
+ * @brief Batches of G722 legs that are due in an advance of a shard
+ *
+ * ADPCM of G722 is serial within a leg, so a leg alone can not make use of vector units. Legs with G722 encoders are
+ * collected as they fall due, and before packets of advance are sent, pcm of next packet of each leg is generated and
+ * legs are encoded G722_BATCH_LANES at a time, each in a lane of batch kernel. Each leg then sends its batch payloads as
+ * its next packets. A leg that has more than one packet in an advance, as in a catch up burst, takes its first packet
+ * into first round of batches, its second packet into second round and so on. Rounds are encoded one after another,
+ * so that encoder memory of a leg advances in order of its packets, while batches of a round are independent of each
+ * other and may be encoded by different threads. Encoder memory stays in encoder of each leg, so legs join and leave
+ * batches at any advance. Payload space is kept between advances, so steady state does not allocate.
+ * @see G722EncoderType::EncodeBatch()
+ */
+class EncodeBatcher
+{
+public:
+    EncodeBatcher() : _numberOfRounds(0)
+    {
+    }
+
+    EncodeBatcher(const EncodeBatcher&) = delete;
+    EncodeBatcher& operator=(const EncodeBatcher&) = delete;
+
+    /**
+     * @brief Reserve so that adding that many legs in an advance does not reallocate leg table of first round
+     *
+     * @param numberOfLegs INPUT maximum number of legs expected in an advance
+     */
+    void Reserve(unsigned int numberOfLegs);
+
+    /**
+     * @brief Take next packets of a due leg into batches, each packet into the round after that of previous one
+     *
+     * Leg is not taken if it has no G722 encoder. Every packet that is taken should be sent in this advance.
+     * @param callLeg INPUT leg that is due
+     * @param numberOfPackets INPUT packets of leg that are due
+     */
+    void Add(CallLeg& callLeg, unsigned int numberOfPackets);
+
+    unsigned int GetNumberOfRounds() const
+    {
+        return _numberOfRounds;
+    }
+
+    unsigned int GetNumberOfBatches(unsigned int round) const
+    {
+        return (_rounds[round].legs.size() + G722_BATCH_LANES - 1) / G722_BATCH_LANES;
+    }
+
+    /**
+     * @brief Generate pcm of legs of a batch and encode them together into their batch payloads
+     *
+     * Batches of a round should be encoded only after all batches of previous rounds are.
+     * @param round INPUT index of round, less than GetNumberOfRounds()
+     * @param batch INPUT index of batch, less than GetNumberOfBatches() of round
+     */
+    void EncodeBatch(unsigned int round, unsigned int batch);
+
+    /**
+     * @brief Forget legs of advance, should be called after their packets are sent and before any of them is removed
+     */
+    void Clear();
+
+private:
+    struct BatchPayloads
+    {
+        BatchPayload payloads[G722_BATCH_LANES];
+    };
+
+    struct Round
+    {
+        std::vector<CallLeg*> legs;                          /**< legs of round, G722_BATCH_LANES consecutive legs make a batch */
+        std::vector<std::unique_ptr<BatchPayloads>> batches; /**< payloads of each batch, they do not move as batches are added */
+    };
+
+    std::vector<Round> _rounds;   /**< rounds of advance, a round is kept with its payload space when advance ends */
+    unsigned int _numberOfRounds; /**< rounds that have legs in this advance */
+};
+
+} // namespace ddgen
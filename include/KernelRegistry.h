@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @brief registry of instruction set specific kernels, selected once at startup
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include <string>
+
+namespace ddgen {
+
+class G722EncoderType;
+struct ToneOscillator;
+
+/**
+ * @brief Instruction set level of a kernel set, each level assumes the ones before it
+ */
+enum class KernelIsa
+{
+    Scalar, /**< portable c++, used on every cpu */
+    Sse42,  /**< sse2 to sse4.2 */
+    Avx2,   /**< avx2 */
+    Avx512  /**< avx512f, avx512bw and avx512cd */
+};
+
+/**
+ * @brief Kernels of hot loops of an instruction set level, all give the same result as scalar kernels
+ *
+ * A level that has no specific implementation of a kernel uses the one of the level below it.
+ */
+struct Kernels
+{
+    KernelIsa isa;
+
+    /** @see OnesComplementShortSummation() */
+    unsigned short int (*onesComplementShortSummation)(const unsigned char* data_ptr, unsigned short int data_size);
+
+    /** @see G711aEncodeScalar() */
+    void (*g711aEncode)(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples);
+
+    /** @see G711uEncodeScalar() */
+    void (*g711uEncode)(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples);
+
+    /** @see G722QmfTxScalar() */
+    void (*g722QmfTx)(const short int* pcm_data_ptr,
+                      unsigned int number_of_pairs,
+                      short int* delay_line_ptr,
+                      short int* low_band_ptr,
+                      short int* high_band_ptr);
+
+    /** @see G722EncodeBatchScalar() */
+    void (*g722EncodeBatch)(G722EncoderType* const* encoders,
+                            const short int* const* pcm_data_ptrs,
+                            unsigned char* const* encoded_data_ptrs,
+                            unsigned int number_of_encoders);
+
+    /** @see GenerateToneScalar() */
+    void (*generateTone)(short int* pcm_data_ptr, unsigned int size, ToneOscillator& oscillator);
+};
+
+/**
+ * @brief Kernel sets of all instruction set levels, and the one that is in use
+ *
+ * Best level that cpu supports is found through cpuid when kernels are first asked for. Another level may be selected
+ * at startup, before any worker is running, so that a run can be compared or reproduced on a lower level. Callers get
+ * the selected set through Get() and call kernels through its pointers, so that dispatch costs an indirect call per
+ * packet rather than a check per sample.
+ */
+class KernelRegistry
+{
+public:
+    /**
+     * @brief Kernel set in use
+     */
+    static const Kernels& Get();
+
+    /**
+     * @brief Kernel set of a level
+     *
+     * @param isa INPUT instruction set level
+     * @return kernel set, null if cpu does not support level
+     */
+    static const Kernels* GetKernels(KernelIsa isa);
+
+    /**
+     * @brief Use kernel set of a level, should be called before workers are started
+     *
+     * @param isa INPUT instruction set level
+     * @return false if cpu does not support level, kernel set in use is not changed then
+     */
+    static bool Select(KernelIsa isa);
+
+    static bool IsSupported(KernelIsa isa);
+
+    static KernelIsa GetBestSupportedIsa();
+
+    /**
+     * @brief Name of a level, as given to --kernel-isa
+     */
+    static const char* GetName(KernelIsa isa);
+
+    /**
+     * @brief Level of a name
+     *
+     * @param name INPUT one of scalar, sse4.2, avx2 or avx512
+     * @param isa OUTPUT level of name
+     * @return false if name is not known
+     */
+    static bool Parse(const std::string& name, KernelIsa& isa);
+};
+
+} // namespace ddgen
@@ -0,0 +1,128 @@
+/**
+ * @file
+ * @brief pool of pre constructed objects that encoder and generator factories hand out
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ddgen {
+
+/**
+ * @brief Pool of reusable objects
+ *
+ * Objects are handed out as handles, and when a handle is destroyed its object is Reset() and returned to pool instead
+ * of being deleted. Once pool is reserved for peak number of objects, acquiring and releasing only pop and push a free
+ * list. Pool is thread safe, since calls are created by control thread and destroyed by workers. Pool owns all objects
+ * it has created, so it should outlive every handle.
+ */
+template <typename T>
+class ObjectPool
+{
+public:
+    /**
+     * @brief Deleter of handles, returns object to its pool
+     */
+    class Releaser
+    {
+    public:
+        explicit Releaser(ObjectPool* pool = nullptr) : _pool(pool)
+        {
+        }
+
+        void operator()(T* object) const
+        {
+            _pool->Release(object);
+        }
+
+    private:
+        ObjectPool* _pool;
+    };
+
+    typedef std::unique_ptr<T, Releaser> Handle;
+
+public:
+    /**
+     * @brief Constructor, does not create any object
+     *
+     * @param creator INPUT function that creates a new object when pool is empty
+     */
+    explicit ObjectPool(const std::function<T*()>& creator) : _creator(creator)
+    {
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    /**
+     * @brief Make sure that at least given number of objects are created
+     *
+     * @param numberOfObjects INPUT number of objects that should be available in total
+     */
+    void Reserve(unsigned int numberOfObjects)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        _objects.reserve(numberOfObjects);
+        _freeObjects.reserve(numberOfObjects);
+        while (_objects.size() < numberOfObjects) {
+            _objects.emplace_back(_creator());
+            _freeObjects.push_back(_objects.back().get());
+        }
+    }
+
+    /**
+     * @brief Take an object from pool, a new one is created if pool is empty
+     *
+     * @return handle that returns object to pool when destroyed
+     */
+    Handle Acquire()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_freeObjects.empty()) {
+            _objects.emplace_back(_creator());
+            _freeObjects.push_back(_objects.back().get());
+        }
+
+        T* object = _freeObjects.back();
+        _freeObjects.pop_back();
+        return Handle(object, Releaser(this));
+    }
+
+    /**
+     * @brief Reset object and return it to pool, called by handles
+     *
+     * @param object INPUT object that is obtained by Acquire()
+     */
+    void Release(T* object)
+    {
+        object->Reset();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _freeObjects.push_back(object);
+    }
+
+    /**
+     * @brief Number of objects that are created by pool, whether in use or not
+     */
+    unsigned int GetNumberOfObjects() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _objects.size();
+    }
+
+private:
+    const std::function<T*()> _creator;
+    mutable std::mutex _mutex;
+    std::vector<std::unique_ptr<T>> _objects; /**< every object that is created, in use or not */
+    std::vector<T*> _freeObjects;             /**< objects that are ready to be acquired */
+};
+
+} // namespace ddgen
@@ -0,0 +1,107 @@
+/**
+ * @file
+ * @brief single producer single consumer ring of timestamped packets
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace ddgen {
+
+/**
+ * @brief Lock free ring of variable size packets, each stamped with the time it is due
+ *
+ * Packets are kept back to back as records in a byte buffer, so that memory is proportional to bytes in flight
+ * instead of maximum packet size. Only one thread may push and only one thread may read, head is published by
+ * producer with release semantics and tail by consumer, so neither side takes a lock.
+ */
+class PacketRing
+{
+public:
+    /**
+     * @brief Header of a record, packet data follows the header
+     */
+    struct Record
+    {
+        unsigned long long int dueTime; /**< monotonic time in usec that packet should be sent at */
+        unsigned int size;              /**< size of packet data */
+        unsigned int reserved;
+
+        const unsigned char* GetData() const
+        {
+            return reinterpret_cast<const unsigned char*>(this + 1);
+        }
+    };
+
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param capacity INPUT size of ring in bytes, rounded up to a multiple of 8
+     */
+    explicit PacketRing(std::size_t capacity);
+
+    PacketRing(const PacketRing&) = delete;
+    PacketRing& operator=(const PacketRing&) = delete;
+
+    /**
+     * @brief Bytes of ring that a packet takes, together with its record header and alignment
+     *
+     * @param size INPUT size of packet data
+     * @return size of record of packet
+     */
+    static std::size_t GetRecordSize(unsigned int size);
+
+    /**
+     * @brief Append a packet, producer side
+     *
+     * @param dueTime INPUT monotonic time in usec that packet should be sent at
+     * @param data INPUT packet data
+     * @param size INPUT size of packet data
+     * @return false if there is no room for packet
+     */
+    bool Push(unsigned long long int dueTime, const unsigned char* data, unsigned int size);
+
+    /**
+     * @brief Reserve room for a packet that is written in place, producer side
+     *
+     * Packet is not visible to consumer till Commit() is called, at most one packet may be acquired at a time.
+     * @param dueTime INPUT monotonic time in usec that packet should be sent at
+     * @param size INPUT maximum size of packet data
+     * @return pointer to size bytes of packet data, null if there is no room for packet
+     */
+    unsigned char* Acquire(unsigned long long int dueTime, unsigned int size);
+
+    /**
+     * @brief Publish packet reserved by Acquire(), producer side
+     *
+     * @param size INPUT size of packet data, not more than acquired size
+     */
+    void Commit(unsigned int size);
+
+    /**
+     * @brief Oldest packet in ring, consumer side
+     *
+     * @return oldest record, null if ring is empty
+     */
+    const Record* Front();
+
+    /**
+     * @brief Remove packet returned by Front(), consumer side
+     */
+    void Pop();
+
+private:
+    const std::size_t _capacity;
+    std::unique_ptr<unsigned long long int[]> _buffer; /**< 8 byte aligned storage of records */
+    std::atomic<unsigned long long int> _head;          /**< bytes ever written, owned by producer */
+    std::atomic<unsigned long long int> _tail;          /**< bytes ever read, owned by consumer */
+    unsigned long long int _acquiredHead;               /**< position of acquired record, owned by producer */
+};
+
+} // namespace ddgen
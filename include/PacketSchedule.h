@@ -0,0 +1,108 @@
+/**
+ * @file
+ * @brief structure of arrays that holds packet deadlines of all call legs of a shard
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace ddgen {
+
+class CallLeg;
+
+/**
+ * @brief Packet deadlines of call legs, kept as structure of arrays
+ *
+ * Every leg has a slot, and deadline, period and limit of slots are kept in separate dense arrays that are removed from
+ * by swapping with last slot. At each advance due flags of all slots are computed in a single branch free loop over
+ * deadlines, which compiler vectorizes, and only the legs that are due are gathered and handed to handler. So cost of
+ * an advance is a sequential scan of a few bytes per leg plus work of emitting legs, instead of chasing a timer per leg.
+ */
+class PacketSchedule
+{
+public:
+    PacketSchedule() = default;
+
+    PacketSchedule(const PacketSchedule&) = delete;
+    PacketSchedule& operator=(const PacketSchedule&) = delete;
+
+    /**
+     * @brief Reserve arrays so that adding that many legs does not reallocate
+     *
+     * @param numberOfLegs INPUT maximum number of legs expected
+     */
+    void Reserve(unsigned int numberOfLegs);
+
+    /**
+     * @brief Add a leg, its slot is stored in leg
+     *
+     * @param callLeg INPUT leg that packets are scheduled for
+     * @param deadline INPUT deadline of first packet in usec
+     * @param period INPUT packet interval in usec
+     * @param limit INPUT packets are not scheduled at or after limit
+     */
+    void Add(CallLeg& callLeg, unsigned long long int deadline, unsigned int period, unsigned long long int limit);
+
+    /**
+     * @brief Remove a leg, last slot is moved into its slot
+     *
+     * @param callLeg INPUT leg that is added before
+     */
+    void Remove(CallLeg& callLeg);
+
+    /**
+     * @brief Hand every packet that is due till given time to handler
+     *
+     * Handler is called as handler(callLeg, deadline), a leg that is more than a period behind is called once per missed
+     * deadline. Handler should not add or remove legs.
+     * @param now INPUT time in usec
+     * @param ordered INPUT whether packets are handed in deadline order, otherwise they are handed in slot order
+     * @param handler INPUT callable that will handle due packets
+     */
+    template <typename Handler>
+    void Advance(unsigned long long int now, bool ordered, Handler&& handler);
+
+    unsigned int Size() const
+    {
+        return _legs.size();
+    }
+
+private:
+    struct DuePacket
+    {
+        unsigned long long int deadline;
+        CallLeg* callLeg;
+    };
+
+    void _gatherDuePackets(unsigned long long int now);
+
+private:
+    std::vector<unsigned long long int> _deadlines; /**< deadline of next packet of each slot */
+    std::vector<unsigned long long int> _limits;    /**< end of packets of each slot */
+    std::vector<unsigned int> _periods;             /**< packet interval of each slot */
+    std::vector<CallLeg*> _legs;                    /**< leg of each slot */
+    std::vector<unsigned char> _dueFlags;           /**< scratch, whether slot is due in current advance */
+    std::vector<DuePacket> _duePackets;             /**< scratch, packets that are due in current advance */
+};
+
+template <typename Handler>
+void PacketSchedule::Advance(unsigned long long int now, bool ordered, Handler&& handler)
+{
+    _gatherDuePackets(now);
+
+    if (ordered) {
+        std::stable_sort(_duePackets.begin(), _duePackets.end(), [](const DuePacket& first, const DuePacket& second) {
+            return first.deadline < second.deadline;
+        });
+    }
+
+    for (const auto& due_packet : _duePackets) {
+        handler(*due_packet.callLeg, due_packet.deadline);
+    }
+}
+
+} // namespace ddgen
@@ -0,0 +1,121 @@
+/**
+ * @file
+ * @brief pre serialized ethernet, ipv4, udp and rtp headers of a call leg
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include "rawsocket.h"
+
+#include <cstring>
+#include <netinet/in.h>
+
+namespace ddgen {
+
+/**
+ * @brief Headers of packets of a leg kept in network byte order
+ *
+ * Headers are serialized once when leg is formed, and for each packet template is copied in front of payload and only
+ * rtp sequence number, rtp timestamp and ipv4 id are patched. Ipv4 checksum is updated incrementally for change of id
+ * as in RFC 1624, and udp checksum is composed of a cached sum of pseudo header and constant header fields plus sums
+ * of varying rtp fields and payload.
+ */
+class PacketTemplate
+{
+public:
+    static const unsigned short int headers_size = eth_header_size + ipv4_header_size + udp_header_size + rtp_header_size;
+
+    PacketTemplate();
+
+    /**
+     * @brief Serialize headers into template
+     *
+     * Checksum fields of given headers are ignored, ipv4 checksum is calculated and udp checksum is left to Write().
+     * @param eth_header INPUT ethernet header
+     * @param ipv4_header INPUT ipv4 header
+     * @param udp_header INPUT udp header, tot_len should cover rtp header and payload
+     * @param rtp_header INPUT rtp header
+     */
+    void Build(const EthHeaderType& eth_header, const Ipv4HeaderType& ipv4_header, const UdpHeaderType& udp_header, const RtpHeaderType& rtp_header);
+
+    /**
+     * @brief Write headers in front of a payload
+     *
+     * @param buffer_ptr OUTPUT line buffer, payload is placed after headers_size bytes
+     * @param seq_num INPUT rtp sequence number of packet
+     * @param timestamp INPUT rtp timestamp of packet
+     * @param id INPUT ipv4 id of packet
+     * @param payload_sum INPUT ones complement sum of payload
+     * @see OnesComplementShortSummation()
+     */
+    void Write(unsigned char* buffer_ptr,
+               unsigned short int seq_num,
+               unsigned int timestamp,
+               unsigned short int id,
+               unsigned short int payload_sum);
+
+private:
+    static const unsigned short int ipv4_offset = eth_header_size;
+    static const unsigned short int udp_offset = ipv4_offset + ipv4_header_size;
+    static const unsigned short int rtp_offset = udp_offset + udp_header_size;
+
+    static unsigned short int Fold(unsigned int sum)
+    {
+        sum = (sum >> 16) + (sum & 0x0000ffff);
+        sum = (sum >> 16) + (sum & 0x0000ffff);
+        return (unsigned short int)sum;
+    }
+
+    unsigned short int ReadShort(unsigned short int offset) const
+    {
+        unsigned short int value;
+        std::memcpy(&value, _headers + offset, sizeof(value));
+        return ntohs(value);
+    }
+
+    void WriteShort(unsigned short int offset, unsigned short int value)
+    {
+        value = htons(value);
+        std::memcpy(_headers + offset, &value, sizeof(value));
+    }
+
+private:
+    unsigned char _headers[headers_size]; /**< headers of last written packet, including its ipv4 checksum */
+    unsigned int _udpSum;                  /**< sum of pseudo header, udp header and constant rtp fields */
+};
+
+inline void PacketTemplate::Write(unsigned char* buffer_ptr,
+                                  unsigned short int seq_num,
+                                  unsigned int timestamp,
+                                  unsigned short int id,
+                                  unsigned short int payload_sum)
+{
+    // RFC 1624 eqn 3, HC' = ~(~HC + ~m + m'), id is the only ipv4 field that changes
+    const unsigned short int old_id = ReadShort(ipv4_offset + 4);
+    if (old_id != id) {
+        const unsigned short int old_checksum = ReadShort(ipv4_offset + 10);
+        const unsigned short int checksum = ~Fold((unsigned short int)~old_checksum + (unsigned short int)~old_id + (unsigned int)id);
+        WriteShort(ipv4_offset + 4, id);
+        WriteShort(ipv4_offset + 10, checksum);
+    }
+
+    WriteShort(rtp_offset + 2, seq_num);
+    WriteShort(rtp_offset + 4, (unsigned short int)(timestamp >> 16));
+    WriteShort(rtp_offset + 6, (unsigned short int)(timestamp & 0x0000ffff));
+
+    std::memcpy(buffer_ptr, _headers, headers_size);
+
+    const unsigned int sum = _udpSum + seq_num + (timestamp >> 16) + (timestamp & 0x0000ffff) + payload_sum;
+
+    // a zero checksum means no checksum in udp, so it is sent as 0xffff
+    unsigned short int checksum = ~Fold(sum);
+    if (0 == checksum) {
+        checksum = 0xffff;
+    }
+    checksum = htons(checksum);
+    std::memcpy(buffer_ptr + udp_offset + 6, &checksum, sizeof(checksum));
+}
+
+} // namespace ddgen
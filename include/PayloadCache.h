@@ -0,0 +1,88 @@
+/**
+ * @file
+ * @brief cache of encoded payloads of periodic tones
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include "encoder.h"
+#include "generator.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace ddgen {
+
+/**
+ * @brief Encoded packets of one cycle of a periodic tone
+ *
+ * Cycle spans as many packets as it takes tone cycle and packets to line up again, packet k starts at position
+ * firstIndex + k * packetSize of tone cycle. Ones complement sum of each payload is kept with it, so that udp checksum
+ * of a cached packet needs no pass over its payload.
+ */
+struct PayloadCycle
+{
+    unsigned short int packetSize; /**< size of a payload */
+    unsigned int numberOfPackets;  /**< number of payloads in cycle */
+    unsigned int firstIndex;       /**< position in tone cycle that first payload starts at */
+    std::vector<unsigned char> payloads;
+    std::vector<unsigned short int> sums; /**< ones complement sum of each payload */
+
+    const unsigned char* GetPayload(unsigned int packetIndex) const
+    {
+        return payloads.data() + packetIndex * packetSize;
+    }
+
+    /**
+     * @brief Packet that starts at given position of tone cycle
+     *
+     * @param cycleIndex INPUT position in tone cycle
+     * @return index of packet, numberOfPackets if no packet starts there
+     */
+    unsigned int FindPacket(unsigned int cycleIndex) const;
+};
+
+/**
+ * @brief Encoded payload cycles shared by all legs that have the same codec and periodic tone
+ *
+ * A cycle is encoded once when first leg asks for it and is kept till cache is destroyed, so that pointers to cycles stay
+ * valid. Cache is thread safe, though it is expected to be used only when legs are formed.
+ */
+class PayloadCache
+{
+public:
+    PayloadCache() = default;
+
+    PayloadCache(const PayloadCache&) = delete;
+    PayloadCache& operator=(const PayloadCache&) = delete;
+
+    /**
+     * @brief Find or encode payload cycle of an encoder and generator pair
+     *
+     * @param encoder INPUT encoder of leg, used to encode cycle if it is not cached yet
+     * @param generator INPUT generator of leg
+     * @return cycle, null if encoder is not memoryless or tone is not periodic
+     */
+    const PayloadCycle* GetCycle(EncoderType& encoder, const GeneratorType& generator);
+
+    /**
+     * @brief Number of cycles in cache
+     */
+    unsigned int GetNumberOfCycles() const;
+
+private:
+    // rtp payload type, packet size, cycle frequency, cycle amplitude and first index
+    typedef std::tuple<unsigned char, unsigned short int, unsigned int, unsigned int, unsigned int> Key;
+
+    static std::unique_ptr<PayloadCycle> EncodeCycle(EncoderType& encoder, const SingleToneGeneratorType& generator, unsigned int firstIndex);
+
+    mutable std::mutex _mutex;
+    std::map<Key, std::unique_ptr<PayloadCycle>> _cycles;
+};
+
+} // namespace ddgen
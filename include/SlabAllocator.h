@@ -0,0 +1,89 @@
+/**
+ * @file
+ * @brief fixed size slot allocator that calls and call legs are placed in
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ddgen {
+
+/**
+ * @brief Slab of fixed size slots with a free list
+ *
+ * Slots are reserved in large chunks up front, so that steady state allocation and deallocation only pop and push
+ * the free list. Requests that do not fit in a slot, or that come when slab is exhausted, are served from heap and
+ * counted as overflows. Allocation is thread safe, since calls are created by control thread and destroyed by workers.
+ */
+class SlabAllocator
+{
+public:
+    /**
+     * @brief Constructor, does not reserve any slot
+     *
+     * @param slotSize INPUT size of each slot in bytes
+     */
+    explicit SlabAllocator(std::size_t slotSize);
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    /**
+     * @brief Make sure that at least given number of slots are reserved
+     *
+     * @param numberOfSlots INPUT number of slots that should be available in total
+     */
+    void Reserve(unsigned int numberOfSlots);
+
+    /**
+     * @brief Allocate memory from a free slot, or from heap if there is none
+     *
+     * @param size INPUT requested size in bytes
+     * @return allocated memory, never null
+     */
+    void* Allocate(std::size_t size);
+
+    /**
+     * @brief Return memory that is obtained by Allocate()
+     *
+     * @param ptr INPUT memory to be freed
+     */
+    void Deallocate(void* ptr);
+
+    unsigned int GetNumberOfSlots() const;
+
+    /**
+     * @brief Number of allocations that are served from heap
+     */
+    unsigned long long int GetOverflowCount() const;
+
+private:
+    struct FreeSlot
+    {
+        FreeSlot* next;
+    };
+
+    struct Chunk
+    {
+        std::unique_ptr<unsigned char[]> memory;
+        std::size_t size;
+    };
+
+    bool _owns(const void* ptr) const;
+
+private:
+    const std::size_t _slotSize;
+    mutable std::mutex _mutex;
+    std::vector<Chunk> _chunks;
+    FreeSlot* _freeSlots;
+    unsigned int _numberOfSlots;
+    unsigned long long int _overflowCount;
+};
+
+} // namespace ddgen
@@ -0,0 +1,85 @@
+/**
+ * @file
+ * @brief tick scheduler that sleeps till absolute deadlines on monotonic clock
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+namespace ddgen {
+
+/** @brief Gets current time of monotonic clock.
+    @return monotonic time in usec
+ */
+unsigned long long int GetMonotonicUsec();
+
+/** @brief Sleeps till given monotonic time, interrupted sleeps are restarted.
+    @param deadline_usec INPUT monotonic time in usec to wake up at
+    @return false if sleep fails.
+ */
+bool SleepUntilMonotonicUsec(unsigned long long int deadline_usec);
+
+/**
+ * @brief Scheduler of periodic ticks
+ *
+ * Deadline of k'th tick is start + k * tick duration, and thread is put to sleep with clock_nanosleep(TIMER_ABSTIME)
+ * on CLOCK_MONOTONIC. Since deadlines are computed from start time, neither sleep latency nor processing time
+ * accumulates into tick rate. A tick that is more than a tick duration late is counted as missed and skipped, the time
+ * returned by WaitNextTick() is real time so that caller advances by real elapsed time.
+ */
+class TickScheduler
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param tickUsec INPUT tick duration in usec
+     */
+    explicit TickScheduler(unsigned int tickUsec);
+
+    /**
+     * @brief Start timeline of ticks at current time
+     */
+    void Start();
+
+    /**
+     * @brief Sleep till next tick deadline
+     *
+     * @return real time in usec since Start() at wake up
+     */
+    unsigned long long int WaitNextTick();
+
+    /**
+     * @brief Monotonic time in usec that ticks are counted from
+     */
+    unsigned long long int GetStartUsec() const
+    {
+        return _startUsec;
+    }
+
+    /**
+     * @brief Sum of wake up latencies past deadlines in usec
+     */
+    unsigned long long int GetDriftUsec() const
+    {
+        return _driftUsec;
+    }
+
+    /**
+     * @brief Number of tick deadlines that are skipped since they are already passed
+     */
+    unsigned long long int GetMissedDeadlines() const
+    {
+        return _missedDeadlines;
+    }
+
+private:
+    const unsigned long long int _tickUsec;
+    unsigned long long int _startUsec;       /**< monotonic time of Start() */
+    unsigned long long int _nextDeadline;    /**< next tick deadline relative to start */
+    unsigned long long int _driftUsec;       /**< cumulative wake up latency */
+    unsigned long long int _missedDeadlines; /**< cumulative skipped ticks */
+};
+
+} // namespace ddgen
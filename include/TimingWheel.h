@@ -0,0 +1,157 @@
+/**
+ * @file
+ * @brief hierarchical timing wheel that holds packet and call expiry deadlines
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace ddgen {
+
+#define TIMING_WHEEL_SLOT_BITS 6                          /**< each level of wheel has 2^6 slots */
+#define TIMING_WHEEL_SLOTS (1 << TIMING_WHEEL_SLOT_BITS)  /**< number of slots in a level */
+#define TIMING_WHEEL_LEVELS 11                            /**< 11 levels of 6 bits covers whole 64 bit time */
+#define TIMING_WHEEL_EXPIRED_LEVEL 0xff                   /**< level marker of events that are due but not fired yet */
+#define TIMING_WHEEL_NEVER ((unsigned long long int)(-1)) /**< deadline that will never be reached */
+
+/**
+ * @brief Event that can be scheduled in timing wheel
+ *
+ * Event is intrusive, it is embedded in its owner and never allocated by wheel.
+ * A periodic event (period != 0) is re-armed by wheel to deadline + period as long as new deadline is before limit.
+ */
+struct TimerEvent
+{
+    unsigned long long int deadline; /**< absolute time in usec that event is due */
+    unsigned long long int period;   /**< re-arm period in usec, 0 for one shot events */
+    unsigned long long int limit;    /**< periodic event is not re-armed at or after limit */
+    unsigned int type;               /**< owner defined event type */
+    void* owner;                     /**< owner defined context */
+
+    TimerEvent* next;   /**< next event in slot list */
+    TimerEvent** pprev; /**< address of pointer that points to this event, NULL if event is not scheduled */
+    unsigned char level;
+    unsigned char slot;
+
+    TimerEvent() : deadline(0), period(0), limit(TIMING_WHEEL_NEVER), type(0), owner(NULL), next(NULL), pprev(NULL), level(0), slot(0)
+    {
+    }
+
+    bool IsScheduled() const
+    {
+        return (NULL != pprev);
+    }
+};
+
+/**
+ * @brief Hierarchical timing wheel
+ *
+ * Time is kept in usec. Level L has 64 slots each spanning 64^L usec. An event is kept in the level of the highest
+ * 6 bit group where its deadline differs from current time, so schedule and cancel are O(1). Slots of higher levels
+ * are cascaded to lower levels as time reaches them, and occupancy bitmaps let Advance() jump directly to the next
+ * non empty slot instead of visiting every usec.
+ */
+class TimingWheel
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param now INPUT initial time of wheel in usec
+     */
+    explicit TimingWheel(unsigned long long int now = 0);
+
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    /**
+     * @brief Schedule an event at its deadline, rescheduling if it is already scheduled
+     *
+     * Events whose deadline is not after current time are fired in next Advance().
+     * @param event INPUT event to be scheduled, should outlive its scheduled duration
+     */
+    void Schedule(TimerEvent& event);
+
+    /**
+     * @brief Remove an event from wheel, no operation if event is not scheduled
+     *
+     * @param event INPUT event to be removed
+     */
+    void Cancel(TimerEvent& event);
+
+    /**
+     * @brief Advance wheel time firing every event whose deadline is reached
+     *
+     * Handler is called as handler(event, deadline), slot by slot in time order. Periodic events are re-armed before handler
+     * is called, so that handler is free to cancel the event or even destroy owner of a one shot event.
+     * @param now INPUT new time in usec, should not be less than current time
+     * @param handler INPUT callable that will handle fired events
+     */
+    template <typename Handler>
+    void Advance(unsigned long long int now, Handler&& handler);
+
+    /**
+     * @brief Time of earliest scheduled event, TIMING_WHEEL_NEVER if wheel is empty
+     *
+     * For events in higher levels start time of their slot is returned, which is a lower bound of their deadline.
+     */
+    unsigned long long int NextEventTime() const;
+
+    unsigned long long int Now() const
+    {
+        return _now;
+    }
+
+    unsigned int Size() const
+    {
+        return _size;
+    }
+
+private:
+    void _insert(TimerEvent& event);
+    void _unlink(TimerEvent& event);
+    void _setNow(unsigned long long int now);
+    void _cascadeSlot(unsigned int level, unsigned int slot);
+
+private:
+    unsigned long long int _now;
+    unsigned int _size;
+    TimerEvent* _expired;      /**< events that are due, waiting to be fired in fifo order */
+    TimerEvent** _expiredTail; /**< address of next pointer of last expired event */
+    unsigned long long int _occupied[TIMING_WHEEL_LEVELS];
+    TimerEvent* _slots[TIMING_WHEEL_LEVELS][TIMING_WHEEL_SLOTS];
+};
+
+template <typename Handler>
+void TimingWheel::Advance(unsigned long long int now, Handler&& handler)
+{
+    for (;;) {
+        while (_expired) {
+            TimerEvent& event = *_expired;
+            const unsigned long long int deadline = event.deadline;
+            _unlink(event);
+
+            if (event.period && ((deadline + event.period) < event.limit)) {
+                event.deadline = deadline + event.period;
+                _insert(event);
+            }
+
+            handler(event, deadline);
+        }
+
+        if (_now >= now) {
+            return;
+        }
+
+        // jump to next non empty slot or to requested time, whichever comes first
+        const unsigned long long int next_event_time = NextEventTime();
+        const unsigned long long int next_time = (next_event_time > now) ? now : next_event_time;
+        _setNow(next_time);
+        _cascadeSlot(0, (unsigned int)(next_time & (TIMING_WHEEL_SLOTS - 1)));
+    }
+}
+
+} // namespace ddgen
@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @brief transmit stage of lookahead pipeline, packets generated ahead of time are sent when they are due
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include "PacketRing.h"
+#include "consumer.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace ddgen {
+
+#define TRANSMIT_MAX_SLEEP 1000 /**< Transmitter polls its rings at least every 1000usec */
+
+/**
+ * @brief Consumer that queues packets with their due time instead of sending them
+ *
+ * Shard worker is the only producer of its ring and transmitter is the only reader. Acquired packets are written in
+ * place into ring. A packet that does not fit in ring is dropped and counted, generation never blocks on transmit.
+ */
+class LookaheadConsumer : public IConsumer
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param consumer INPUT consumer that packets are sent to when they are due
+     * @param ringSize INPUT size of packet ring in bytes
+     */
+    LookaheadConsumer(const std::shared_ptr<IConsumer>& consumer, std::size_t ringSize);
+
+    virtual bool Consume(const unsigned char* data_ptr, unsigned short int data_size);
+
+    /**
+     * @brief Reserve record of a packet in ring, an overflow buffer is given if ring is full
+     */
+    virtual unsigned char* Acquire(unsigned short int data_size);
+
+    virtual bool Commit(unsigned short int data_size);
+
+    virtual void SetSendTime(unsigned long long int dueTime);
+
+    /**
+     * @brief Send packets that are due, transmitter side
+     *
+     * Packets sent in a call are flushed to consumer together.
+     * @param now INPUT monotonic time in usec
+     * @return due time of earliest packet left in ring, (unsigned long long int)(-1) if ring is empty
+     */
+    unsigned long long int Transmit(unsigned long long int now);
+
+    unsigned long long int GetTransmittedPackets() const
+    {
+        return _transmittedPackets;
+    }
+
+    unsigned long long int GetOverflowPackets() const
+    {
+        return _overflowPackets;
+    }
+
+private:
+    const std::shared_ptr<IConsumer> _consumer;
+    PacketRing _ring;
+    unsigned long long int _dueTime;      /**< due time of packets being consumed, written by producer only */
+    bool _acquiredInRing;                 /**< whether acquired packet is in ring or in overflow buffer */
+    std::vector<unsigned char> _overflow; /**< packet acquired while ring is full, dropped at commit */
+    std::atomic<unsigned long long> _transmittedPackets;
+    std::atomic<unsigned long long> _overflowPackets; /**< packets dropped since ring was full */
+};
+
+/**
+ * @brief Thread that sends packets of lookahead consumers when they fall due
+ *
+ * Transmitter sleeps till earliest due packet of its consumers, but never longer than a millisecond so that packets
+ * queued in the meantime are not delayed much. Packets still queued when transmitter is stopped are sent right away.
+ */
+class Transmitter
+{
+public:
+    explicit Transmitter(const std::vector<std::shared_ptr<LookaheadConsumer>>& consumers);
+
+    /**
+     * @brief Destructor, stops transmit thread if it is still running
+     */
+    ~Transmitter();
+
+    Transmitter(const Transmitter&) = delete;
+    Transmitter& operator=(const Transmitter&) = delete;
+
+    void Start();
+
+    /**
+     * @brief Stop transmit thread after sending all queued packets, producers should be stopped before
+     */
+    void Stop();
+
+private:
+    void _run();
+
+private:
+    const std::vector<std::shared_ptr<LookaheadConsumer>> _consumers;
+    std::atomic<bool> _shallStop;
+    std::thread _worker;
+};
+
+} // namespace ddgen
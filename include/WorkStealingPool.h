@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @brief pool of workers that share the work of a tick by stealing tasks from each other
+ *
+ * @author Sifa Serder Ozen sifa.serder.ozen@gmail.com
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ddgen {
+
+/**
+ * @brief Work stealing pool
+ *
+ * Tasks of a batch are split over per worker deques in contiguous ranges. Each worker pops tasks from back of its own
+ * deque, and when it runs out of work it steals from front of other deques, so that a batch of tasks with uneven cost
+ * finishes in about total cost divided by number of workers. Thread that calls Run() takes part as worker 0.
+ */
+class WorkStealingPool
+{
+public:
+    /**
+     * @brief A unit of work, function is called as function(owner, context, worker)
+     */
+    struct Task
+    {
+        void (*function)(void* owner, void* context, unsigned int worker);
+        void* owner;
+        void* context;
+    };
+
+public:
+    /**
+     * @brief Constructor, starts numberOfWorkers - 1 threads
+     *
+     * @param numberOfWorkers INPUT number of workers including the thread that calls Run()
+     */
+    explicit WorkStealingPool(unsigned int numberOfWorkers);
+
+    /**
+     * @brief Destructor, stops and joins worker threads
+     */
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /**
+     * @brief Execute a batch of tasks and wait for all of them
+     *
+     * @param tasks INPUT tasks to be executed, order of execution is not defined
+     */
+    void Run(const std::vector<Task>& tasks);
+
+    unsigned int GetNumberOfWorkers() const
+    {
+        return _numberOfWorkers;
+    }
+
+    /**
+     * @brief Number of tasks that are executed by a worker other than the one they are assigned to
+     */
+    unsigned long long int GetStolenTasks() const
+    {
+        return _stolenTasks;
+    }
+
+private:
+    /**
+     * @brief Deque of a worker, owner takes from back and thieves take from front
+     */
+    struct TaskDeque
+    {
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        unsigned int front;
+    };
+
+    void _workerLoop(unsigned int worker);
+    void _work(unsigned int worker);
+    bool _pop(unsigned int worker, Task& task);
+    bool _steal(unsigned int thief, Task& task);
+
+private:
+    const unsigned int _numberOfWorkers;
+    std::vector<TaskDeque> _deques;
+    std::vector<std::thread> _threads;
+
+    std::mutex _mutex;
+    std::condition_variable _startCondition;
+    std::condition_variable _doneCondition;
+    unsigned long long int _generation; /**< incremented at each batch, wakes worker threads */
+    bool _shallStop;
+
+    std::atomic<unsigned int> _remainingTasks;
+    std::atomic<unsigned long long int> _stolenTasks;
+};
+
+} // namespace ddgen
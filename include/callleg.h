@@ -9,37 +9,104 @@
 
 #include "CallLogger.h"
 #include "CallParameters.h"
+#include "ClipLibrary.h"
+#include "PacketTemplate.h"
+#include "PayloadCache.h"
+#include "TimingWheel.h"
 #include "consumer.h"
 #include "encoder.h"
 #include "generator.h"
 
+#include <cstddef>
 #include <memory>
 #include <vector>
 
 namespace ddgen {
-#define MAX_PCM_DATA_SIZE 8000
+#define MAX_CALL_LEGS 8 /**< maximum number of legs that a call may have */
+
+class Call;
+class G722EncoderType;
+struct BatchPayload;
+
+/**
+ * @brief Overload bookkeeping of a call leg, packets that are not sent on time
+ */
+struct OverloadState
+{
+    unsigned long long int bursted;  /**< late packets that are sent in a catch up burst */
+    unsigned long long int deferred; /**< late packets that are sent in a later tick, stretched or from backlog */
+    unsigned long long int dropped;  /**< packets that are skipped or still in backlog at end of call */
+    unsigned int backlog;            /**< late packets waiting to be sent, counted once they are sent or dropped */
+    unsigned int burstStamp;         /**< advance of worker that burstCount belongs to */
+    unsigned int burstCount;         /**< packets sent in advance burstStamp */
+
+    OverloadState() : bursted(0), deferred(0), dropped(0), backlog(0), burstStamp(0), burstCount(0)
+    {
+    }
+};
 
 /**
  * @brief Class that will encapsulate call leg information.
+ *
+ * A leg only keeps its headers, counters and codec state. Headers are serialized once into a packet template and only
+ * fields that change between packets are patched when a packet is built. Packets are written in place into memory
+ * acquired from consumer, and pcm is generated in a per thread scratch buffer, so that memory of a leg does not depend
+ * on maximum packet size.
+ * Packet path is selected once at construction from concrete types of encoder and generator. Known sample wise pairs
+ * (G711 with periodic tone or zero generators) use a path specialized on their types, where generation and encoding are
+ * fused into a single inlined loop, other pairs use virtual Generate() and Encode(). A continuous tone is generated a
+ * block at a time by simd kernels, so it is not fused. A leg whose encoder is memoryless and whose tone is periodic
+ * copies its payloads from a cycle of encoded packets that is shared by all such legs, with no generation or encoding
+ * at all. A leg that plays a clip has neither encoder nor generator, it copies payloads from its mapped clip. A leg
+ * with a G722 encoder may have its payload encoded in a batch together with other legs that are due, it then sends that
+ * payload instead of encoding one.
  */
 class CallLeg
 {
 private:
-    RtpHeaderType m_rtp_header;                /**< rtp header */
-    UdpHeaderType m_udp_header;                /**< udp header */
-    Ipv4HeaderType m_ipv4_header;              /**< ipv4 header */
-    EthHeaderType m_eth_header;                /**< ethernet header */
-    PseudoIpv4HeaderType m_pseudo_ipv4_header; /**< pseudo ipv4 header that will be used in header checksum */
+    typedef bool (*SendFunction)(CallLeg& callLeg, IConsumer& consumer);
 
-    unsigned int m_remaining_time;        /**< remaining time in ms in this call leg */
-    unsigned int m_accumulated_step_time; /**< accumulated step time that is not handled yet */
+    RtpHeaderType m_rtp_header;       /**< rtp header */
+    UdpHeaderType m_udp_header;       /**< udp header */
+    Ipv4HeaderType m_ipv4_header;     /**< ipv4 header */
+    PacketTemplate m_packet_template; /**< headers in network byte order, written in front of each payload */
 
-    EncoderType* m_encoder_ptr;           /**< encoder that will be used in waveform encoding */
-    GeneratorType* m_generator_ptr;       /**< waveform generator */
+    unsigned int m_packet_slot;     /**< slot of leg in packet schedule of its shard */
+    OverloadState m_overload_state; /**< packets of this leg that are not sent on time */
+    Call* m_call;                   /**< call that leg belongs to */
+    unsigned int m_due_packets;     /**< packets to be sent by the worker that takes the call in work stealing mode */
+    unsigned long long int m_due_time; /**< deadline of latest due packet in work stealing mode, in usec of shard time */
+
+    EncoderHandle m_encoder;              /**< pooled encoder that will be used in waveform encoding */
+    GeneratorHandle m_generator;          /**< pooled waveform generator */
     std::shared_ptr<IConsumer> _consumer; /**< consumer that will be used to handle packets */
+    unsigned short int m_rtp_data_size;   /**< rtp payload size of encoder, in bytes */
+    unsigned short int m_pcm_size;        /**< samples that encoder takes for a packet, zero for clips */
+    unsigned short int m_timestamp_step;  /**< rtp timestamp increment of a packet, in RTP_CLOCK_RATE ticks */
+    SendFunction m_send_function;         /**< packet path selected for encoder and generator of leg */
+
+    BatchPayload* m_batch_payload;           /**< payload of next packet that is encoded in a batch, null if there is none */
+    const unsigned char* m_stored_payloads;  /**< shared payloads of a tone cycle or a clip, null if payloads are generated */
+    const unsigned short int* m_stored_sums; /**< ones complement sum of each stored payload */
+    unsigned int m_number_of_stored_payloads;
+    unsigned int m_stored_payload; /**< stored payload that is sent next */
+
+    static SendFunction SelectSendFunction(const EncoderType& encoder, const GeneratorType& generator);
+    static bool SendGenericPacket(CallLeg& callLeg, IConsumer& consumer);
+    static bool SendStoredPacket(CallLeg& callLeg, IConsumer& consumer);
+    static bool SendBatchedPacket(CallLeg& callLeg, IConsumer& consumer);
+    template <typename Encoder, typename Generator>
+    static bool SendFusedPacket(CallLeg& callLeg, IConsumer& consumer);
 
-    short int m_pcm_data_ptr[MAX_PCM_DATA_SIZE] = { 0 }; /**< maximum rtp data size */
-    LineDataType m_line_data;                            /**< line array that will hold raw data to be processed */
+    /**
+     * @brief Write header template in front of an encoded payload, commit packet to consumer and advance header fields
+     *
+     * @param eth_hdr_ptr INPUT start of packet acquired from consumer, payload should already be written after headers
+     * @param payload_sum INPUT ones complement sum of payload
+     * @param consumer INPUT consumer that will handle the packet
+     * @return false if consumer dropped the packet, header fields advance anyway as for a lost packet
+     */
+    bool CompletePacket(unsigned char* eth_hdr_ptr, unsigned short int payload_sum, IConsumer& consumer);
 
 public:
     /**
@@ -57,6 +124,8 @@ public:
      * @param encoder_factory_ptr INPUT encoder factory that will be used in creating encoder
      * @param generator_factory_ptr INPUT generator factory that will be used in creating waveform generator
      * @param consumer_ptr INPUT consumer that will be used to handle generated packet
+     * @param payload_cache_ptr INPUT cache that payloads are taken from if possible, null to generate every payload
+     * @param clip_library_ptr INPUT library that leg takes a clip from, factories are not used then, null to not use clips
      */
     CallLeg(unsigned int src_addr,
             unsigned short int src_port,
@@ -68,32 +137,192 @@ public:
             unsigned short int seq_num,
             EncoderFactory* encoder_factory_ptr,
             GeneratorFactory* generator_factory_ptr,
-            const std::shared_ptr<IConsumer>& consumer);
+            const std::shared_ptr<IConsumer>& consumer,
+            PayloadCache* payload_cache_ptr = nullptr,
+            ClipLibrary* clip_library_ptr = nullptr);
 
     /**
      * @brief Destructor method
      *
-     * In destructor dynamically created variables encoder and waveform generator will be freed.
-     * @see m_encoder_ptr
-     * @see m_generator_ptr
+     * Encoder and waveform generator, if leg has them, are returned to pools of their factories by their handles.
+     * @see m_encoder
+     * @see m_generator
+     */
+    ~CallLeg() = default;
+
+    /**
+     * @brief Call legs are placed in call leg slab
+     *
+     * @see Call::ReserveSlots()
+     */
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr);
+
+    /**
+     * @brief Generate next packet of leg and hand it to consumer
+     *
+     * @return success of operation
+     */
+    bool SendPacket();
+
+    /**
+     * @brief Generate next packet of leg and hand it to given consumer instead of consumer of leg
+     *
+     * @param consumer INPUT consumer that will handle the packet
+     * @return success of operation
+     */
+    bool SendPacket(IConsumer& consumer);
+
+    /**
+     * @brief Skip next packet of leg without generating it
+     *
+     * Sequence number, timestamp and ip id are advanced, as if packet is lost on the way.
+     */
+    void SkipPacket();
+
+    /**
+     * @brief Packet interval of leg in usec, as determined by encoder
+     */
+    unsigned int GetPacketInterval() const;
+
+    unsigned int GetPacketSlot() const
+    {
+        return m_packet_slot;
+    }
+
+    void SetPacketSlot(unsigned int packetSlot)
+    {
+        m_packet_slot = packetSlot;
+    }
+
+    OverloadState& GetOverloadState()
+    {
+        return m_overload_state;
+    }
+
+    Call* GetCall() const
+    {
+        return m_call;
+    }
+
+    void SetCall(Call* call)
+    {
+        m_call = call;
+    }
+
+    unsigned int& GetDuePackets()
+    {
+        return m_due_packets;
+    }
+
+    unsigned long long int& GetDueTime()
+    {
+        return m_due_time;
+    }
+
+    /**
+     * @brief G722 encoder of leg if its payloads may be encoded in batches with other legs, null otherwise
+     *
+     * @see EncodeBatcher()
+     */
+    G722EncoderType* GetBatchEncoder() const;
+
+    /**
+     * @brief Generate pcm of next packet of a leg that takes part in a batch, batch encodes it into batch payload
+     *
+     * @param pcm_data_ptr OUTPUT should hold packet size of encoder of samples
+     * @return success of generation
+     */
+    bool GenerateBatchPcm(short int* pcm_data_ptr);
+
+    /**
+     * @brief Payload of next packet that is encoded in a batch, null if leg encodes its next packet by itself
+     */
+    BatchPayload* GetBatchPayload() const
+    {
+        return m_batch_payload;
+    }
+
+    /**
+     * @brief Next packet is sent with given payload of a batch instead of being encoded by leg
+     *
+     * Payload should be encoded before next packet is sent, leg moves on to payload linked to it as that packet is sent.
+     *
+     * @param batchPayload INPUT payload of next packet in a batch
      */
-    ~CallLeg();
+    void SetBatchPayload(BatchPayload* batchPayload)
+    {
+        m_batch_payload = batchPayload;
+    }
 
-    void Step(unsigned short int stepDuration); /**< Make a step in simulation */
+    /**
+     * @brief Next packet is encoded by leg itself, when it is left out of its batch or batch is dropped before it is sent
+     */
+    void ClearBatchPayload()
+    {
+        m_batch_payload = nullptr;
+    }
 
     CallParameters::StreamParameters GetParameters() const;
 };
 
+/**
+ * @brief Legs of a call, iterable with range based for
+ */
+class CallLegRange
+{
+public:
+    CallLegRange(const std::unique_ptr<CallLeg>* first, const std::unique_ptr<CallLeg>* last) : _first(first), _last(last)
+    {
+    }
+
+    const std::unique_ptr<CallLeg>* begin() const
+    {
+        return _first;
+    }
+
+    const std::unique_ptr<CallLeg>* end() const
+    {
+        return _last;
+    }
+
+    unsigned int size() const
+    {
+        return (unsigned int)(_last - _first);
+    }
+
+private:
+    const std::unique_ptr<CallLeg>* _first;
+    const std::unique_ptr<CallLeg>* _last;
+};
+
 /**
  * @brief Base class that will encapsulate call information.
+ *
+ * Calls and their legs are placed in fixed size slabs that are reserved once with ReserveSlots(), so that creating
+ * and destroying calls in steady state does not allocate from heap. Legs are kept in a fixed array inside the call.
  */
 class Call
 {
 protected:
     Call(unsigned int duration, const std::shared_ptr<ICallLogger>& callLogger);
-    std::vector<std::unique_ptr<CallLeg>> m_call_leg_ptr_vector;
+
+    /**
+     * @brief Append a leg to call
+     *
+     * @param call_leg INPUT leg that will be owned by call
+     * @return false if call already has MAX_CALL_LEGS legs
+     */
+    bool AddCallLeg(std::unique_ptr<CallLeg> call_leg);
+
+    std::unique_ptr<CallLeg> m_call_legs[MAX_CALL_LEGS];
+    unsigned int m_number_of_call_legs;
     unsigned int m_duration;
     const std::shared_ptr<ICallLogger> _callLogger;
+    TimerEvent m_expiry_event; /**< timing wheel event for end of call */
+    unsigned int m_index;      /**< index of call in the table of its owner */
+    unsigned int m_work_stamp; /**< last advance of owner that call is added to work list in */
+    unsigned int m_consumer;   /**< consumer of owner that packets of call are sent through */
 
 public:
     struct Options
@@ -103,6 +332,8 @@ public:
         EncoderFactory* encoder_factory_ptr;
         GeneratorFactory* generator_factory_ptr;
         std::shared_ptr<IConsumer> consumer;
+        PayloadCache* payload_cache_ptr; /**< null if payloads are not cached */
+        ClipLibrary* clip_library_ptr;   /**< null if legs do not play clips */
     };
 
 public:
@@ -111,12 +342,63 @@ public:
     virtual ~Call() = default;
 
     /**
-     * @brief Function to step simulation
+     * @brief Calls are placed in call slab
      *
-     * @param step_duration INPUT duration to simulate a call
-     * @return success of operation
+     * @see ReserveSlots()
+     */
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr);
+
+    /**
+     * @brief Reserve slab slots for calls and their legs
+     *
+     * @param numberOfCalls INPUT maximum number of calls that will exist at the same time
+     * @param numberOfCallLegs INPUT number of legs of each call
      */
-    virtual bool Step(unsigned int step_duration);
+    static void ReserveSlots(unsigned int numberOfCalls, unsigned int numberOfCallLegs);
+
+    /**
+     * @brief Duration of call in ms
+     */
+    unsigned int GetDuration() const
+    {
+        return m_duration;
+    }
+
+    CallLegRange GetCallLegs() const
+    {
+        return CallLegRange(m_call_legs, m_call_legs + m_number_of_call_legs);
+    }
+
+    TimerEvent& GetExpiryEvent()
+    {
+        return m_expiry_event;
+    }
+
+    unsigned int GetIndex() const
+    {
+        return m_index;
+    }
+
+    void SetIndex(unsigned int index)
+    {
+        m_index = index;
+    }
+
+    unsigned int& GetWorkStamp()
+    {
+        return m_work_stamp;
+    }
+
+    unsigned int GetConsumer() const
+    {
+        return m_consumer;
+    }
+
+    void SetConsumer(unsigned int consumer)
+    {
+        m_consumer = consumer;
+    }
 
     virtual void Log();
 };
@@ -160,6 +442,11 @@ public:
     virtual ~ICallFactory() = default;
 
     virtual std::unique_ptr<Call> CreateCall(const Call::Options& options) = 0;
+
+    /**
+     * @brief Number of legs that each created call has
+     */
+    virtual unsigned int GetNumberOfCallLegs() const = 0;
 };
 
 class DRLinkCallFactory : public ICallFactory
@@ -184,6 +471,11 @@ public:
      * @see MirrorCall()
      */
     virtual std::unique_ptr<Call> CreateCall(const Call::Options& options);
+
+    virtual unsigned int GetNumberOfCallLegs() const
+    {
+        return m_dst_inf.size();
+    }
 };
 
 class MirrorCallFactory : public ICallFactory
@@ -207,6 +499,11 @@ public:
      * @see SingleToneGeneratorType()
      */
     virtual std::unique_ptr<Call> CreateCall(const Call::Options& options);
+
+    virtual unsigned int GetNumberOfCallLegs() const
+    {
+        return 2;
+    }
 };
 
 class CallFactoryFactory
@@ -217,6 +514,7 @@ public:
         Traffic traffic;
         std::vector<IpPort> drlinkIpPortVector;
         unsigned int startIp;
+        unsigned int numberOfCalls; /**< maximum number of simultaneous calls, used in reserving call slabs */
     };
 
 public:
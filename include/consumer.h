@@ -8,12 +8,16 @@
 #pragma once
 
 #include "CallStorage.h"
+#include "Clock.h"
 #include "ipport.h"
 #include "rawsocket.h"
 
-#include <fstream>
+#include <cstddef>
 #include <memory>
 #include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <vector>
 
 namespace ddgen {
@@ -24,16 +28,32 @@ namespace ddgen {
  */
 void GetCurrentTimeInTv(unsigned int& sec, unsigned int& usec);
 
+/**
+ * @brief A packet of a batch
+ */
+struct PacketDescriptor
+{
+    const unsigned char* data; /**< packet, starting with its ethernet header */
+    unsigned short int size;
+    unsigned long long int timestamp; /**< time packet is consumed at in usec since epoch */
+    int destination;                  /**< index of destination in consumer, negative if it is found from packet headers */
+};
+
 /**
  * @brief Abstract packet consumer interface
  *
- * Consumer interface
+ * Consumer interface, packets are either handed over built with Consume(), or written in place into memory of consumer
+ * with Acquire() and Commit(). Consumers that keep packets in memory of their own override the latter pair so that a
+ * packet is written once, others get it through Consume() from a buffer of the interface. Consumers that can hand a
+ * number of packets to system at once override ConsumeBatch().
  * @see SocketConsumer()
  * @see PcapConsumer()
  */
 class IConsumer
 {
 private:
+    std::vector<unsigned char> _acquired; /**< packet acquired by default Acquire() */
+
 public:
     /**
      * @brief Default constructor, does not perform any specific operation
@@ -57,6 +77,54 @@ public:
      * @return indicates success of generation
      */
     virtual bool Consume(const unsigned char* data_ptr, unsigned short int data_size) = 0;
+
+    /**
+     * @brief Reserve room for a packet in output memory of consumer
+     *
+     * Packet is written into returned memory and handed over with Commit(), at most one packet may be acquired at a time.
+     * Room is always given, a packet that can not be kept is dropped at Commit().
+     * @param data_size INPUT maximum size of packet
+     * @return pointer to data_size bytes that packet is written to
+     */
+    virtual unsigned char* Acquire(unsigned short int data_size);
+
+    /**
+     * @brief Consume packet written into memory returned by last Acquire()
+     *
+     * @param data_size INPUT size of packet, not more than acquired size
+     * @return indicates success of consumption
+     */
+    virtual bool Commit(unsigned short int data_size);
+
+    /**
+     * @brief Consume a batch of packets, default implementation consumes them one by one
+     *
+     * @param packets INPUT descriptors of packets, in order they should be consumed
+     * @param numberOfPackets INPUT number of descriptors
+     * @return false if any of packets could not be consumed
+     */
+    virtual bool ConsumeBatch(const PacketDescriptor* packets, std::size_t numberOfPackets);
+
+    /**
+     * @brief Hand over packets that are collected so far, called at end of every tick
+     *
+     * Consumers that do not collect packets ignore it.
+     * @return false if collected packets could not be consumed
+     */
+    virtual bool Flush()
+    {
+        return true;
+    }
+
+    /**
+     * @brief Set monotonic time that following packets are due to be sent at
+     *
+     * Consumers that send packets as they are consumed ignore it, consumers that buffer packets ahead of time use it.
+     * @param dueTime INPUT monotonic time in usec
+     */
+    virtual void SetSendTime(unsigned long long int dueTime)
+    {
+    }
 };
 
 /**
@@ -71,6 +139,16 @@ class SocketConsumer : public IConsumer
 private:
     std::vector<int> m_dst_sock_vector;             /**< destination socket vector */
     std::vector<sockaddr_in> m_dst_sockaddr_vector; /**< destination socket addr */
+    std::vector<std::vector<mmsghdr>> m_messages;   /**< messages of a batch, per destination socket */
+    std::vector<iovec> m_iovecs;                    /**< data of messages of a batch */
+
+    /**
+     * @brief Find destination of a packet from its ipv4 and udp headers
+     *
+     * Packets with no matching destination go to first destination, possible pair mode.
+     * @return index of destination, -1 if there is no socket
+     */
+    int FindDestination(const unsigned char* data_ptr) const;
 
 public:
     /**
@@ -93,12 +171,21 @@ public:
      * @return indicates success of generation
      */
     virtual bool Consume(const unsigned char* data_ptr, unsigned short int data_size);
+
+    /**
+     * @brief Send packets of a batch with a sendmmsg() per destination socket
+     */
+    virtual bool ConsumeBatch(const PacketDescriptor* packets, std::size_t numberOfPackets);
 };
 
+#define PCAP_BLOCK_SIZE (1 << 18) /**< pcap records are collected in 256KB blocks before they are written to file */
+
 /**
  * @brief PcapConsumer realization
  *
- * Pcap Consumer that will consume packets through writing a pcap file
+ * Pcap Consumer that will consume packets through writing a pcap file. Records are built in place in a block that is
+ * written to file when it is full and when consumer is destroyed, so that a packet is copied neither by consumer nor
+ * by file stream. Batches are written with a single writev() straight from memory of their packets.
  * @see Consumer()
  * @see SocketConsumer()
  */
@@ -134,9 +221,15 @@ private:
 
 private:
     std::shared_ptr<ICallStorage> _callStorage;
+    std::shared_ptr<IClock> _clock;                                           /**< clock that packets are stamped with */
+    std::string _tag;                                                         /**< tag that is appended to generated file name */
     std::string _fileName;                                                    /**< file name for pcap file */
-    std::fstream _fileStream;                                                 /**< file stream for pcap file */
+    int _fileDescriptor;                                                      /**< pcap file, -1 if it is not open */
     unsigned int _fileSize;                                                   /**< An integer that shows size of pcap file. */
+    std::vector<unsigned char> _block;                                        /**< records not written to file yet */
+    std::size_t _blockUsed;                                                   /**< size of records in block */
+    std::vector<PcapPacHdrType> _batchHeaders;                                /**< pcap headers of packets of a batch */
+    std::vector<iovec> _batchVectors;                                         /**< pcap header and data of each packet of a batch */
     const PcapHdrType _pcapFileHeader = { 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1 }; /**< pcap file haader for .pcap */
 
     /** @brief Generates file name
@@ -144,13 +237,27 @@ private:
     */
     void GenerateFileName();
 
+    /** @brief Open pcap file for appending if it is not open yet
+        @return false if file can not be opened
+    */
+    bool OpenFile();
+
+    /** @brief Write records in block to file and empty block, records are dropped if file can not be written
+        @return false if records are dropped
+    */
+    bool FlushBlock();
+
 public:
     /**
      * @brief Constructor for initializing pcap file consumer
      *
-     * @param file_name INPUT desired filename of pcap file. If already present, overriden
+     * @param callStorage INPUT storage that generated pcap file will be handed to when consumer is destroyed
+     * @param tag INPUT tag that will be appended to time based file name, used to distinguish consumers of different shards
+     * @param clock INPUT clock that packets are stamped with, system clock is used if omitted
      */
-    explicit PcapConsumer(const std::shared_ptr<ICallStorage>& callStorage);
+    explicit PcapConsumer(const std::shared_ptr<ICallStorage>& callStorage,
+                          const std::string& tag = "",
+                          const std::shared_ptr<IClock>& clock = nullptr);
 
     /**
      * @brief destructor, does close pcap file
@@ -165,5 +272,20 @@ public:
      * @return indicates success of generation
      */
     virtual bool Consume(const unsigned char* data_ptr, unsigned short int data_size);
+
+    /**
+     * @brief Reserve record of a packet in block, pcap header is left to Commit()
+     */
+    virtual unsigned char* Acquire(unsigned short int data_size);
+
+    /**
+     * @brief Stamp acquired packet with current time and append it to block
+     */
+    virtual bool Commit(unsigned short int data_size);
+
+    /**
+     * @brief Write packets of a batch stamped with their timestamps, after records in block
+     */
+    virtual bool ConsumeBatch(const PacketDescriptor* packets, std::size_t numberOfPackets);
 };
 } // namespace ddgen
@@ -7,14 +7,63 @@
 
 #pragma once
 
+#include "ObjectPool.h"
+
 namespace ddgen {
 
 #define G711_PACKET_SIZE 160       /**< G711 packet size is 160 samples, 20ms data at 8kHz sampling */
 #define G722_PACKET_SIZE 320       /**< G722 packet size is 320 sapmles, 20ms data at 16kHz sampling */
 #define PACKET_DURATION 20         /**< Default packet duration is 20ms */
+#define RTP_CLOCK_RATE 8000        /**< rtp clock of G711 and G722 is 8kHz, G722 keeps it though it samples at 16kHz (RFC 3551) */
 #define G711a_RTP_PAYLOAD_TYPE 0x8 //*< G711a rtp payload type */
 #define G711u_RTP_PAYLOAD_TYPE 0x0 //*< G711u rtp payload type */
 #define G722_RTP_PAYLOAD_TYPE 0x9  //*< G722 rtp payload type */
+#define G711a_TABLE_INDEX_BITS 12  /**< a law code depends only on sign and 11 bits of magnitude of a pcm sample */
+#define G711u_TABLE_INDEX_BITS 14  /**< u law code depends only on sign and 13 bits of magnitude of a pcm sample */
+
+/**
+ * @brief Code of every pcm index of a G711 encoder, generated at compile time from its reference encoder
+ *
+ * Index is the top IndexBits bits of a pcm sample, as its two's complement bit pattern.
+ */
+template <unsigned int IndexBits>
+struct G711EncodingTable
+{
+    unsigned char codes[1 << IndexBits];
+
+    constexpr explicit G711EncodingTable(unsigned char (*encode)(short int)) : codes()
+    {
+        for (unsigned int index = 0; index < (1u << IndexBits); ++index) {
+            codes[index] = encode((short int)(index << (16 - IndexBits)));
+        }
+    }
+
+    static unsigned int GetIndex(short int pcm_data)
+    {
+        return (unsigned short int)pcm_data >> (16 - IndexBits);
+    }
+};
+
+/**
+ * @brief Kernels of G711 Encode(), encoding a number of samples, all give the same result as reference encoders
+ *
+ * Scalar kernels look codes up from encoding tables. Sse4.1, avx2 and avx512 kernels encode 16 samples at a time
+ * without branches, segment of a sample is position of its leading one, which is read from exponent of the sample
+ * converted to float. They exist only on x86 and should be called only if cpu supports them, remaining samples are
+ * encoded with tables.
+ * @see KernelRegistry()
+ */
+void G711aEncodeScalar(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples);
+void G711uEncodeScalar(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples);
+#if defined(__x86_64__) || defined(__i386__)
+#define G711_ENCODE_SIMD 1 /**< sse4.1, avx2 and avx512 kernels are available, to be used if cpu supports them */
+void G711aEncodeSse41(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples);
+void G711uEncodeSse41(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples);
+void G711aEncodeAvx2(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples);
+void G711uEncodeAvx2(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples);
+void G711aEncodeAvx512(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples);
+void G711uEncodeAvx512(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples);
+#endif
 
 /**
  * @brief Abstract encoder interface
@@ -66,6 +115,17 @@ public:
      */
     virtual unsigned short int GetPacketSize() const = 0;
 
+    /**
+     * @brief Default interface for obtaining size of an encoded packet
+     *
+     * @return bytes that Encode() writes for a packet, a byte per sample by default
+     * @see GetPacketSize()
+     */
+    virtual unsigned short int GetPayloadSize() const
+    {
+        return GetPacketSize();
+    }
+
     /**
      * @brief Default interface for obtaining packet duration
      *
@@ -77,8 +137,28 @@ public:
     {
         return PACKET_DURATION;
     }
+
+    /**
+     * @brief Default interface for resetting encoder state, called before a pooled encoder is reused for another leg
+     */
+    virtual void Reset()
+    {
+    }
+
+    /**
+     * @brief Default interface telling whether each encoded sample depends only on its pcm sample
+     *
+     * Encoded payloads of a memoryless encoder repeat whenever its input repeats, so that they may be cached.
+     * @return false, encoder is assumed to keep state between samples
+     */
+    virtual bool IsMemoryless() const
+    {
+        return false;
+    }
 };
 
+typedef ObjectPool<EncoderType>::Handle EncoderHandle; /**< pooled encoder, returned to its factory when destroyed */
+
 /**
  * @brief G711aEncoder realization
  *
@@ -117,6 +197,46 @@ public:
      */
     virtual bool Encode(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr);
 
+    /**
+     * @brief a law encoding of a single sample, inline so that it can be fused with waveform generation
+     *
+     * @param pcm_data INPUT pcm sample
+     * @return encoded sample
+     */
+    static unsigned char EncodeSample(short int pcm_data)
+    {
+        return _encodingTable.codes[G711EncodingTable<G711a_TABLE_INDEX_BITS>::GetIndex(pcm_data)];
+    }
+
+    /**
+     * @brief Reference a law encoding of a single sample, encoding table is generated from it
+     *
+     * Segment is found by shifting quantization value till it falls under 32.
+     * @param pcm_data INPUT pcm sample
+     * @return encoded sample
+     */
+    static constexpr unsigned char EncodeSampleReference(short int pcm_data)
+    {
+        unsigned char encoded_data = 0;
+        short int quantization_value = (pcm_data < 0) ? ((~pcm_data) >> 4) : (pcm_data >> 4);
+
+        if (quantization_value > 15) {
+            short int quantization_segment = 1;
+            while (quantization_value > (16 + 15)) {
+                quantization_value >>= 1;
+                quantization_segment++;
+            }
+            quantization_value -= 16;
+
+            encoded_data = quantization_value + (quantization_segment << 4);
+        }
+
+        if (pcm_data >= 0)
+            encoded_data |= 0x80;
+
+        return encoded_data ^ 0x55;
+    }
+
     /**
      * @brief implementation for getting rtp payload
      *
@@ -137,6 +257,18 @@ public:
     {
         return G711_PACKET_SIZE;
     }
+
+    /**
+     * @brief G711 encodes each sample on its own
+     *
+     * @return true
+     */
+    virtual bool IsMemoryless() const
+    {
+        return true;
+    }
+private:
+    static const G711EncodingTable<G711a_TABLE_INDEX_BITS> _encodingTable; /**< generated from EncodeSampleReference() */
 };
 
 /**
@@ -177,6 +309,44 @@ public:
      */
     virtual bool Encode(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr);
 
+    /**
+     * @brief u law encoding of a single sample, inline so that it can be fused with waveform generation
+     *
+     * @param pcm_data INPUT pcm sample
+     * @return encoded sample
+     */
+    static unsigned char EncodeSample(short int pcm_data)
+    {
+        return _encodingTable.codes[G711EncodingTable<G711u_TABLE_INDEX_BITS>::GetIndex(pcm_data)];
+    }
+
+    /**
+     * @brief Reference u law encoding of a single sample, encoding table is generated from it
+     *
+     * Segment is found by counting bits of quantization value.
+     * @param pcm_data INPUT pcm sample
+     * @return encoded sample
+     */
+    static constexpr unsigned char EncodeSampleReference(short int pcm_data)
+    {
+        short int quantization_value = (pcm_data < 0) ? (((~pcm_data) >> 2) + 33) : ((pcm_data >> 2) + 33);
+
+        if (quantization_value > (0x1FFF)) // clip to 8192
+            quantization_value = (0x1FFF);
+
+        short int quantization_segment = 1;
+        // Determination of quantization segment
+        for (short int i = (quantization_value >> 6); i; i >>= 1)
+            quantization_segment++;
+
+        unsigned char encoded_data = (((0x08 - quantization_segment) << 4) | (0x000F - ((quantization_value > quantization_segment) & 0x000F)));
+
+        if (pcm_data >= 0)
+            encoded_data |= 0x80;
+
+        return encoded_data;
+    }
+
     /**
      * @brief implementation for getting rtp payload
      *
@@ -197,23 +367,46 @@ public:
     {
         return G711_PACKET_SIZE;
     }
+
+    /**
+     * @brief G711 encodes each sample on its own
+     *
+     * @return true
+     */
+    virtual bool IsMemoryless() const
+    {
+        return true;
+    }
+private:
+    static const G711EncodingTable<G711u_TABLE_INDEX_BITS> _encodingTable; /**< generated from EncodeSampleReference() */
 };
 
 /**
  * @brief Abstract encoder factory interface
  *
- * Encoder factory interface
+ * Encoder factory interface. Encoders are handed out from a pool of factory, and are reset and returned to it when
+ * their handle is destroyed, so that factory should outlive encoders it has created.
  * @see G711aEncoderFactory()
  * @see G711uEncoderFactory()
  */
 class EncoderFactory
 {
 private:
+    mutable ObjectPool<EncoderType> _pool; /**< encoders that are created by NewEncoder() */
+
+protected:
+    /**
+     * @brief pure virtual interface for constructing a new encoder when pool is empty
+     *
+     * @return Constructed encoder
+     */
+    virtual EncoderType* NewEncoder() const = 0;
+
 public:
     /**
-     * @brief Default constructor, does not perform any specific operation
+     * @brief Default constructor, pool is initially empty
      */
-    EncoderFactory()
+    EncoderFactory() : _pool([this]() { return NewEncoder(); })
     {
     }
 
@@ -225,11 +418,24 @@ public:
     }
 
     /**
-     * @brief pure virtual interface for encoder generation
+     * @brief Encoder generation, a pooled encoder is reused if there is any
+     *
+     * @return Handle of encoder
+     */
+    EncoderHandle CreateEncoder() const
+    {
+        return _pool.Acquire();
+    }
+
+    /**
+     * @brief Construct encoders up front, so that creating that many encoders does not allocate
      *
-     * @return Generated encoder
+     * @param numberOfEncoders INPUT number of encoders that pool should have
      */
-    virtual EncoderType* CreateEncoder() const = 0;
+    void Reserve(unsigned int numberOfEncoders)
+    {
+        _pool.Reserve(numberOfEncoders);
+    }
 };
 
 class G711aEncoderFactory : public EncoderFactory
@@ -251,13 +457,13 @@ public:
     }
 
     /**
-     * @brief Implementation of encoder generation
+     * @brief Implementation of encoder construction
      *
      * @return G711aEncoderType is created and returned to calling object
      * @see EncoderType()
      * @see G711aEncoderType()
      */
-    virtual EncoderType* CreateEncoder() const
+    virtual EncoderType* NewEncoder() const
     {
         return new G711aEncoderType();
     }
@@ -282,13 +488,13 @@ public:
     }
 
     /**
-     * @brief Implementation of encoder generation
+     * @brief Implementation of encoder construction
      *
      * @return G711uEncoderType is created and returned to calling object
      * @see EncoderType()
      * @see G711uEncoderType()
      */
-    virtual EncoderType* CreateEncoder() const
+    virtual EncoderType* NewEncoder() const
     {
         return new G711uEncoderType();
     }
@@ -12,6 +12,7 @@
 namespace ddgen {
 
 #define G722_PACKET_SIZE 320      /**< G722 packet size is 320 sapmles, 20ms data at 16kHz sampling */
+#define G722_BATCH_LANES 16       /**< encoders that are encoded together in a batch, a 16 bit lane of an avx2 register each */
 #define G722_RTP_PAYLOAD_TYPE 0x9 /**< G722 rtp payload type */
 
 /* **** Coefficients for both transmission and reception QMF **** */
@@ -658,9 +659,93 @@ struct FullBandType
  * @see EncoderType()
  * @see G711uEncoderType()
  */
+/**
+ * @brief Kernels of transmit QMF of G722 Encode(), splitting pairs of 16kHz samples into low and high band samples
+ *
+ * First sample of a pair is the older one. Delay line holds 24 past samples of encoder band and is updated by kernel, so
+ * that consecutive calls continue the filter. Scalar kernel is the reference, filtering a pair at a time with saturating
+ * arithmetic and shifting delay line for each pair.
+ *
+ * Sse2, avx2 and avx512 kernels filter 4, 8 and 16 pairs at a time. Delay line is unrolled once per call in front of
+ * the samples, so that taps of a pair are read in place and nothing is shifted per pair. Magnitudes of coefficients add
+ * up to 25928, so sums of the reference stay within 32 bits and its saturating additions never saturate; vector kernels
+ * accumulate with 16 bit multiply and adds into 32 bit lanes, and narrow and clamp outputs with saturating instructions.
+ * They exist only on x86, avx2 and avx512 kernels should be called only if cpu supports them.
+ * @param pcm_data_ptr INPUT 2 * number_of_pairs samples
+ * @param number_of_pairs INPUT number of sample pairs
+ * @param delay_line_ptr INPUT/OUTPUT delay line of encoder band
+ * @param low_band_ptr OUTPUT number_of_pairs low band samples
+ * @param high_band_ptr OUTPUT number_of_pairs high band samples
+ * @see KernelRegistry()
+ */
+void G722QmfTxScalar(const short int* pcm_data_ptr,
+                     unsigned int number_of_pairs,
+                     short int* delay_line_ptr,
+                     short int* low_band_ptr,
+                     short int* high_band_ptr);
+#if defined(__x86_64__) || defined(__i386__)
+#define G722_QMF_SIMD 1 /**< sse2, avx2 and avx512 kernels are available, to be used if cpu supports them */
+void G722QmfTxSse2(const short int* pcm_data_ptr,
+                   unsigned int number_of_pairs,
+                   short int* delay_line_ptr,
+                   short int* low_band_ptr,
+                   short int* high_band_ptr);
+void G722QmfTxAvx2(const short int* pcm_data_ptr,
+                   unsigned int number_of_pairs,
+                   short int* delay_line_ptr,
+                   short int* low_band_ptr,
+                   short int* high_band_ptr);
+void G722QmfTxAvx512(const short int* pcm_data_ptr,
+                     unsigned int number_of_pairs,
+                     short int* delay_line_ptr,
+                     short int* low_band_ptr,
+                     short int* high_band_ptr);
+#endif
+
+class G722EncoderType;
+
+/**
+ * @brief Kernels of G722 encoding a packet of each of a batch of encoders
+ *
+ * ADPCM of a band is serial within an encoder but independent across encoders. Scalar kernel is the reference, it
+ * encodes encoders one after another with Encode(). Avx2 kernel runs transmit QMF of each encoder, transposes band
+ * memories of encoders into 16 bit lanes, so that a lane holds an encoder, and runs lower and upper band ADPCM of all
+ * lanes together sample by sample. Quantizers compare against all thresholds instead of searching, table lookups are
+ * done with byte shuffles and gathers, and band memories are transposed back at the end, so that codes and memories are
+ * exactly those of scalar kernel. It exists only on x86, and should be called only if cpu supports avx2.
+ * @param encoders INPUT/OUTPUT number_of_encoders distinct encoders, band memory of each is advanced by a packet
+ * @param pcm_data_ptrs INPUT G722_PACKET_SIZE samples of each encoder
+ * @param encoded_data_ptrs OUTPUT G722_PACKET_SIZE / 2 codes of each encoder
+ * @param number_of_encoders INPUT 1 to G722_BATCH_LANES
+ * @see G722EncoderType::EncodeBatch()
+ */
+void G722EncodeBatchScalar(G722EncoderType* const* encoders,
+                           const short int* const* pcm_data_ptrs,
+                           unsigned char* const* encoded_data_ptrs,
+                           unsigned int number_of_encoders);
+#if defined(__x86_64__) || defined(__i386__)
+#define G722_BATCH_AVX2 1 /**< avx2 batch kernel is available, to be used if cpu supports it */
+void G722EncodeBatchAvx2(G722EncoderType* const* encoders,
+                         const short int* const* pcm_data_ptrs,
+                         unsigned char* const* encoded_data_ptrs,
+                         unsigned int number_of_encoders);
+#endif
+
 class G722EncoderType : public EncoderType
 {
 private:
+    friend void G722QmfTxScalar(const short int* pcm_data_ptr,
+                                unsigned int number_of_pairs,
+                                short int* delay_line_ptr,
+                                short int* low_band_ptr,
+                                short int* high_band_ptr);
+#if defined(G722_BATCH_AVX2)
+    friend void G722EncodeBatchAvx2(G722EncoderType* const* encoders,
+                                    const short int* const* pcm_data_ptrs,
+                                    unsigned char* const* encoded_data_ptrs,
+                                    unsigned int number_of_encoders);
+#endif
+
     FullBandType band;
 
     static int SaturateAdd(int op1, int op2);
@@ -688,7 +773,6 @@ private:
     void Uppol2(short int* al_ptr, short int* plt_ptr) const;
     short int Filtez(short int* dlt_ptr, short int* bl_ptr) const;
     short int Filtep(short int* rlt_ptr, short int* al_ptr) const;
-    void QmfTx(short int xin0, short int xin1, short int& xl, short int& xh);
     short int LsbCod(short int xl);
     short int HsbCod(short int xh);
 
@@ -714,11 +798,36 @@ public:
      */
     virtual bool Encode(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr);
 
+    /**
+     * @brief Encode a packet of each of a number of encoders together
+     *
+     * Encoders are taken G722_BATCH_LANES at a time by batch kernel of selected level, payloads are exactly those that
+     * Encode() of each encoder would give.
+     * @param encoders INPUT/OUTPUT distinct encoders
+     * @param pcm_data_ptrs INPUT GetPacketSize() samples of each encoder
+     * @param encoded_data_ptrs OUTPUT GetPacketSize() / 2 codes of each encoder
+     * @param number_of_encoders INPUT number of encoders
+     * @return indicates success of encoding, false if a pointer is null
+     * @see G722EncodeBatchScalar()
+     */
+    static bool EncodeBatch(G722EncoderType* const* encoders,
+                            const short int* const* pcm_data_ptrs,
+                            unsigned char* const* encoded_data_ptrs,
+                            unsigned int number_of_encoders);
+
     /**
      * @brief Reset band memory of encoder. Either used before first packer of after a silence period.
      */
     void ResetBand();
 
+    /**
+     * @brief Band memory is reset before encoder is reused for another leg
+     */
+    virtual void Reset()
+    {
+        ResetBand();
+    }
+
     /**
      * @brief implementation for getting rtp payload
      *
@@ -739,6 +848,17 @@ public:
     {
         return G722_PACKET_SIZE;
     }
+
+    /**
+     * @brief Implementation for obtaining size of an encoded packet
+     *
+     * A code byte holds a pair of samples, so that a packet is G722_PACKET_SIZE / 2 bytes.
+     * @return bytes that Encode() writes for a packet
+     */
+    virtual unsigned short int GetPayloadSize() const
+    {
+        return G722_PACKET_SIZE / 2;
+    }
 };
 
 class G722EncoderFactory : public EncoderFactory
@@ -760,13 +880,13 @@ public:
     }
 
     /**
-     * @brief Implementation of encoder generation
+     * @brief Implementation of encoder construction
      *
      * @return G722EncoderType is created and returned to calling object
      * @see EncoderType()
      * @see G722EncoderType()
      */
-    virtual EncoderType* CreateEncoder() const
+    virtual EncoderType* NewEncoder() const
     {
         return new G722EncoderType();
     }
@@ -8,11 +8,69 @@
 #pragma once
 
 #include "CallParameters.h"
+#include "ObjectPool.h"
+#include <climits>
+#include <math.h>
 #include <vector>
 
 namespace ddgen {
 
-#define PI 3.1416 /**< value of pi in radians */
+#define TONE_CYCLE_SAMPLES 800    /**< periodic tones repeat every 800 samples, 100ms at 8kHz sampling */
+#define TONE_CYCLE_PHASES 5       /**< periodic tones start at one of 5 points of their cycle */
+#define TONE_AMPLITUDE_LEVELS 50  /**< amplitude of periodic tones is a multiple of 1/50 */
+
+#define TONE_OSCILLATOR_LANES 8    /**< tone oscillator advances 8 samples at once */
+#define TONE_RENORMALIZE_BLOCKS 16 /**< magnitude of tone oscillator is corrected every 16 blocks, 128 samples */
+
+/**
+ * @brief State of a recursive tone oscillator
+ *
+ * Lane k holds cos and sin of phase of sample k of next block of TONE_OSCILLATOR_LANES samples. Next block is reached
+ * by rotating every lane by TONE_OSCILLATOR_LANES times frequency, so that a sample costs a complex multiplication
+ * rather than a sin() call, and lanes map onto simd registers. Oscillator carries its phase from packet to packet, so
+ * that cos and sin are only called when it is seeded, and its magnitude is pulled back to 1 every
+ * TONE_RENORMALIZE_BLOCKS blocks, so that rounding of rotations does not accumulate over long calls.
+ */
+struct ToneOscillator
+{
+    double cosine[TONE_OSCILLATOR_LANES];
+    double sine[TONE_OSCILLATOR_LANES];
+    double laneCosine[TONE_OSCILLATOR_LANES]; /**< cos of k times frequency, to rebase lanes after a partial block */
+    double laneSine[TONE_OSCILLATOR_LANES];   /**< sin of k times frequency, to rebase lanes after a partial block */
+    double stepCosine;                        /**< cos of TONE_OSCILLATOR_LANES times frequency */
+    double stepSine;                          /**< sin of TONE_OSCILLATOR_LANES times frequency */
+    double gain;                              /**< amplitude * SHRT_MAX */
+    unsigned int blocks;                      /**< blocks since last renormalization */
+};
+
+/**
+ * @brief Seed oscillator at phase, costs a cos and a sin of phase and of frequency
+ *
+ * @param oscillator OUTPUT oscillator, next block starts at phase
+ * @param amplitude INPUT amplitude, between 0 and 1
+ * @param frequency INPUT phase increment per sample in radians
+ * @param phase INPUT phase of first sample
+ */
+void SeedToneOscillator(ToneOscillator& oscillator, float amplitude, float frequency, double phase);
+
+/**
+ * @brief Kernel of tone generation, size samples are taken from oscillator
+ *
+ * Blocks are taken whole, a trailing partial block rebases oscillator, so that calls that continue one another are
+ * phase continuous whatever their sizes are.
+ * @param pcm_data_ptr OUTPUT size samples
+ * @param size INPUT number of samples
+ * @param oscillator INPUT/OUTPUT oscillator, starts at sample after the last one generated after kernel
+ * @see KernelRegistry()
+ */
+void GenerateToneScalar(short int* pcm_data_ptr, unsigned int size, ToneOscillator& oscillator);
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TONE_GENERATE_SIMD 1 /**< sse2, avx2 and avx512 kernels are available, to be used if cpu supports them */
+void GenerateToneSse2(short int* pcm_data_ptr, unsigned int size, ToneOscillator& oscillator);
+void GenerateToneAvx2(short int* pcm_data_ptr, unsigned int size, ToneOscillator& oscillator);
+void GenerateToneAvx512(short int* pcm_data_ptr, unsigned int size, ToneOscillator& oscillator);
+#endif
 
 /**
  * @brief Abstract generator interface
@@ -51,8 +109,17 @@ public:
     virtual bool Generate(short int* pcm_data_ptr, unsigned short int size, unsigned short int duration = 0) = 0;
 
     virtual std::vector<CallParameters::StreamParameters::ToneParameters> GetParameters() const = 0;
+
+    /**
+     * @brief Default interface for resetting generator state, called before a pooled generator is reused for another leg
+     */
+    virtual void Reset()
+    {
+    }
 };
 
+typedef ObjectPool<GeneratorType>::Handle GeneratorHandle; /**< pooled generator, returned to its factory when destroyed */
+
 /**
  * @brief ZeroGenerator realization
  *
@@ -91,13 +158,33 @@ public:
      */
     virtual bool Generate(short int* pcm_data_ptr, unsigned short int size, unsigned short int duration = 0) override;
 
+    /**
+     * @brief Next sample of waveform, inline so that it can be fused with encoding
+     */
+    short int NextSample()
+    {
+        return 0;
+    }
+
+    /**
+     * @brief Complete a packet that is generated through NextSample()
+     */
+    void FinishPacket()
+    {
+    }
+
     std::vector<CallParameters::StreamParameters::ToneParameters> GetParameters() const override;
 };
 
 /**
  * @brief SingleToneGenerator realization
  *
- * Single tone generator
+ * Single tone generator. A periodic generator picks its frequency as a multiple of 2PI/TONE_CYCLE_SAMPLES and its
+ * amplitude as a multiple of 1/TONE_AMPLITUDE_LEVELS, and computes samples from its position in cycle instead of
+ * accumulating phase, so that its waveform repeats exactly every TONE_CYCLE_SAMPLES samples and encoded payloads of
+ * memoryless encoders can be cached. A continuous generator takes its samples from a ToneOscillator, so that it stays
+ * phase continuous over long calls.
+ * @see PayloadCache()
  * @see GeneratorType()
  * @see ZeroGeneratorType()
  * @see SinusoidalGeneratorType()
@@ -106,12 +193,19 @@ class SingleToneGeneratorType : public GeneratorType
 {
 private:
     CallParameters::StreamParameters::ToneParameters _generatorParams;
+    ToneOscillator _oscillator;     /**< oscillator of continuous tone */
+    const bool _periodic;           /**< whether tone is periodic in TONE_CYCLE_SAMPLES */
+    unsigned int _cycleFrequency;   /**< frequency of periodic tone in 2PI/TONE_CYCLE_SAMPLES */
+    unsigned int _cycleAmplitude;   /**< amplitude of periodic tone in 1/TONE_AMPLITUDE_LEVELS */
+    unsigned int _cycleIndex;       /**< position of next sample in cycle of periodic tone */
 
 public:
     /**
      * @brief Default constructor, that does let  constructor determine tone parameters
+     *
+     * @param periodic INPUT whether tone parameters are chosen so that tone is periodic
      */
-    SingleToneGeneratorType();
+    explicit SingleToneGeneratorType(bool periodic = false);
 
     /**
      * @brief Constructor that specify tone parameters explicitly.
@@ -138,7 +232,63 @@ public:
      */
     virtual bool Generate(short int* pcm_data_ptr, unsigned short int size, unsigned short int duration = 0) override;
 
+    /**
+     * @brief Next sample of a periodic tone, inline so that it can be fused with encoding
+     *
+     * Continuous tones are generated only through Generate(), their legs are never fused.
+     */
+    short int NextSample()
+    {
+        const short int sample = GetCycleSample(_cycleIndex);
+        _cycleIndex = (_cycleIndex + 1 == TONE_CYCLE_SAMPLES) ? 0 : _cycleIndex + 1;
+        return sample;
+    }
+
+    /**
+     * @brief Complete a packet that is generated through NextSample()
+     */
+    void FinishPacket()
+    {
+    }
+
+    /**
+     * @brief Sample of periodic tone at given position of its cycle
+     *
+     * @param index INPUT position in cycle, less than TONE_CYCLE_SAMPLES
+     * @return sample of tone
+     */
+    short int GetCycleSample(unsigned int index) const
+    {
+        const unsigned int phase_index = (_cycleFrequency * index) % TONE_CYCLE_SAMPLES;
+        return (short int)((float)_cycleAmplitude / TONE_AMPLITUDE_LEVELS * SHRT_MAX * sin(2 * M_PI * phase_index / TONE_CYCLE_SAMPLES));
+    }
+
+    bool IsPeriodic() const
+    {
+        return _periodic;
+    }
+
+    unsigned int GetCycleFrequency() const
+    {
+        return _cycleFrequency;
+    }
+
+    unsigned int GetCycleAmplitude() const
+    {
+        return _cycleAmplitude;
+    }
+
+    unsigned int GetCycleIndex() const
+    {
+        return _cycleIndex;
+    }
+
     std::vector<CallParameters::StreamParameters::ToneParameters> GetParameters() const override;
+
+    /**
+     * @brief Pick new random tone parameters, as default constructor does
+     */
+    void Reset() override;
 };
 
 /**
@@ -186,7 +336,8 @@ public:
 /**
  * @brief Abstract generator factory interface
  *
- * Generator factory interface
+ * Generator factory interface. Generators are handed out from a pool of factory, and are reset and returned to it when
+ * their handle is destroyed, so that factory should outlive generators it has created.
  * @see ZeroGeneratorFactory()
  * @see SingleToneGeneratorFactory()
  * @see SinusoidalGeneratorFactory()
@@ -194,11 +345,21 @@ public:
 class GeneratorFactory
 {
 private:
+    mutable ObjectPool<GeneratorType> _pool; /**< generators that are created by NewGenerator() */
+
+protected:
+    /**
+     * @brief pure virtual interface for constructing a new generator when pool is empty
+     *
+     * @return Constructed generator
+     */
+    virtual GeneratorType* NewGenerator() const = 0;
+
 public:
     /**
-     * @brief Default constructor, does not perform any specific operation
+     * @brief Default constructor, pool is initially empty
      */
-    GeneratorFactory()
+    GeneratorFactory() : _pool([this]() { return NewGenerator(); })
     {
     }
 
@@ -210,11 +371,24 @@ public:
     }
 
     /**
-     * @brief pure virtual interface for generator creating
+     * @brief Generator creation, a pooled generator is reused if there is any
+     *
+     * @return Handle of generator
+     */
+    GeneratorHandle CreateGenerator() const
+    {
+        return _pool.Acquire();
+    }
+
+    /**
+     * @brief Construct generators up front, so that creating that many generators does not allocate
      *
-     * @return Created generator
+     * @param numberOfGenerators INPUT number of generators that pool should have
      */
-    virtual GeneratorType* CreateGenerator() const = 0;
+    void Reserve(unsigned int numberOfGenerators)
+    {
+        _pool.Reserve(numberOfGenerators);
+    }
 };
 
 class ZeroGeneratorFactory : public GeneratorFactory
@@ -243,7 +417,7 @@ public:
      * @see SingleToneGeneratorType()
      * @see SinusoidalGeneratorType()
      */
-    virtual GeneratorType* CreateGenerator() const
+    virtual GeneratorType* NewGenerator() const
     {
         return new ZeroGeneratorType();
     }
@@ -252,13 +426,15 @@ public:
 class SingleToneGeneratorFactory : public GeneratorFactory
 {
 private:
-    CallParameters::StreamParameters::ToneParameters _generatorParams;
+    const bool _periodic; /**< whether created generators have periodic tones */
 
 public:
     /**
-     * @brief Default constructor, does not perform any specific operation
+     * @brief Constructor
+     *
+     * @param periodic INPUT whether created generators have periodic tones, whose payloads may be cached
      */
-    SingleToneGeneratorFactory()
+    explicit SingleToneGeneratorFactory(bool periodic = false) : _periodic(periodic)
     {
     }
 
@@ -277,9 +453,9 @@ public:
      * @see ZeroGeneratorType()
      * @see SinusoidalGeneratorType()
      */
-    virtual GeneratorType* CreateGenerator() const
+    virtual GeneratorType* NewGenerator() const
     {
-        return new SingleToneGeneratorType();
+        return new SingleToneGeneratorType(_periodic);
     }
 };
 
@@ -309,7 +485,7 @@ public:
      * @see ZeroGeneratorType()
      * @see SingleToneGeneratorType()
      */
-    virtual GeneratorType* CreateGenerator() const
+    virtual GeneratorType* NewGenerator() const
     {
         return new SinusoidalGeneratorType();
     }
@@ -21,6 +21,26 @@ enum class Output
     Socket
 };
 
+/**
+ * @brief Codec that generated payloads of call legs are encoded with
+ */
+enum class Codec
+{
+    G711a,
+    G711u,
+    G722
+};
+
+/**
+ * @brief What a worker does with packets that are due for more than a tick
+ */
+enum class OverloadPolicy
+{
+    CatchUp, /**< send late packets in bounded bursts, defer the rest to later ticks */
+    Skip,    /**< drop late packets, their sequence numbers are consumed as if lost on the way */
+    Stretch  /**< advance time at most two ticks per tick, so that timeline is stretched instead of packets being late */
+};
+
 /**
  * @brief ip port combination
  *
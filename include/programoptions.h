@@ -17,8 +17,21 @@ struct ProgramOptions
 {
     bool shouldStart;
     unsigned int numberOfCalls;
+    unsigned int callsPerSecond;
     unsigned int callDuration;
     unsigned int simulationDuration;
+    unsigned int numberOfThreads;
+    bool shouldSteal;
+    bool shouldPace;
+    bool isOffline;
+    OverloadPolicy overloadPolicy;
+    unsigned int maxBurst;
+    unsigned int lookahead;
+    bool shouldCachePayload;
+    bool shouldBatch;
+    Codec codec;
+    std::string clipDirectory; /**< directory of pre encoded clips that legs play, empty to generate payloads */
+    std::string kernelIsa;     /**< instruction set level of kernels, empty for best that cpu supports */
     unsigned int startIp;
     std::vector<IpPort> dstIpPortVector;
     std::vector<IpPort> drlinkIpPortVector;
@@ -12,14 +12,32 @@ namespace ddgen {
 /**
  * @brief Method that will calculate ones complement 16 bit summation .
  *
- * 16 bit ones complement addition is performed on data_ptr.
- * If data size is not multiple of 2, zero is padded to higher bit of last character.
- * @param data_ptr INPUT data array that summation will be handled on
+ * 16 bit ones complement addition is performed on data_ptr, words are in network byte order.
+ * If data size is not multiple of 2, last character is the higher byte of a word that is padded with zero.
+ * Summation is done by widest kernel that cpu supports, see variants below.
+ * @param data_ptr INPUT data array that summation will be handled on, no alignment is required
  * @param data_size INPUT size of data array
  * @return ones complement 16 bit summation result
  */
 unsigned short int OnesComplementShortSummation(const unsigned char* data_ptr, unsigned short int data_size);
 
+/**
+ * @brief Kernels of OnesComplementShortSummation(), all give the same result
+ *
+ * Words are added in host byte order into wide accumulators and carries are folded once at the end, result is swapped
+ * to network byte order since ones complement sum is independent of byte order (RFC 1071). Scalar kernel adds 32 bit
+ * words into a 64 bit accumulator, sse2, avx2 and avx512 kernels widen 16 bit words into 32 bit lanes. Vector kernels
+ * exist only on x86, avx2 and avx512 kernels should be called only if cpu supports them.
+ * @see KernelRegistry()
+ */
+unsigned short int OnesComplementShortSummationScalar(const unsigned char* data_ptr, unsigned short int data_size);
+#if defined(__x86_64__) || defined(__i386__)
+#define ONES_COMPLEMENT_SIMD 1 /**< sse2, avx2 and avx512 kernels are available, to be used if cpu supports them */
+unsigned short int OnesComplementShortSummationSse2(const unsigned char* data_ptr, unsigned short int data_size);
+unsigned short int OnesComplementShortSummationAvx2(const unsigned char* data_ptr, unsigned short int data_size);
+unsigned short int OnesComplementShortSummationAvx512(const unsigned char* data_ptr, unsigned short int data_size);
+#endif
+
 /**
  * @brief Rtp header
  *
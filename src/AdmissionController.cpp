@@ -0,0 +1,32 @@
+#include "AdmissionController.h"
+
+namespace ddgen {
+
+AdmissionController::AdmissionController(unsigned int callsPerSecond, unsigned int burst)
+    : _callsPerSecond(callsPerSecond)
+    , _capacity((0 == burst ? 1ULL : burst) * 1000000ULL)
+    , _tokens(_capacity)
+    , _lastTime(0)
+    , _admittedCalls(0)
+{
+}
+
+unsigned int AdmissionController::Acquire(unsigned long long int now, unsigned int numberOfCalls)
+{
+    if (now > _lastTime) {
+        // a token is 1e6 micro tokens, so that each usec adds exactly callsPerSecond micro tokens
+        const unsigned long long int refill = (now - _lastTime) * _callsPerSecond;
+        _tokens = ((_capacity - _tokens) > refill) ? (_tokens + refill) : _capacity;
+        _lastTime = now;
+    }
+
+    const unsigned long long int available_calls = _tokens / 1000000;
+    const unsigned int admitted_calls = (available_calls < numberOfCalls) ? (unsigned int)available_calls : numberOfCalls;
+
+    _tokens -= admitted_calls * 1000000ULL;
+    _admittedCalls += admitted_calls;
+
+    return admitted_calls;
+}
+
+} // namespace ddgen
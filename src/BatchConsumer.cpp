@@ -0,0 +1,66 @@
+#include "BatchConsumer.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace ddgen {
+
+BatchConsumer::BatchConsumer(const std::shared_ptr<IConsumer>& consumer, const std::shared_ptr<IClock>& clock)
+    : _consumer(consumer)
+    , _clock(clock ? clock : std::make_shared<SystemClock>())
+    , _buffer(new unsigned char[BATCH_BUFFER_SIZE])
+    , _bufferUsed(0)
+{
+    _packets.reserve(BATCH_BUFFER_SIZE / 256);
+}
+
+BatchConsumer::~BatchConsumer()
+{
+    Flush();
+}
+
+bool BatchConsumer::Consume(const unsigned char* data_ptr, unsigned short int data_size)
+{
+    std::memcpy(Acquire(data_size), data_ptr, data_size);
+    return Commit(data_size);
+}
+
+unsigned char* BatchConsumer::Acquire(unsigned short int data_size)
+{
+    // buffer is larger than any packet, so that after flushing a packet always fits
+    if (_bufferUsed + data_size > BATCH_BUFFER_SIZE) {
+        Flush();
+    }
+
+    return _buffer.get() + _bufferUsed;
+}
+
+bool BatchConsumer::Commit(unsigned short int data_size)
+{
+    unsigned int sec = 0;
+    unsigned int usec = 0;
+    _clock->GetTime(sec, usec);
+
+    _packets.push_back({ _buffer.get() + _bufferUsed, data_size, (unsigned long long int)sec * 1000000 + usec, -1 });
+    _bufferUsed += data_size;
+
+    return true;
+}
+
+bool BatchConsumer::Flush()
+{
+    if (_packets.empty()) {
+        return true;
+    }
+
+    const bool success = _consumer->ConsumeBatch(_packets.data(), _packets.size());
+    _packets.clear();
+    _bufferUsed = 0;
+
+    if (!success) {
+        std::cerr << __FILE__ << " " << __LINE__ << "... can not consume batch of packets" << std::endl;
+    }
+    return success;
+}
+
+} // namespace ddgen
@@ -0,0 +1,614 @@
+#include "CallEngine.h"
+#include "TickScheduler.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+
+namespace ddgen {
+
+namespace {
+const std::size_t MIN_RING_SIZE = 1024 * 1024; /**< rings are not made smaller than 1MB */
+
+/**
+ * @brief Phase of n'th leg inside packetization interval
+ *
+ * Phases follow golden ratio sequence, so that any number of consecutive legs are spread almost evenly over interval.
+ */
+unsigned int GetPacketPhase(unsigned int n, unsigned int interval)
+{
+    const unsigned long long int fraction = (n * 0x9E3779B9ULL) & 0xffffffffULL;
+    return (unsigned int)((fraction * interval) >> 32);
+}
+} // namespace
+
+CallShard::CallShard(unsigned int index,
+                     const std::vector<std::shared_ptr<IConsumer>>& consumers,
+                     const std::shared_ptr<VirtualClock>& clock,
+                     const Options& options)
+    : _index(index)
+    , _consumer(consumers.front())
+    , _workerConsumers(consumers)
+    , _consumerMutexes(consumers.size())
+    , _clock(clock)
+    , _options(options)
+    , _tickUsec((options.pacing ? PACING_TICK_DURATION : TICK_DURATION) * 1000)
+    , _numberOfScheduledLegs(0)
+    , _numberOfAdmittedCalls(0)
+    , _advanceStamp(0)
+    , _timeBase(0)
+    , _targetTime(0)
+    , _reachedTime(0)
+    , _encodingRound(0)
+    , _shallStop(false)
+{
+    // reserved up front so that admitting calls never reallocates tables
+    _pendingCalls.reserve(options.capacity);
+    _calls.reserve(options.capacity);
+    _packets.Reserve(options.capacity * 2);
+    _batcher.Reserve(options.capacity * 2);
+
+    if (consumers.size() > 1) {
+        _pool = std::make_unique<WorkStealingPool>(consumers.size());
+        _work.reserve(options.capacity);
+        _consumerWork.resize(consumers.size());
+        for (auto& consumer_work : _consumerWork) {
+            consumer_work.reserve(options.capacity);
+        }
+        _batchWork.reserve(options.capacity * 2 / G722_BATCH_LANES + 1);
+        _expiredCalls.reserve(options.capacity);
+    } else {
+        _dueLegs.reserve(options.capacity * 2);
+    }
+}
+
+CallShard::~CallShard()
+{
+    Stop();
+}
+
+void CallShard::Admit(std::unique_ptr<Call> call)
+{
+    _statistics.activeCalls++;
+
+    std::lock_guard<std::mutex> lock(_pendingCallsMutex);
+    _pendingCalls.push_back(std::move(call));
+}
+
+void CallShard::Start()
+{
+    _shallStop = false;
+    _worker = std::thread(_clock ? &CallShard::_runOffline : &CallShard::_run, this);
+}
+
+void CallShard::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_advanceMutex);
+        _shallStop = true;
+    }
+    _advanceCondition.notify_all();
+
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+}
+
+void CallShard::AdvanceTo(unsigned long long int now)
+{
+    {
+        std::lock_guard<std::mutex> lock(_advanceMutex);
+        _targetTime = now;
+    }
+    _advanceCondition.notify_all();
+}
+
+void CallShard::WaitAdvance()
+{
+    std::unique_lock<std::mutex> lock(_advanceMutex);
+    _advanceCondition.wait(lock, [this]() { return (_reachedTime >= _targetTime) || _shallStop; });
+}
+
+unsigned int CallShard::GetLoad() const
+{
+    return _statistics.activeCalls;
+}
+
+const CallShard::Statistics& CallShard::GetStatistics() const
+{
+    return _statistics;
+}
+
+const std::shared_ptr<IConsumer>& CallShard::GetConsumer() const
+{
+    return _consumer;
+}
+
+void CallShard::_admitPendingCalls(unsigned long long int now)
+{
+    std::lock_guard<std::mutex> lock(_pendingCallsMutex);
+    for (auto& call : _pendingCalls) {
+        call->SetIndex(_calls.size());
+        call->SetConsumer(_numberOfAdmittedCalls++ % _workerConsumers.size());
+        _schedule(*call, now);
+        _calls.push_back(std::move(call));
+    }
+    _pendingCalls.clear();
+}
+
+void CallShard::_schedule(Call& call, unsigned long long int now)
+{
+    const unsigned long long int end_of_call = now + call.GetDuration() * 1000ULL;
+
+    TimerEvent& expiry_event = call.GetExpiryEvent();
+    expiry_event.deadline = end_of_call;
+    expiry_event.owner = &call;
+    _wheel.Schedule(expiry_event);
+
+    // deadlines are on tick grid rather than at wake up time of worker, so that jitter of wake ups is not taken as lateness
+    const unsigned long long int tick_start = now - now % _tickUsec;
+
+    // first packet is due immediately (or at phase of leg when paced), remaining ones follow every interval till end of call
+    for (const auto& call_leg : call.GetCallLegs()) {
+        const unsigned int packet_interval = call_leg->GetPacketInterval();
+        const unsigned long long int first_deadline =
+            tick_start + (_options.pacing ? GetPacketPhase(_numberOfScheduledLegs++, packet_interval) : 0);
+        _packets.Add(*call_leg, first_deadline, packet_interval, end_of_call);
+    }
+}
+
+void CallShard::_remove(Call& call)
+{
+    OverloadState call_overload_state;
+    for (const auto& call_leg : call.GetCallLegs()) {
+        _packets.Remove(*call_leg);
+
+        // packets that are still deferred will never be sent
+        OverloadState& overload_state = call_leg->GetOverloadState();
+        overload_state.dropped += overload_state.backlog;
+        overload_state.backlog = 0;
+
+        call_overload_state.bursted += overload_state.bursted;
+        call_overload_state.deferred += overload_state.deferred;
+        call_overload_state.dropped += overload_state.dropped;
+    }
+    _wheel.Cancel(call.GetExpiryEvent());
+
+    if (call_overload_state.bursted || call_overload_state.deferred || call_overload_state.dropped) {
+        std::clog << "a call at shard " << _index << " is not served on time, packets bursted: " << call_overload_state.bursted
+                  << " deferred: " << call_overload_state.deferred << " dropped: " << call_overload_state.dropped << std::endl;
+        _statistics.burstedPackets += call_overload_state.bursted;
+        _statistics.deferredPackets += call_overload_state.deferred;
+        _statistics.droppedPackets += call_overload_state.dropped;
+    }
+
+    // swap with last call so that removal does not shift the table
+    const unsigned int index = call.GetIndex();
+    if (index + 1 != _calls.size()) {
+        std::swap(_calls[index], _calls.back());
+        _calls[index]->SetIndex(index);
+    }
+    _calls.pop_back();
+
+    _statistics.activeCalls--;
+    _statistics.completedCalls++;
+}
+
+void CallShard::_advance(unsigned long long int now, unsigned long long int realNow)
+{
+    _advanceStamp++;
+
+    unsigned int sent_packets = 0;
+
+    // packets are stamped with their deadlines in offline mode, so they are sent in deadline order
+    _packets.Advance(now, nullptr != _clock, [this, realNow, &sent_packets](CallLeg& call_leg, unsigned long long int deadline) {
+        // lateness is against wall clock, time of shard may be behind it when stretched or ahead of it with lookahead
+        const unsigned int number_of_packets = _admitPackets(call_leg, (realNow > deadline) ? realNow - deadline : 0);
+        if (number_of_packets) {
+            _batcher.Add(call_leg, number_of_packets);
+        }
+
+        if (_pool) {
+            if (_clock) {
+                _clock->SetTime(deadline);
+            }
+            _addWork(call_leg, number_of_packets, deadline);
+        } else if (_dueLegs.empty() && !call_leg.GetBatchEncoder()) {
+            // legs are sent right away till a batched leg is due, later ones wait for its batch to keep deadline order
+            if (_clock) {
+                _clock->SetTime(deadline);
+            }
+            _consumer->SetSendTime(_timeBase + deadline);
+            for (unsigned int i = 0; i < number_of_packets; ++i) {
+                if (call_leg.SendPacket()) {
+                    sent_packets++;
+                }
+            }
+        } else {
+            _dueLegs.push_back({ &call_leg, number_of_packets, deadline });
+        }
+    });
+
+    // G722 legs are encoded in batches before any packet of advance is sent
+    _encodeBatches();
+
+    if (!_pool) {
+        for (const auto& due_leg : _dueLegs) {
+            if (_clock) {
+                _clock->SetTime(due_leg.deadline);
+            }
+            _consumer->SetSendTime(_timeBase + due_leg.deadline);
+            for (unsigned int i = 0; i < due_leg.numberOfPackets; ++i) {
+                if (due_leg.callLeg->SendPacket()) {
+                    sent_packets++;
+                }
+            }
+        }
+        _dueLegs.clear();
+        _batcher.Clear();
+        _statistics.generatedPackets += sent_packets;
+    }
+
+    // calls expire after their packets, no packet of a call is due at or after its end
+    _wheel.Advance(now, [this](TimerEvent& event, unsigned long long int) {
+        std::clog << "a call timed out at shard " << _index << std::endl;
+        if (_pool) {
+            _expiredCalls.push_back(static_cast<Call*>(event.owner));
+        } else {
+            _remove(*static_cast<Call*>(event.owner));
+        }
+    });
+
+    if (_pool) {
+        // pool splits tasks into contiguous ranges, so that worker w mostly gets calls of consumer w
+        for (auto& consumer_work : _consumerWork) {
+            _work.insert(_work.end(), consumer_work.begin(), consumer_work.end());
+            consumer_work.clear();
+        }
+        _pool->Run(_work);
+        _work.clear();
+        _batcher.Clear();
+        _statistics.stolenTasks = _pool->GetStolenTasks();
+
+        // calls are removed only after all workers are done with them
+        for (auto call : _expiredCalls) {
+            _remove(*call);
+        }
+        _expiredCalls.clear();
+    }
+
+    // workers are done, packets of advance are handed over at once
+    for (const auto& consumer : _workerConsumers) {
+        consumer->Flush();
+    }
+}
+
+unsigned int CallShard::_admitPackets(CallLeg& callLeg, unsigned long long int lateness)
+{
+    OverloadState& overload_state = callLeg.GetOverloadState();
+
+    if (lateness < OVERLOAD_THRESHOLD * 1000) {
+        _acquireBurst(overload_state);
+        unsigned int number_of_packets = 1;
+
+        // spare burst of an on time leg is used for its deferred packets, they are counted as deferred once they are sent
+        while (overload_state.backlog && _acquireBurst(overload_state)) {
+            overload_state.backlog--;
+            overload_state.deferred++;
+            number_of_packets++;
+        }
+        return number_of_packets;
+    }
+
+    switch (_options.overloadPolicy) {
+    case OverloadPolicy::Skip:
+        callLeg.SkipPacket();
+        overload_state.dropped++;
+        return 0;
+    case OverloadPolicy::Stretch:
+        overload_state.deferred++;
+        return 1;
+    case OverloadPolicy::CatchUp:
+    default:
+        if (_acquireBurst(overload_state)) {
+            overload_state.bursted++;
+            return 1;
+        }
+
+        overload_state.backlog++;
+        return 0;
+    }
+}
+
+bool CallShard::_acquireBurst(OverloadState& overloadState)
+{
+    if (overloadState.burstStamp != _advanceStamp) {
+        overloadState.burstStamp = _advanceStamp;
+        overloadState.burstCount = 0;
+    }
+
+    if (overloadState.burstCount >= _options.maxBurst) {
+        return false;
+    }
+
+    overloadState.burstCount++;
+    return true;
+}
+
+void CallShard::_addWork(CallLeg& callLeg, unsigned int numberOfPackets, unsigned long long int deadline)
+{
+    if (0 == numberOfPackets) {
+        return;
+    }
+    callLeg.GetDuePackets() += numberOfPackets;
+    callLeg.GetDueTime() = deadline;
+
+    // a call is a single task, however many of its legs are due
+    Call& call = *callLeg.GetCall();
+    if (call.GetWorkStamp() != _advanceStamp) {
+        call.GetWorkStamp() = _advanceStamp;
+        _consumerWork[call.GetConsumer()].push_back({ &CallShard::_sendDuePackets, this, &call });
+    }
+}
+
+void CallShard::_sendDuePackets(void* owner, void* context, unsigned int)
+{
+    CallShard& shard = *static_cast<CallShard*>(owner);
+    Call& call = *static_cast<Call*>(context);
+    unsigned int sent_packets = 0;
+
+    // streams of a call stay on its consumer whichever worker runs the task
+    std::lock_guard<std::mutex> lock(shard._consumerMutexes[call.GetConsumer()]);
+    IConsumer& consumer = *shard._workerConsumers[call.GetConsumer()];
+    for (const auto& call_leg : call.GetCallLegs()) {
+        unsigned int& due_packets = call_leg->GetDuePackets();
+        if (due_packets) {
+            consumer.SetSendTime(shard._timeBase + call_leg->GetDueTime());
+        }
+        for (; due_packets > 0; --due_packets) {
+            if (call_leg->SendPacket(consumer)) {
+                sent_packets++;
+            }
+        }
+    }
+
+    shard._statistics.generatedPackets += sent_packets;
+}
+
+void CallShard::_encodeBatches()
+{
+    // packets of a burst are encoded round by round, as a round continues encoder states that previous one left
+    for (_encodingRound = 0; _encodingRound < _batcher.GetNumberOfRounds(); ++_encodingRound) {
+        const unsigned int number_of_batches = _batcher.GetNumberOfBatches(_encodingRound);
+        if (_pool && (number_of_batches > 1)) {
+            for (unsigned int batch = 0; batch < number_of_batches; ++batch) {
+                _batchWork.push_back({ &CallShard::_encodeBatch, this, reinterpret_cast<void*>(static_cast<std::uintptr_t>(batch)) });
+            }
+            _pool->Run(_batchWork);
+            _batchWork.clear();
+            continue;
+        }
+
+        for (unsigned int batch = 0; batch < number_of_batches; ++batch) {
+            _batcher.EncodeBatch(_encodingRound, batch);
+        }
+    }
+}
+
+void CallShard::_encodeBatch(void* owner, void* context, unsigned int)
+{
+    // context is index of batch in round that is being encoded
+    CallShard* shard = static_cast<CallShard*>(owner);
+    shard->_batcher.EncodeBatch(shard->_encodingRound, static_cast<unsigned int>(reinterpret_cast<std::uintptr_t>(context)));
+}
+
+void CallShard::_run()
+{
+    TickScheduler scheduler(_tickUsec);
+    scheduler.Start();
+    _timeBase = scheduler.GetStartUsec();
+
+    while (!_shallStop) {
+        const unsigned long long int now = scheduler.WaitNextTick();
+
+        // when stretching, time of shard advances at most two ticks per tick and may fall behind wall clock
+        unsigned long long int target_time = now + _options.lookahead * 1000ULL;
+        if ((OverloadPolicy::Stretch == _options.overloadPolicy) && (target_time > _wheel.Now() + 2 * _tickUsec)) {
+            target_time = _wheel.Now() + 2 * _tickUsec;
+        }
+        _statistics.stretchUsec = (now > target_time) ? now - target_time : 0;
+
+        if (scheduler.GetMissedDeadlines() != _statistics.missedDeadlines) {
+            std::clog << __FILE__ << " " << __LINE__ << "... too much lag at shard " << _index << ", missed "
+                      << scheduler.GetMissedDeadlines() - _statistics.missedDeadlines << " ticks" << std::endl;
+            _statistics.missedDeadlines = scheduler.GetMissedDeadlines();
+        }
+        _statistics.driftUsec = scheduler.GetDriftUsec();
+
+        // calls start at the time shard is advancing to, not at the time of last advance
+        _admitPendingCalls(target_time);
+        _advance(target_time, now);
+    }
+
+    // calls are destroyed by their owner thread
+    _calls.clear();
+}
+
+void CallShard::_runOffline()
+{
+    for (;;) {
+        unsigned long long int target_time = 0;
+        {
+            std::unique_lock<std::mutex> lock(_advanceMutex);
+            _advanceCondition.wait(lock, [this]() { return (_targetTime > _reachedTime) || _shallStop; });
+            if (_shallStop) {
+                break;
+            }
+            target_time = _targetTime;
+        }
+
+        _admitPendingCalls(target_time);
+        _advance(target_time, target_time);
+
+        {
+            std::lock_guard<std::mutex> lock(_advanceMutex);
+            _reachedTime = target_time;
+        }
+        _advanceCondition.notify_all();
+    }
+
+    // calls are destroyed by their owner thread
+    _calls.clear();
+}
+
+CallEngine::CallEngine(const Options& options)
+{
+    const unsigned int number_of_threads = (0 == options.numberOfThreads) ? 1 : options.numberOfThreads;
+
+    // work stealing shares a single shard over all threads, it needs wall clock so offline mode keeps a shard per thread
+    const bool steal = options.steal && !options.offline;
+    const unsigned int number_of_shards = steal ? 1 : number_of_threads;
+    const unsigned int number_of_consumers = steal ? number_of_threads : 1;
+
+    // a ring holds 20ms packets of lookahead duration plus two packets of slack, for every leg of its share of calls,
+    // least loaded shard takes next call and a shard binds its calls to consumers round robin, so shares are about even
+    const bool lookahead = options.shardOptions.lookahead && !options.offline;
+    const unsigned int packets_in_ring = options.shardOptions.lookahead / TICK_DURATION + 2;
+    const unsigned int number_of_rings = number_of_shards * number_of_consumers;
+    const unsigned int calls_per_ring = (options.shardOptions.capacity + number_of_rings - 1) / number_of_rings;
+    std::size_t ring_size =
+        (std::size_t)calls_per_ring * options.legsPerCall * packets_in_ring * PacketRing::GetRecordSize(options.packetSize);
+    if (ring_size < MIN_RING_SIZE) {
+        ring_size = MIN_RING_SIZE;
+    }
+
+    // virtual timeline of offline mode starts at current wall clock time, as a real time run would
+    unsigned int start_sec = 0;
+    unsigned int start_usec = 0;
+    GetCurrentTimeInTv(start_sec, start_usec);
+    const unsigned long long int start_time = (unsigned long long int)start_sec * 1000000 + start_usec;
+
+    for (unsigned int index = 0; index < number_of_shards; ++index) {
+        auto consumerOptions = options.consumerOptions;
+
+        std::shared_ptr<VirtualClock> clock;
+        if (options.offline) {
+            clock = std::make_shared<VirtualClock>(start_time);
+            consumerOptions.clock = clock;
+        }
+
+        // each thread has its own consumer
+        std::vector<std::shared_ptr<IConsumer>> consumers;
+        for (unsigned int consumer_index = 0; consumer_index < number_of_consumers; ++consumer_index) {
+            if (number_of_threads > 1) {
+                consumerOptions.tag = "_" + std::to_string(index * number_of_consumers + consumer_index);
+            }
+            consumers.push_back(ConsumerFactory::CreateConsumer(consumerOptions));
+
+            if (options.batch) {
+                consumers.back() = std::make_shared<BatchConsumer>(consumers.back(), consumerOptions.clock);
+            }
+
+            if (lookahead) {
+                _lookaheadConsumers.push_back(std::make_shared<LookaheadConsumer>(consumers.back(), ring_size));
+                consumers.back() = _lookaheadConsumers.back();
+            }
+        }
+
+        auto shardOptions = options.shardOptions;
+        shardOptions.lookahead = lookahead ? shardOptions.lookahead : 0;
+        _shards.push_back(std::make_unique<CallShard>(index, consumers, clock, shardOptions));
+    }
+
+    if (lookahead) {
+        _transmitter = std::make_unique<Transmitter>(_lookaheadConsumers);
+    }
+}
+
+CallShard& CallEngine::SelectShard()
+{
+    CallShard* selected_shard = _shards.front().get();
+
+    for (const auto& shard : _shards) {
+        if (shard->GetLoad() < selected_shard->GetLoad()) {
+            selected_shard = shard.get();
+        }
+    }
+
+    return *selected_shard;
+}
+
+void CallEngine::Start()
+{
+    if (_transmitter) {
+        _transmitter->Start();
+    }
+
+    for (auto& shard : _shards) {
+        shard->Start();
+    }
+}
+
+void CallEngine::Stop()
+{
+    for (auto& shard : _shards) {
+        shard->Stop();
+    }
+
+    // transmitter is stopped last so that it sends everything shards have generated
+    if (_transmitter) {
+        _transmitter->Stop();
+    }
+}
+
+void CallEngine::AdvanceTo(unsigned long long int now)
+{
+    for (auto& shard : _shards) {
+        shard->AdvanceTo(now);
+    }
+
+    for (auto& shard : _shards) {
+        shard->WaitAdvance();
+    }
+}
+
+unsigned int CallEngine::GetNumberOfCalls() const
+{
+    unsigned int number_of_calls = 0;
+    for (const auto& shard : _shards) {
+        number_of_calls += shard->GetLoad();
+    }
+
+    return number_of_calls;
+}
+
+CallEngine::Progress CallEngine::GetProgress() const
+{
+    Progress progress = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    for (const auto& shard : _shards) {
+        const auto& statistics = shard->GetStatistics();
+        progress.activeCalls += statistics.activeCalls;
+        progress.completedCalls += statistics.completedCalls;
+        progress.generatedPackets += statistics.generatedPackets;
+        progress.missedDeadlines += statistics.missedDeadlines;
+        progress.driftUsec += statistics.driftUsec;
+        progress.burstedPackets += statistics.burstedPackets;
+        progress.deferredPackets += statistics.deferredPackets;
+        progress.droppedPackets += statistics.droppedPackets;
+        progress.stolenTasks += statistics.stolenTasks;
+        if (statistics.stretchUsec > progress.stretchUsec) {
+            progress.stretchUsec = statistics.stretchUsec;
+        }
+    }
+
+    for (const auto& consumer : _lookaheadConsumers) {
+        progress.transmittedPackets += consumer->GetTransmittedPackets();
+        progress.overflowPackets += consumer->GetOverflowPackets();
+    }
+
+    return progress;
+}
+
+} // namespace ddgen
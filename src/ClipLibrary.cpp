@@ -0,0 +1,142 @@
+#include "ClipLibrary.h"
+#include "encoder.h"
+#include "rawsocket.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ddgen {
+
+namespace {
+/**
+ * @brief Rtp payload type of a clip file, deduced from its extension
+ *
+ * @return false if extension is not known
+ */
+bool GetClipPayloadType(const std::string& name, unsigned char& payloadType)
+{
+    const std::size_t dot = name.rfind('.');
+    if (std::string::npos == dot) {
+        return false;
+    }
+
+    const std::string extension = name.substr(dot + 1);
+    if (("pcma" == extension) || ("alaw" == extension)) {
+        payloadType = G711a_RTP_PAYLOAD_TYPE;
+    } else if (("pcmu" == extension) || ("ulaw" == extension)) {
+        payloadType = G711u_RTP_PAYLOAD_TYPE;
+    } else if ("g722" == extension) {
+        payloadType = G722_RTP_PAYLOAD_TYPE;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+} // namespace
+
+ClipLibrary::ClipLibrary() : _nextClip(0)
+{
+}
+
+ClipLibrary::~ClipLibrary()
+{
+    for (const auto& mapping : _mappings) {
+        munmap(mapping.address, mapping.size);
+    }
+}
+
+bool ClipLibrary::Load(const std::string& directory)
+{
+    DIR* dir = opendir(directory.c_str());
+    if (nullptr == dir) {
+        std::cerr << __FILE__ << " " << __LINE__ << " clip directory " << directory << " can not be opened" << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> names;
+    while (const dirent* entry = readdir(dir)) {
+        names.push_back(entry->d_name);
+    }
+    closedir(dir);
+
+    // clips are handed out in name order, so that runs are repeatable
+    std::sort(names.begin(), names.end());
+
+    for (const auto& name : names) {
+        unsigned char payload_type;
+        if (GetClipPayloadType(name, payload_type)) {
+            _mapClip(directory + "/" + name, name, payload_type);
+        }
+    }
+
+    if (_clips.empty()) {
+        std::cerr << __FILE__ << " " << __LINE__ << " no clips found in " << directory << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+const Clip* ClipLibrary::SelectClip()
+{
+    if (_clips.empty()) {
+        return nullptr;
+    }
+
+    return _clips[_nextClip.fetch_add(1, std::memory_order_relaxed) % _clips.size()].get();
+}
+
+unsigned long long int ClipLibrary::GetMappedSize() const
+{
+    unsigned long long int mapped_size = 0;
+    for (const auto& mapping : _mappings) {
+        mapped_size += mapping.size;
+    }
+    return mapped_size;
+}
+
+bool ClipLibrary::_mapClip(const std::string& path, const std::string& name, unsigned char payloadType)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << __FILE__ << " " << __LINE__ << " clip " << path << " can not be opened" << std::endl;
+        return false;
+    }
+
+    struct stat file_stat;
+    if ((0 != fstat(fd, &file_stat)) || !S_ISREG(file_stat.st_mode) || (file_stat.st_size < CLIP_PACKET_SIZE)) {
+        std::cerr << __FILE__ << " " << __LINE__ << " clip " << path << " is skipped, it is not a file of at least a packet" << std::endl;
+        close(fd);
+        return false;
+    }
+
+    const std::size_t size = file_stat.st_size;
+    void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == address) {
+        std::cerr << __FILE__ << " " << __LINE__ << " clip " << path << " can not be mapped" << std::endl;
+        return false;
+    }
+    _mappings.push_back({ address, size });
+
+    std::unique_ptr<Clip> clip(new Clip);
+    clip->name = name;
+    clip->payloadType = payloadType;
+    clip->payloads = static_cast<const unsigned char*>(address);
+    clip->numberOfPackets = size / CLIP_PACKET_SIZE;
+    clip->sums.resize(clip->numberOfPackets);
+    for (unsigned int k = 0; k < clip->numberOfPackets; ++k) {
+        clip->sums[k] = OnesComplementShortSummation(clip->payloads + k * CLIP_PACKET_SIZE, CLIP_PACKET_SIZE);
+    }
+
+    _clips.push_back(std::move(clip));
+    return true;
+}
+
+} // namespace ddgen
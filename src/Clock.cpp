@@ -0,0 +1,23 @@
+#include "Clock.h"
+
+#include "consumer.h"
+
+namespace ddgen {
+
+void SystemClock::GetTime(unsigned int& sec, unsigned int& usec) const
+{
+    GetCurrentTimeInTv(sec, usec);
+}
+
+VirtualClock::VirtualClock(unsigned long long int startUsec) : _startUsec(startUsec), _offsetUsec(0)
+{
+}
+
+void VirtualClock::GetTime(unsigned int& sec, unsigned int& usec) const
+{
+    const unsigned long long int now = _startUsec + _offsetUsec;
+    sec = (unsigned int)(now / 1000000);
+    usec = (unsigned int)(now % 1000000);
+}
+
+} // namespace ddgen
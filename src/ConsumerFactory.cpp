@@ -9,7 +9,7 @@ std::shared_ptr<IConsumer> ConsumerFactory::CreateConsumer(const Options& option
     auto callStorage = ddgen::CallStorageFactory::CreateCallStorage({ options.useS3, options.stackName });
 
     if (options.output == ddgen::Output::Pcap) {
-        return std::make_shared<ddgen::PcapConsumer>(callStorage);
+        return std::make_shared<ddgen::PcapConsumer>(callStorage, options.tag, options.clock);
     } else {
         return std::make_shared<ddgen::SocketConsumer>(options.dstIpPortVector);
     }
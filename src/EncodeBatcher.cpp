@@ -0,0 +1,114 @@
+#include "EncodeBatcher.h"
+#include "callleg.h"
+
+#include <algorithm>
+
+namespace ddgen {
+
+namespace {
+/**
+ * @brief Whether payloads of packets of a leg before given one are all encoded in batches
+ */
+bool IsEncodedUpTo(const CallLeg& callLeg, const BatchPayload* batchPayload)
+{
+    for (const BatchPayload* payload = callLeg.GetBatchPayload(); payload != batchPayload; payload = payload->next) {
+        if (!payload->encoded) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+void EncodeBatcher::Reserve(unsigned int numberOfLegs)
+{
+    if (_rounds.empty()) {
+        _rounds.emplace_back();
+    }
+    _rounds.front().legs.reserve(numberOfLegs);
+}
+
+void EncodeBatcher::Add(CallLeg& callLeg, unsigned int numberOfPackets)
+{
+    if (nullptr == callLeg.GetBatchEncoder()) {
+        return;
+    }
+
+    // packets of leg that are already taken in this advance decide round of next one
+    unsigned int round = 0;
+    BatchPayload* last_payload = nullptr;
+    for (BatchPayload* payload = callLeg.GetBatchPayload(); payload; payload = payload->next) {
+        last_payload = payload;
+        round++;
+    }
+
+    for (; numberOfPackets; --numberOfPackets, ++round) {
+        if (round == _rounds.size()) {
+            _rounds.emplace_back();
+        }
+        _numberOfRounds = std::max(_numberOfRounds, round + 1);
+
+        Round& batch_round = _rounds[round];
+        const unsigned int batch = batch_round.legs.size() / G722_BATCH_LANES;
+        if (batch == batch_round.batches.size()) {
+            batch_round.batches.push_back(std::make_unique<BatchPayloads>());
+        }
+
+        BatchPayload* payload = &batch_round.batches[batch]->payloads[batch_round.legs.size() % G722_BATCH_LANES];
+        payload->next = nullptr;
+        payload->encoded = false;
+        if (last_payload) {
+            last_payload->next = payload;
+        } else {
+            callLeg.SetBatchPayload(payload);
+        }
+        last_payload = payload;
+        batch_round.legs.push_back(&callLeg);
+    }
+}
+
+void EncodeBatcher::EncodeBatch(unsigned int round, unsigned int batch)
+{
+    short int pcm[G722_BATCH_LANES][G722_PACKET_SIZE];
+    G722EncoderType* encoders[G722_BATCH_LANES];
+    const short int* pcm_data_ptrs[G722_BATCH_LANES];
+    unsigned char* encoded_data_ptrs[G722_BATCH_LANES];
+    unsigned int number_of_encoders = 0;
+
+    const Round& batch_round = _rounds[round];
+    const unsigned int first = batch * G722_BATCH_LANES;
+    const unsigned int last = std::min(first + G722_BATCH_LANES, (unsigned int)batch_round.legs.size());
+    for (unsigned int leg = first; leg < last; ++leg) {
+        CallLeg& call_leg = *batch_round.legs[leg];
+        BatchPayload& payload = batch_round.batches[batch]->payloads[leg - first];
+
+        // a leg that fails to generate is left out of this and later rounds, it encodes its packets by itself
+        if (!IsEncodedUpTo(call_leg, &payload) || !call_leg.GenerateBatchPcm(pcm[number_of_encoders])) {
+            continue;
+        }
+
+        payload.encoded = true;
+        encoders[number_of_encoders] = call_leg.GetBatchEncoder();
+        pcm_data_ptrs[number_of_encoders] = pcm[number_of_encoders];
+        encoded_data_ptrs[number_of_encoders] = payload.codes;
+        number_of_encoders++;
+    }
+
+    G722EncoderType::EncodeBatch(encoders, pcm_data_ptrs, encoded_data_ptrs, number_of_encoders);
+}
+
+void EncodeBatcher::Clear()
+{
+    // payloads of packets that are not sent are dropped, every leg of advance is in first round
+    if (_numberOfRounds) {
+        for (auto call_leg : _rounds.front().legs) {
+            call_leg->ClearBatchPayload();
+        }
+    }
+    for (unsigned int round = 0; round < _numberOfRounds; ++round) {
+        _rounds[round].legs.clear();
+    }
+    _numberOfRounds = 0;
+}
+
+} // namespace ddgen
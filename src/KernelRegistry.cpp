@@ -0,0 +1,148 @@
+#include "KernelRegistry.h"
+#include "encoder.h"
+#include "g722encoder.h"
+#include "generator.h"
+#include "rawsocket.h"
+
+#include <atomic>
+
+namespace ddgen {
+
+namespace {
+const Kernels scalar_kernels = { KernelIsa::Scalar,
+                                 &OnesComplementShortSummationScalar,
+                                 &G711aEncodeScalar,
+                                 &G711uEncodeScalar,
+                                 &G722QmfTxScalar,
+                                 &G722EncodeBatchScalar,
+                                 &GenerateToneScalar };
+
+#if defined(__x86_64__) || defined(__i386__)
+const Kernels sse42_kernels = { KernelIsa::Sse42,
+                                &OnesComplementShortSummationSse2,
+                                &G711aEncodeSse41,
+                                &G711uEncodeSse41,
+                                &G722QmfTxSse2,
+                                &G722EncodeBatchScalar,
+                                &GenerateToneSse2 };
+
+const Kernels avx2_kernels = { KernelIsa::Avx2,
+                               &OnesComplementShortSummationAvx2,
+                               &G711aEncodeAvx2,
+                               &G711uEncodeAvx2,
+                               &G722QmfTxAvx2,
+                               &G722EncodeBatchAvx2,
+                               &GenerateToneAvx2 };
+
+const Kernels avx512_kernels = { KernelIsa::Avx512,
+                                 &OnesComplementShortSummationAvx512,
+                                 &G711aEncodeAvx512,
+                                 &G711uEncodeAvx512,
+                                 &G722QmfTxAvx512,
+                                 &G722EncodeBatchAvx2,
+                                 &GenerateToneAvx512 };
+#endif
+
+// null till kernels are first asked for or a level is selected
+std::atomic<const Kernels*> selected_kernels(nullptr);
+} // namespace
+
+const Kernels& KernelRegistry::Get()
+{
+    const Kernels* kernels = selected_kernels.load(std::memory_order_acquire);
+    if (nullptr == kernels) {
+        // threads that race here store the same set
+        kernels = GetKernels(GetBestSupportedIsa());
+        selected_kernels.store(kernels, std::memory_order_release);
+    }
+    return *kernels;
+}
+
+const Kernels* KernelRegistry::GetKernels(KernelIsa isa)
+{
+    if (!IsSupported(isa)) {
+        return nullptr;
+    }
+
+    switch (isa) {
+#if defined(__x86_64__) || defined(__i386__)
+    case KernelIsa::Sse42:
+        return &sse42_kernels;
+    case KernelIsa::Avx2:
+        return &avx2_kernels;
+    case KernelIsa::Avx512:
+        return &avx512_kernels;
+#endif
+    default:
+        return &scalar_kernels;
+    }
+}
+
+bool KernelRegistry::Select(KernelIsa isa)
+{
+    const Kernels* kernels = GetKernels(isa);
+    if (nullptr == kernels) {
+        return false;
+    }
+
+    selected_kernels.store(kernels, std::memory_order_release);
+    return true;
+}
+
+bool KernelRegistry::IsSupported(KernelIsa isa)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    switch (isa) {
+    case KernelIsa::Scalar:
+        return true;
+    case KernelIsa::Sse42:
+        return __builtin_cpu_supports("sse4.2");
+    case KernelIsa::Avx2:
+        return __builtin_cpu_supports("avx2");
+    case KernelIsa::Avx512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512cd");
+    }
+    return false;
+#else
+    return KernelIsa::Scalar == isa;
+#endif
+}
+
+KernelIsa KernelRegistry::GetBestSupportedIsa()
+{
+    for (KernelIsa isa : { KernelIsa::Avx512, KernelIsa::Avx2, KernelIsa::Sse42 }) {
+        if (IsSupported(isa)) {
+            return isa;
+        }
+    }
+    return KernelIsa::Scalar;
+}
+
+const char* KernelRegistry::GetName(KernelIsa isa)
+{
+    switch (isa) {
+    case KernelIsa::Scalar:
+        return "scalar";
+    case KernelIsa::Sse42:
+        return "sse4.2";
+    case KernelIsa::Avx2:
+        return "avx2";
+    case KernelIsa::Avx512:
+        return "avx512";
+    }
+    return "unknown";
+}
+
+bool KernelRegistry::Parse(const std::string& name, KernelIsa& isa)
+{
+    for (KernelIsa candidate : { KernelIsa::Scalar, KernelIsa::Sse42, KernelIsa::Avx2, KernelIsa::Avx512 }) {
+        if (name == GetName(candidate)) {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace ddgen
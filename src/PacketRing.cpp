@@ -0,0 +1,116 @@
+#include "PacketRing.h"
+
+#include <cstring>
+
+namespace ddgen {
+
+namespace {
+const unsigned int WRAP_MARKER = 0xffffffff; /**< size of a record that marks end of buffer */
+
+std::size_t AlignRecordSize(std::size_t size)
+{
+    return (size + 7) & ~((std::size_t)7);
+}
+} // namespace
+
+std::size_t PacketRing::GetRecordSize(unsigned int size)
+{
+    return AlignRecordSize(sizeof(Record) + size);
+}
+
+PacketRing::PacketRing(std::size_t capacity)
+    : _capacity(AlignRecordSize(capacity < 2 * sizeof(Record) ? 2 * sizeof(Record) : capacity))
+    , _buffer(new unsigned long long int[_capacity / 8])
+    , _head(0)
+    , _tail(0)
+    , _acquiredHead(0)
+{
+}
+
+bool PacketRing::Push(unsigned long long int dueTime, const unsigned char* data, unsigned int size)
+{
+    unsigned char* record_data = Acquire(dueTime, size);
+    if (nullptr == record_data) {
+        return false;
+    }
+
+    std::memcpy(record_data, data, size);
+    Commit(size);
+    return true;
+}
+
+unsigned char* PacketRing::Acquire(unsigned long long int dueTime, unsigned int size)
+{
+    const unsigned long long int head = _head.load(std::memory_order_relaxed);
+    const unsigned long long int tail = _tail.load(std::memory_order_acquire);
+    const std::size_t record_size = AlignRecordSize(sizeof(Record) + size);
+
+    std::size_t position = head % _capacity;
+    std::size_t space_till_end = _capacity - position;
+    std::size_t needed_size = record_size;
+
+    // a record is never split, rest of buffer is skipped if record does not fit in it
+    if (record_size > space_till_end) {
+        needed_size += space_till_end;
+    }
+
+    if (needed_size > _capacity - (head - tail)) {
+        return nullptr;
+    }
+
+    unsigned char* buffer = reinterpret_cast<unsigned char*>(_buffer.get());
+    if (record_size > space_till_end) {
+        if (space_till_end >= sizeof(Record)) {
+            reinterpret_cast<Record*>(buffer + position)->size = WRAP_MARKER;
+        }
+        position = 0;
+    }
+
+    Record* record = reinterpret_cast<Record*>(buffer + position);
+    record->dueTime = dueTime;
+    record->size = size;
+
+    // skipped end of buffer is published together with the record
+    _acquiredHead = head + needed_size - record_size;
+    return reinterpret_cast<unsigned char*>(record + 1);
+}
+
+void PacketRing::Commit(unsigned int size)
+{
+    Record* record = reinterpret_cast<Record*>(reinterpret_cast<unsigned char*>(_buffer.get()) + _acquiredHead % _capacity);
+    record->size = size;
+
+    _head.store(_acquiredHead + AlignRecordSize(sizeof(Record) + size), std::memory_order_release);
+}
+
+const PacketRing::Record* PacketRing::Front()
+{
+    unsigned long long int tail = _tail.load(std::memory_order_relaxed);
+    const unsigned long long int head = _head.load(std::memory_order_acquire);
+    unsigned char* buffer = reinterpret_cast<unsigned char*>(_buffer.get());
+
+    while (tail != head) {
+        const std::size_t position = tail % _capacity;
+        const std::size_t space_till_end = _capacity - position;
+
+        if ((space_till_end < sizeof(Record)) || (WRAP_MARKER == reinterpret_cast<Record*>(buffer + position)->size)) {
+            tail += space_till_end;
+            _tail.store(tail, std::memory_order_release);
+            continue;
+        }
+
+        return reinterpret_cast<Record*>(buffer + position);
+    }
+
+    return nullptr;
+}
+
+void PacketRing::Pop()
+{
+    const unsigned long long int tail = _tail.load(std::memory_order_relaxed);
+    const Record* record = reinterpret_cast<const Record*>(reinterpret_cast<unsigned char*>(_buffer.get()) + tail % _capacity);
+
+    _tail.store(tail + AlignRecordSize(sizeof(Record) + record->size), std::memory_order_release);
+}
+
+} // namespace ddgen
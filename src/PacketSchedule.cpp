@@ -0,0 +1,77 @@
+#include "PacketSchedule.h"
+#include "callleg.h"
+
+namespace ddgen {
+
+namespace {
+const unsigned long long int NO_DEADLINE = (unsigned long long int)(-1); /**< deadline of a slot that has no packets left */
+} // namespace
+
+void PacketSchedule::Reserve(unsigned int numberOfLegs)
+{
+    _deadlines.reserve(numberOfLegs);
+    _limits.reserve(numberOfLegs);
+    _periods.reserve(numberOfLegs);
+    _legs.reserve(numberOfLegs);
+    _dueFlags.reserve(numberOfLegs);
+    _duePackets.reserve(numberOfLegs);
+}
+
+void PacketSchedule::Add(CallLeg& callLeg, unsigned long long int deadline, unsigned int period, unsigned long long int limit)
+{
+    callLeg.SetPacketSlot(_legs.size());
+
+    _deadlines.push_back(deadline);
+    _limits.push_back(limit);
+    _periods.push_back(period);
+    _legs.push_back(&callLeg);
+}
+
+void PacketSchedule::Remove(CallLeg& callLeg)
+{
+    const unsigned int slot = callLeg.GetPacketSlot();
+    const unsigned int last_slot = _legs.size() - 1;
+
+    if (slot != last_slot) {
+        _deadlines[slot] = _deadlines[last_slot];
+        _limits[slot] = _limits[last_slot];
+        _periods[slot] = _periods[last_slot];
+        _legs[slot] = _legs[last_slot];
+        _legs[slot]->SetPacketSlot(slot);
+    }
+
+    _deadlines.pop_back();
+    _limits.pop_back();
+    _periods.pop_back();
+    _legs.pop_back();
+}
+
+void PacketSchedule::_gatherDuePackets(unsigned long long int now)
+{
+    const std::size_t number_of_slots = _deadlines.size();
+    _dueFlags.resize(number_of_slots);
+    _duePackets.clear();
+
+    // branch free so that it is vectorized, all slots are scanned but only deadlines are touched
+    const unsigned long long int* deadlines = _deadlines.data();
+    unsigned char* due_flags = _dueFlags.data();
+    for (std::size_t slot = 0; slot < number_of_slots; ++slot) {
+        due_flags[slot] = (deadlines[slot] <= now);
+    }
+
+    for (std::size_t slot = 0; slot < number_of_slots; ++slot) {
+        if (!due_flags[slot]) {
+            continue;
+        }
+
+        // a leg that is behind is due once for each deadline it has missed
+        unsigned long long int deadline = _deadlines[slot];
+        const unsigned long long int limit = _limits[slot];
+        for (; (deadline <= now) && (deadline < limit); deadline += _periods[slot]) {
+            _duePackets.push_back({ deadline, _legs[slot] });
+        }
+        _deadlines[slot] = (deadline < limit) ? deadline : NO_DEADLINE;
+    }
+}
+
+} // namespace ddgen
@@ -0,0 +1,44 @@
+#include "PacketTemplate.h"
+
+namespace ddgen {
+
+PacketTemplate::PacketTemplate() : _udpSum(0)
+{
+    std::memset(_headers, 0, sizeof(_headers));
+}
+
+void PacketTemplate::Build(const EthHeaderType& eth_header,
+                           const Ipv4HeaderType& ipv4_header,
+                           const UdpHeaderType& udp_header,
+                           const RtpHeaderType& rtp_header)
+{
+    EthHeaderType eth = eth_header;
+    eth.WriteToBuffer(_headers);
+
+    Ipv4HeaderType ipv4 = ipv4_header;
+    ipv4.UpdateChecksumWriteToBuffer(_headers + ipv4_offset);
+
+    UdpHeaderType udp = udp_header;
+    udp.checksum = 0;
+    udp.WriteToBuffer(_headers + udp_offset);
+
+    rtp_header.WriteToBuffer(_headers + rtp_offset);
+
+    PseudoIpv4HeaderType pseudo_ipv4_header;
+    pseudo_ipv4_header.src_addr = ipv4_header.src_addr;
+    pseudo_ipv4_header.dst_addr = ipv4_header.dst_addr;
+    pseudo_ipv4_header.protocol = ipv4_header.protocol;
+    pseudo_ipv4_header.data_len = udp_header.tot_len;
+
+    unsigned char line_pseudo_ipv4_ptr[pseudo_ipv4_header_size];
+    pseudo_ipv4_header.WriteToBuffer(line_pseudo_ipv4_ptr);
+
+    // sequence number and timestamp are added per packet, version flags payload type and ssrc are constant
+    _udpSum = OnesComplementShortSummation(line_pseudo_ipv4_ptr, pseudo_ipv4_header_size);
+    _udpSum += OnesComplementShortSummation(_headers + udp_offset, udp_header_size);
+    _udpSum += ReadShort(rtp_offset);
+    _udpSum += OnesComplementShortSummation(_headers + rtp_offset + 8, 4);
+    _udpSum = Fold(_udpSum);
+}
+
+} // namespace ddgen
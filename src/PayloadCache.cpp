@@ -0,0 +1,91 @@
+#include "PayloadCache.h"
+#include "rawsocket.h"
+
+#include <iostream>
+
+namespace ddgen {
+
+namespace {
+unsigned int GreatestCommonDivisor(unsigned int first, unsigned int second)
+{
+    while (second) {
+        const unsigned int remainder = first % second;
+        first = second;
+        second = remainder;
+    }
+    return first;
+}
+} // namespace
+
+unsigned int PayloadCycle::FindPacket(unsigned int cycleIndex) const
+{
+    for (unsigned int k = 0; k < numberOfPackets; ++k) {
+        if (((firstIndex + k * packetSize) % TONE_CYCLE_SAMPLES) == cycleIndex) {
+            return k;
+        }
+    }
+
+    return numberOfPackets;
+}
+
+const PayloadCycle* PayloadCache::GetCycle(EncoderType& encoder, const GeneratorType& generator)
+{
+    const SingleToneGeneratorType* tone = dynamic_cast<const SingleToneGeneratorType*>(&generator);
+    if ((nullptr == tone) || !tone->IsPeriodic() || !encoder.IsMemoryless()) {
+        return nullptr;
+    }
+
+    // packets start only at multiples of common divisor of packet size and tone cycle, so a cycle covers a residue
+    const unsigned short int packet_size = encoder.GetPacketSize();
+    const unsigned int first_index = tone->GetCycleIndex() % GreatestCommonDivisor(packet_size, TONE_CYCLE_SAMPLES);
+    const Key key(encoder.GetRtpPayload(), packet_size, tone->GetCycleFrequency(), tone->GetCycleAmplitude(), first_index);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _cycles.find(key);
+    if (_cycles.end() == it) {
+        std::unique_ptr<PayloadCycle> cycle = EncodeCycle(encoder, *tone, first_index);
+        if (!cycle) {
+            return nullptr;
+        }
+        it = _cycles.emplace(key, std::move(cycle)).first;
+    }
+
+    return it->second.get();
+}
+
+unsigned int PayloadCache::GetNumberOfCycles() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _cycles.size();
+}
+
+std::unique_ptr<PayloadCycle> PayloadCache::EncodeCycle(EncoderType& encoder, const SingleToneGeneratorType& generator, unsigned int firstIndex)
+{
+    std::unique_ptr<PayloadCycle> cycle(new PayloadCycle);
+    cycle->packetSize = encoder.GetPacketSize();
+    cycle->numberOfPackets = TONE_CYCLE_SAMPLES / GreatestCommonDivisor(cycle->packetSize, TONE_CYCLE_SAMPLES);
+    cycle->firstIndex = firstIndex;
+    cycle->payloads.resize(cycle->numberOfPackets * cycle->packetSize);
+    cycle->sums.resize(cycle->numberOfPackets);
+
+    std::vector<short int> pcm_data(cycle->packetSize);
+    unsigned int cycle_index = firstIndex;
+    for (unsigned int k = 0; k < cycle->numberOfPackets; ++k) {
+        for (auto& sample : pcm_data) {
+            sample = generator.GetCycleSample(cycle_index);
+            cycle_index = (cycle_index + 1) % TONE_CYCLE_SAMPLES;
+        }
+
+        unsigned char* payload_ptr = cycle->payloads.data() + k * cycle->packetSize;
+        if (!encoder.Encode(pcm_data.data(), payload_ptr)) {
+            std::cerr << __FILE__ << " " << __LINE__ << " encoding payload cycle failed" << std::endl;
+            return nullptr;
+        }
+        cycle->sums[k] = OnesComplementShortSummation(payload_ptr, cycle->packetSize);
+    }
+
+    return cycle;
+}
+
+} // namespace ddgen
@@ -0,0 +1,99 @@
+#include "SlabAllocator.h"
+
+#include <new>
+
+namespace ddgen {
+
+namespace {
+std::size_t AlignSlotSize(std::size_t size)
+{
+    const std::size_t alignment = alignof(std::max_align_t);
+    const std::size_t slot_size = (size < sizeof(void*)) ? sizeof(void*) : size;
+    return (slot_size + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+SlabAllocator::SlabAllocator(std::size_t slotSize) : _slotSize(AlignSlotSize(slotSize)), _freeSlots(nullptr), _numberOfSlots(0), _overflowCount(0)
+{
+}
+
+void SlabAllocator::Reserve(unsigned int numberOfSlots)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (numberOfSlots <= _numberOfSlots) {
+        return;
+    }
+
+    const unsigned int number_of_new_slots = numberOfSlots - _numberOfSlots;
+    Chunk chunk = { std::unique_ptr<unsigned char[]>(new unsigned char[number_of_new_slots * _slotSize]), number_of_new_slots * _slotSize };
+
+    // push slots in reverse, so that consecutive allocations get consecutive slots
+    for (unsigned int i = number_of_new_slots; i > 0; --i) {
+        FreeSlot* slot = reinterpret_cast<FreeSlot*>(chunk.memory.get() + (i - 1) * _slotSize);
+        slot->next = _freeSlots;
+        _freeSlots = slot;
+    }
+
+    _chunks.push_back(std::move(chunk));
+    _numberOfSlots = numberOfSlots;
+}
+
+void* SlabAllocator::Allocate(std::size_t size)
+{
+    if (size <= _slotSize) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_freeSlots) {
+            FreeSlot* slot = _freeSlots;
+            _freeSlots = slot->next;
+            return slot;
+        }
+        _overflowCount++;
+    } else {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _overflowCount++;
+    }
+
+    return ::operator new(size);
+}
+
+void SlabAllocator::Deallocate(void* ptr)
+{
+    if (nullptr == ptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_owns(ptr)) {
+        FreeSlot* slot = static_cast<FreeSlot*>(ptr);
+        slot->next = _freeSlots;
+        _freeSlots = slot;
+    } else {
+        ::operator delete(ptr);
+    }
+}
+
+unsigned int SlabAllocator::GetNumberOfSlots() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numberOfSlots;
+}
+
+unsigned long long int SlabAllocator::GetOverflowCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _overflowCount;
+}
+
+bool SlabAllocator::_owns(const void* ptr) const
+{
+    const unsigned char* address = static_cast<const unsigned char*>(ptr);
+    for (const auto& chunk : _chunks) {
+        if ((address >= chunk.memory.get()) && (address < (chunk.memory.get() + chunk.size))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+} // namespace ddgen
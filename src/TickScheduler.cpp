@@ -0,0 +1,76 @@
+#include "TickScheduler.h"
+
+#include <cerrno>
+#include <iostream>
+#include <time.h>
+
+namespace ddgen {
+
+unsigned long long int GetMonotonicUsec()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (unsigned long long int)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+bool SleepUntilMonotonicUsec(unsigned long long int deadline_usec)
+{
+    const timespec deadline_timespec = { (time_t)(deadline_usec / 1000000), (long int)((deadline_usec % 1000000) * 1000) };
+
+    // an interrupted absolute sleep is simply restarted with the same deadline
+    for (;;) {
+        const int result = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline_timespec, nullptr);
+        if (0 == result) {
+            return true;
+        } else if (EINTR != result) {
+            std::cerr << __FILE__ << " " << __LINE__ << " Error in clock_nanosleep(), error: " << result << " deadline: " << deadline_usec
+                      << std::endl;
+            return false;
+        }
+    }
+}
+
+TickScheduler::TickScheduler(unsigned int tickUsec)
+    : _tickUsec(tickUsec)
+    , _startUsec(0)
+    , _nextDeadline(tickUsec)
+    , _driftUsec(0)
+    , _missedDeadlines(0)
+{
+}
+
+void TickScheduler::Start()
+{
+    _startUsec = GetMonotonicUsec();
+    _nextDeadline = _tickUsec;
+    _driftUsec = 0;
+    _missedDeadlines = 0;
+}
+
+unsigned long long int TickScheduler::WaitNextTick()
+{
+    unsigned long long int now = GetMonotonicUsec() - _startUsec;
+
+    // skip deadlines that are at least a whole tick behind, caller catches up by real elapsed time
+    if (now >= _nextDeadline + _tickUsec) {
+        const unsigned long long int missed_deadlines = (now - _nextDeadline) / _tickUsec;
+        _missedDeadlines += missed_deadlines;
+        _nextDeadline += missed_deadlines * _tickUsec;
+    }
+
+    if (now < _nextDeadline) {
+        SleepUntilMonotonicUsec(_startUsec + _nextDeadline);
+        now = GetMonotonicUsec() - _startUsec;
+    }
+
+    if (now > _nextDeadline) {
+        _driftUsec += now - _nextDeadline;
+    }
+
+    _nextDeadline += _tickUsec;
+
+    return now;
+}
+
+} // namespace ddgen
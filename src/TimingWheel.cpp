@@ -0,0 +1,145 @@
+#include "TimingWheel.h"
+
+#include <cstddef>
+
+namespace ddgen {
+
+namespace {
+unsigned int LevelOf(unsigned long long int deadline, unsigned long long int now)
+{
+    // highest 6 bit group that deadline differs from now
+    const unsigned int highest_bit = 63 - __builtin_clzll(deadline ^ now);
+    return highest_bit / TIMING_WHEEL_SLOT_BITS;
+}
+
+unsigned int SlotOf(unsigned long long int time, unsigned int level)
+{
+    return (unsigned int)((time >> (level * TIMING_WHEEL_SLOT_BITS)) & (TIMING_WHEEL_SLOTS - 1));
+}
+
+unsigned long long int StartOfLevelBlock(unsigned long long int time, unsigned int level)
+{
+    // time with all bits of level and lower levels cleared
+    const unsigned int shift = (level + 1) * TIMING_WHEEL_SLOT_BITS;
+    return (shift >= 64) ? 0 : ((time >> shift) << shift);
+}
+} // namespace
+
+TimingWheel::TimingWheel(unsigned long long int now) : _now(now), _size(0), _expired(NULL), _expiredTail(&_expired)
+{
+    for (unsigned int level = 0; level < TIMING_WHEEL_LEVELS; ++level) {
+        _occupied[level] = 0;
+        for (unsigned int slot = 0; slot < TIMING_WHEEL_SLOTS; ++slot) {
+            _slots[level][slot] = NULL;
+        }
+    }
+}
+
+void TimingWheel::Schedule(TimerEvent& event)
+{
+    if (event.IsScheduled()) {
+        _unlink(event);
+    }
+
+    _insert(event);
+}
+
+void TimingWheel::Cancel(TimerEvent& event)
+{
+    if (event.IsScheduled()) {
+        _unlink(event);
+    }
+}
+
+unsigned long long int TimingWheel::NextEventTime() const
+{
+    if (_expired) {
+        return _now;
+    }
+
+    unsigned long long int next_event_time = TIMING_WHEEL_NEVER;
+
+    for (unsigned int level = 0; level < TIMING_WHEEL_LEVELS; ++level) {
+        // slots before current slot of a level are always empty
+        const unsigned long long int occupied = _occupied[level] & (~0ULL << SlotOf(_now, level));
+        if (occupied) {
+            const unsigned int slot = __builtin_ctzll(occupied);
+            const unsigned long long int slot_start =
+                StartOfLevelBlock(_now, level) | ((unsigned long long int)slot << (level * TIMING_WHEEL_SLOT_BITS));
+            if (slot_start < next_event_time) {
+                next_event_time = slot_start;
+            }
+        }
+    }
+
+    return next_event_time;
+}
+
+void TimingWheel::_insert(TimerEvent& event)
+{
+    TimerEvent** head;
+
+    if (event.deadline <= _now) {
+        event.level = TIMING_WHEEL_EXPIRED_LEVEL;
+        event.slot = 0;
+        head = _expiredTail;
+        _expiredTail = &event.next;
+    } else {
+        const unsigned int level = LevelOf(event.deadline, _now);
+        const unsigned int slot = SlotOf(event.deadline, level);
+        event.level = level;
+        event.slot = slot;
+        head = &_slots[level][slot];
+        _occupied[level] |= (1ULL << slot);
+    }
+
+    event.next = *head;
+    if (event.next) {
+        event.next->pprev = &event.next;
+    }
+    event.pprev = head;
+    *head = &event;
+    _size++;
+}
+
+void TimingWheel::_unlink(TimerEvent& event)
+{
+    *event.pprev = event.next;
+    if (event.next) {
+        event.next->pprev = event.pprev;
+    } else if (TIMING_WHEEL_EXPIRED_LEVEL == event.level) {
+        _expiredTail = event.pprev;
+    }
+
+    if ((TIMING_WHEEL_EXPIRED_LEVEL != event.level) && (NULL == _slots[event.level][event.slot])) {
+        _occupied[event.level] &= ~(1ULL << event.slot);
+    }
+
+    event.next = NULL;
+    event.pprev = NULL;
+    _size--;
+}
+
+void TimingWheel::_cascadeSlot(unsigned int level, unsigned int slot)
+{
+    TimerEvent* event = _slots[level][slot];
+
+    while (event) {
+        TimerEvent* next = event->next;
+        _unlink(*event);
+        _insert(*event);
+        event = next;
+    }
+}
+
+void TimingWheel::_setNow(unsigned long long int now)
+{
+    _now = now;
+
+    // cascade current slots from highest level to lowest, events either drop to a lower level or expire
+    for (unsigned int level = TIMING_WHEEL_LEVELS - 1; level > 0; --level) {
+        _cascadeSlot(level, SlotOf(_now, level));
+    }
+}
+
+} // namespace ddgen
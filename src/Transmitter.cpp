@@ -0,0 +1,130 @@
+#include "Transmitter.h"
+#include "TickScheduler.h"
+
+#include <iostream>
+
+namespace ddgen {
+
+LookaheadConsumer::LookaheadConsumer(const std::shared_ptr<IConsumer>& consumer, std::size_t ringSize)
+    : _consumer(consumer)
+    , _ring(ringSize)
+    , _dueTime(0)
+    , _acquiredInRing(false)
+    , _transmittedPackets(0)
+    , _overflowPackets(0)
+{
+}
+
+bool LookaheadConsumer::Consume(const unsigned char* data_ptr, unsigned short int data_size)
+{
+    if (!_ring.Push(_dueTime, data_ptr, data_size)) {
+        _overflowPackets++;
+        return false;
+    }
+
+    return true;
+}
+
+unsigned char* LookaheadConsumer::Acquire(unsigned short int data_size)
+{
+    unsigned char* data_ptr = _ring.Acquire(_dueTime, data_size);
+    _acquiredInRing = (nullptr != data_ptr);
+    if (_acquiredInRing) {
+        return data_ptr;
+    }
+
+    if (_overflow.size() < data_size) {
+        _overflow.resize(data_size);
+    }
+    return _overflow.data();
+}
+
+bool LookaheadConsumer::Commit(unsigned short int data_size)
+{
+    if (!_acquiredInRing) {
+        _overflowPackets++;
+        return false;
+    }
+
+    _ring.Commit(data_size);
+    return true;
+}
+
+void LookaheadConsumer::SetSendTime(unsigned long long int dueTime)
+{
+    _dueTime = dueTime;
+}
+
+unsigned long long int LookaheadConsumer::Transmit(unsigned long long int now)
+{
+    unsigned long long int transmitted_packets = 0;
+
+    const PacketRing::Record* record = nullptr;
+    while ((record = _ring.Front()) && (record->dueTime <= now)) {
+        if (!_consumer->Consume(record->GetData(), (unsigned short int)record->size)) {
+            std::cerr << __FILE__ << " " << __LINE__ << "... can not transmit packet" << std::endl;
+        }
+        _ring.Pop();
+        transmitted_packets++;
+    }
+    _transmittedPackets += transmitted_packets;
+
+    if (transmitted_packets) {
+        _consumer->Flush();
+    }
+
+    return record ? record->dueTime : (unsigned long long int)(-1);
+}
+
+Transmitter::Transmitter(const std::vector<std::shared_ptr<LookaheadConsumer>>& consumers)
+    : _consumers(consumers)
+    , _shallStop(false)
+{
+}
+
+Transmitter::~Transmitter()
+{
+    Stop();
+}
+
+void Transmitter::Start()
+{
+    _shallStop = false;
+    _worker = std::thread(&Transmitter::_run, this);
+}
+
+void Transmitter::Stop()
+{
+    _shallStop = true;
+
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+}
+
+void Transmitter::_run()
+{
+    while (!_shallStop) {
+        const unsigned long long int now = GetMonotonicUsec();
+
+        unsigned long long int wake_up_time = now + TRANSMIT_MAX_SLEEP;
+        for (const auto& consumer : _consumers) {
+            const unsigned long long int next_due_time = consumer->Transmit(now);
+            if (next_due_time < wake_up_time) {
+                wake_up_time = next_due_time;
+            }
+        }
+
+        if (!SleepUntilMonotonicUsec(wake_up_time)) {
+            std::cerr << __FILE__ << " " << __LINE__ << "... can not sleep till next due packet" << std::endl;
+            break;
+        }
+    }
+
+    // producers are stopped already, whatever is left is sent without waiting for its due time
+    for (const auto& consumer : _consumers) {
+        consumer->Transmit((unsigned long long int)(-1));
+    }
+}
+
+} // namespace ddgen
@@ -0,0 +1,126 @@
+#include "WorkStealingPool.h"
+
+namespace ddgen {
+
+WorkStealingPool::WorkStealingPool(unsigned int numberOfWorkers)
+    : _numberOfWorkers((0 == numberOfWorkers) ? 1 : numberOfWorkers)
+    , _deques(_numberOfWorkers)
+    , _generation(0)
+    , _shallStop(false)
+    , _remainingTasks(0)
+    , _stolenTasks(0)
+{
+    for (auto& deque : _deques) {
+        deque.front = 0;
+    }
+
+    for (unsigned int worker = 1; worker < _numberOfWorkers; ++worker) {
+        _threads.emplace_back(&WorkStealingPool::_workerLoop, this, worker);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _shallStop = true;
+    }
+    _startCondition.notify_all();
+
+    for (auto& thread : _threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::Run(const std::vector<Task>& tasks)
+{
+    if (tasks.empty()) {
+        return;
+    }
+
+    // counter is set before tasks are visible, a worker that is late from previous batch may already take them
+    const unsigned int number_of_tasks = tasks.size();
+    _remainingTasks = number_of_tasks;
+
+    // contiguous ranges keep tasks that are created together on the same worker unless they are stolen
+    for (unsigned int worker = 0; worker < _numberOfWorkers; ++worker) {
+        TaskDeque& deque = _deques[worker];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        deque.tasks.assign(tasks.begin() + (unsigned long long int)number_of_tasks * worker / _numberOfWorkers,
+                           tasks.begin() + (unsigned long long int)number_of_tasks * (worker + 1) / _numberOfWorkers);
+        deque.front = 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _generation++;
+    }
+    _startCondition.notify_all();
+
+    _work(0);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _doneCondition.wait(lock, [this]() { return 0 == _remainingTasks; });
+}
+
+void WorkStealingPool::_workerLoop(unsigned int worker)
+{
+    unsigned long long int generation = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _startCondition.wait(lock, [this, generation]() { return (_generation != generation) || _shallStop; });
+            if (_shallStop) {
+                return;
+            }
+            generation = _generation;
+        }
+
+        _work(worker);
+    }
+}
+
+void WorkStealingPool::_work(unsigned int worker)
+{
+    Task task;
+
+    while (_pop(worker, task) || _steal(worker, task)) {
+        task.function(task.owner, task.context, worker);
+
+        if (1 == _remainingTasks--) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _doneCondition.notify_all();
+        }
+    }
+}
+
+bool WorkStealingPool::_pop(unsigned int worker, Task& task)
+{
+    TaskDeque& deque = _deques[worker];
+    std::lock_guard<std::mutex> lock(deque.mutex);
+    if (deque.front == deque.tasks.size()) {
+        return false;
+    }
+
+    task = deque.tasks.back();
+    deque.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::_steal(unsigned int thief, Task& task)
+{
+    for (unsigned int i = 1; i < _numberOfWorkers; ++i) {
+        TaskDeque& deque = _deques[(thief + i) % _numberOfWorkers];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        if (deque.front != deque.tasks.size()) {
+            task = deque.tasks[deque.front++];
+            _stolenTasks++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+} // namespace ddgen
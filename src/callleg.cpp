@@ -1,4 +1,7 @@
 #include "callleg.h"
+#include "EncodeBatcher.h"
+#include "SlabAllocator.h"
+#include "g722encoder.h"
 
 #include <arpa/inet.h>
 #include <iomanip>
@@ -6,14 +9,53 @@
 #include <sys/socket.h>
 
 #include <chrono>
+#include <cstring>
 #include <iostream>
 #include <limits.h>
 #include <random>
 #include <sstream>
 #include <time.h>
+#include <typeinfo>
 
 namespace ddgen {
 
+namespace {
+constexpr std::size_t Max(std::size_t first, std::size_t second)
+{
+    return (first > second) ? first : second;
+}
+
+/**
+ * @brief Buffer that a thread generates pcm in, shared by all legs that thread sends packets of
+ *
+ * Packets themselves are built in memory acquired from consumer.
+ */
+short int* GetPcmScratch(unsigned short int numberOfSamples)
+{
+    thread_local std::vector<short int> pcm;
+
+    // buffer only grows, so after first packets of each codec no allocation is done
+    if (pcm.size() < numberOfSamples) {
+        pcm.resize(numberOfSamples);
+    }
+
+    return pcm.data();
+}
+
+SlabAllocator& GetCallLegSlab()
+{
+    static SlabAllocator slab(sizeof(CallLeg));
+    return slab;
+}
+
+SlabAllocator& GetCallSlab()
+{
+    // slot should fit any kind of call
+    static SlabAllocator slab(Max(sizeof(DRLinkCall), sizeof(MirrorCall)));
+    return slab;
+}
+} // namespace
+
 CallLeg::CallLeg(unsigned int src_addr,
                  unsigned short int src_port,
                  unsigned int dst_addr,
@@ -24,17 +66,55 @@ CallLeg::CallLeg(unsigned int src_addr,
                  unsigned short int seq_num,
                  EncoderFactory* encoder_factory_ptr,
                  GeneratorFactory* generator_factory_ptr,
-                 const std::shared_ptr<IConsumer>& consumer)
+                 const std::shared_ptr<IConsumer>& consumer,
+                 PayloadCache* payload_cache_ptr,
+                 ClipLibrary* clip_library_ptr)
+    : m_packet_slot(0)
+    , m_call(nullptr)
+    , m_due_packets(0)
+    , m_due_time(0)
+    , m_encoder(clip_library_ptr ? nullptr : encoder_factory_ptr->CreateEncoder())
+    , m_generator(clip_library_ptr ? nullptr : generator_factory_ptr->CreateGenerator())
+    , m_batch_payload(nullptr)
+    , m_stored_payloads(nullptr)
+    , m_stored_sums(nullptr)
+    , m_number_of_stored_payloads(0)
+    , m_stored_payload(0)
 {
-    m_accumulated_step_time = 0;
-    m_remaining_time = 0;
-    m_encoder_ptr = encoder_factory_ptr->CreateEncoder();
-    m_generator_ptr = generator_factory_ptr->CreateGenerator();
     _consumer = consumer;
-    m_line_data.m_rtp_data_size = m_encoder_ptr->GetPacketSize();
+
+    if (clip_library_ptr) {
+        // legs start at different packets of clip, ssrc is random
+        const Clip* clip = clip_library_ptr->SelectClip();
+        m_rtp_data_size = CLIP_PACKET_SIZE;
+        m_pcm_size = 0;
+        m_timestamp_step = PACKET_DURATION * RTP_CLOCK_RATE / 1000;
+        m_rtp_header.payload = clip->payloadType;
+        m_stored_payloads = clip->payloads;
+        m_stored_sums = clip->sums.data();
+        m_number_of_stored_payloads = clip->numberOfPackets;
+        m_stored_payload = ssrc % clip->numberOfPackets;
+        m_send_function = &CallLeg::SendStoredPacket;
+    } else {
+        m_rtp_data_size = m_encoder->GetPayloadSize();
+        m_pcm_size = m_encoder->GetPacketSize();
+        m_timestamp_step = m_encoder->GetPacketDuration() * RTP_CLOCK_RATE / 1000;
+        m_rtp_header.payload = m_encoder->GetRtpPayload();
+        m_send_function = SelectSendFunction(*m_encoder, *m_generator);
+
+        const PayloadCycle* payload_cycle = payload_cache_ptr ? payload_cache_ptr->GetCycle(*m_encoder, *m_generator) : nullptr;
+        if (payload_cycle) {
+            // generator is not stepped on this path, leg starts at current position of tone
+            const SingleToneGeneratorType& tone = static_cast<const SingleToneGeneratorType&>(*m_generator);
+            m_stored_payloads = payload_cycle->GetPayload(0);
+            m_stored_sums = payload_cycle->sums.data();
+            m_number_of_stored_payloads = payload_cycle->numberOfPackets;
+            m_stored_payload = payload_cycle->FindPacket(tone.GetCycleIndex());
+            m_send_function = &CallLeg::SendStoredPacket;
+        }
+    }
 
     // form rtp header
-    m_rtp_header.payload = m_encoder_ptr->GetRtpPayload();
     m_rtp_header.timestamp = timestamp;
     m_rtp_header.ssrc = ssrc;
     m_rtp_header.seq_num = seq_num;
@@ -47,7 +127,7 @@ CallLeg::CallLeg(unsigned int src_addr,
     // form udp header
     m_udp_header.src_port = src_port;
     m_udp_header.dst_port = dst_port;
-    m_udp_header.tot_len = m_line_data.m_rtp_data_size + rtp_header_size + udp_header_size;
+    m_udp_header.tot_len = m_rtp_data_size + rtp_header_size + udp_header_size;
     m_udp_header.checksum = 0; // set to zero, willbe updated when writing to buffer
 
     // form ipv4 header
@@ -63,78 +143,177 @@ CallLeg::CallLeg(unsigned int src_addr,
     m_ipv4_header.id = id;
     m_ipv4_header.checksum = 0; // set to zero, will be updated when writing to buffer
 
-    // form pseudo ipv4 header
-    m_pseudo_ipv4_header.src_addr = m_ipv4_header.src_addr;
-    m_pseudo_ipv4_header.dst_addr = m_ipv4_header.dst_addr;
-    m_pseudo_ipv4_header.protocol = m_ipv4_header.protocol;
-    m_pseudo_ipv4_header.data_len = m_udp_header.tot_len;
+    // form ethernet header, mac addresses are derived from ipv4 addresses
+    EthHeaderType eth_header;
+    std::memset(&eth_header, 0, sizeof(eth_header));
+    *((unsigned int*)(eth_header.src_mac + 2)) = htonl(src_addr);
+    *((unsigned int*)(eth_header.dst_mac + 2)) = htonl(dst_addr);
+    eth_header.eth_type = 0x0800;
 
-    // form ethernet header
-    *((unsigned int*)(m_eth_header.src_mac + 2)) = htonl(src_addr);
-    *((unsigned int*)(m_eth_header.dst_mac + 2)) = htonl(dst_addr);
-    m_eth_header.eth_type = 0x0800;
+    m_packet_template.Build(eth_header, m_ipv4_header, m_udp_header, m_rtp_header);
 }
 
-CallLeg::~CallLeg()
+void* CallLeg::operator new(std::size_t size)
 {
-    if (m_encoder_ptr) {
-        delete m_encoder_ptr;
-        m_encoder_ptr = NULL;
+    return GetCallLegSlab().Allocate(size);
+}
+
+void CallLeg::operator delete(void* ptr)
+{
+    GetCallLegSlab().Deallocate(ptr);
+}
+
+bool CallLeg::SendPacket()
+{
+    return SendPacket(*_consumer);
+}
+
+bool CallLeg::SendPacket(IConsumer& consumer)
+{
+    return m_send_function(*this, consumer);
+}
+
+CallLeg::SendFunction CallLeg::SelectSendFunction(const EncoderType& encoder, const GeneratorType& generator)
+{
+    struct SendPath
+    {
+        const std::type_info& encoder;
+        const std::type_info& generator;
+        SendFunction send;
+    };
+
+    static const SendPath send_paths[] = {
+        { typeid(G711aEncoderType), typeid(SingleToneGeneratorType), &CallLeg::SendFusedPacket<G711aEncoderType, SingleToneGeneratorType> },
+        { typeid(G711uEncoderType), typeid(SingleToneGeneratorType), &CallLeg::SendFusedPacket<G711uEncoderType, SingleToneGeneratorType> },
+        { typeid(G711aEncoderType), typeid(ZeroGeneratorType), &CallLeg::SendFusedPacket<G711aEncoderType, ZeroGeneratorType> },
+        { typeid(G711uEncoderType), typeid(ZeroGeneratorType), &CallLeg::SendFusedPacket<G711uEncoderType, ZeroGeneratorType> }
+    };
+
+    // a continuous tone is generated by a vectorized oscillator, writing its pcm and encoding that with simd kernels is
+    // faster than fusing them sample by sample
+    const bool continuous_tone = (typeid(SingleToneGeneratorType) == typeid(generator)) &&
+                                 !static_cast<const SingleToneGeneratorType&>(generator).IsPeriodic();
+
+    for (const auto& send_path : send_paths) {
+        if (!continuous_tone && (send_path.encoder == typeid(encoder)) && (send_path.generator == typeid(generator))) {
+            return send_path.send;
+        }
     }
 
-    if (m_generator_ptr) {
-        delete m_generator_ptr;
-        m_generator_ptr = NULL;
+    // G722 is not sample wise, its ADPCM is vectorized across legs instead
+    if (typeid(G722EncoderType) == typeid(encoder)) {
+        return &CallLeg::SendBatchedPacket;
     }
+
+    return &CallLeg::SendGenericPacket;
 }
 
-void CallLeg::Step(unsigned short int stepDuration)
+bool CallLeg::SendGenericPacket(CallLeg& callLeg, IConsumer& consumer)
 {
-    m_accumulated_step_time += stepDuration;
+    short int* pcm_data_ptr = GetPcmScratch(callLeg.m_pcm_size);
+    unsigned char* eth_hdr_ptr = consumer.Acquire(PacketTemplate::headers_size + callLeg.m_rtp_data_size);
+    unsigned char* rtp_data_ptr = eth_hdr_ptr + PacketTemplate::headers_size;
 
-    while (m_accumulated_step_time >= m_encoder_ptr->GetPacketDuration()) {
-        if (!m_generator_ptr->Generate(m_pcm_data_ptr, m_line_data.m_rtp_data_size)) {
-            std::cerr << __FILE__ << " " << __LINE__ << "m_generator_ptr->Generate() failed" << std::endl;
-            return;
-        }
+    if (!callLeg.m_generator->Generate(pcm_data_ptr, callLeg.m_pcm_size)) {
+        std::cerr << __FILE__ << " " << __LINE__ << "m_generator->Generate() failed" << std::endl;
+        return false;
+    }
 
-        if (!m_encoder_ptr->Encode(m_pcm_data_ptr, m_line_data.m_rtp_data_ptr)) {
-            std::cerr << __FILE__ << " " << __LINE__ << "m_encoder_ptr->Encode() failed" << std::endl;
-            return;
-        }
+    if (!callLeg.m_encoder->Encode(pcm_data_ptr, rtp_data_ptr)) {
+        std::cerr << __FILE__ << " " << __LINE__ << "m_encoder->Encode() failed" << std::endl;
+        return false;
+    }
 
-        if (false == m_rtp_header.WriteToBuffer(m_line_data.m_rtp_hdr_ptr)) {
-            std::cerr << __FILE__ << " " << __LINE__ << "m_rtp_header.WriteToBuffer() failed" << std::endl;
-            return;
-        }
+    return callLeg.CompletePacket(eth_hdr_ptr, OnesComplementShortSummation(rtp_data_ptr, callLeg.m_rtp_data_size), consumer);
+}
 
-        // update udp length if necessary
-        // m_udp_header.tot_len =
-        if (false == m_udp_header.UpdateChecksumWriteToBuffer(m_line_data.m_udp_hdr_ptr, m_line_data.m_rtp_hdr_ptr, m_pseudo_ipv4_header)) {
-            std::cerr << __FILE__ << " " << __LINE__ << "m_udp_header.UpdateChecksumWriteToBuffer() failed" << std::endl;
-            return;
-        }
+bool CallLeg::SendStoredPacket(CallLeg& callLeg, IConsumer& consumer)
+{
+    unsigned char* eth_hdr_ptr = consumer.Acquire(PacketTemplate::headers_size + callLeg.m_rtp_data_size);
 
-        if (false == m_ipv4_header.UpdateChecksumWriteToBuffer(m_line_data.m_ipv4_hdr_ptr)) {
-            std::cerr << __FILE__ << " " << __LINE__ << "m_ipv4_header.UpdateChecksumWriteToBuffer() failed" << std::endl;
-            return;
-        }
+    const unsigned int packet = callLeg.m_stored_payload;
+    std::memcpy(eth_hdr_ptr + PacketTemplate::headers_size, callLeg.m_stored_payloads + packet * callLeg.m_rtp_data_size, callLeg.m_rtp_data_size);
+    callLeg.m_stored_payload = (packet + 1 == callLeg.m_number_of_stored_payloads) ? 0 : packet + 1;
 
-        if (false == m_eth_header.WriteToBuffer(m_line_data.m_eth_hdr_ptr)) {
-            std::cerr << __FILE__ << " " << __LINE__ << "m_eth_header.WriteToBuffer() failed" << std::endl;
-            return;
-        }
+    return callLeg.CompletePacket(eth_hdr_ptr, callLeg.m_stored_sums[packet], consumer);
+}
+
+bool CallLeg::SendBatchedPacket(CallLeg& callLeg, IConsumer& consumer)
+{
+    const BatchPayload* batch_payload = callLeg.m_batch_payload;
+    if ((nullptr == batch_payload) || !batch_payload->encoded) {
+        callLeg.m_batch_payload = nullptr;
+        return SendGenericPacket(callLeg, consumer);
+    }
+    callLeg.m_batch_payload = batch_payload->next;
 
-        _consumer->Consume(m_line_data.m_line_data, m_line_data.LineDataSize());
+    unsigned char* eth_hdr_ptr = consumer.Acquire(PacketTemplate::headers_size + callLeg.m_rtp_data_size);
+    unsigned char* rtp_data_ptr = eth_hdr_ptr + PacketTemplate::headers_size;
 
-        // update necessary fields for the next iteration / step
-        m_accumulated_step_time -= m_encoder_ptr->GetPacketDuration();
-        m_rtp_header.seq_num++;
-        m_rtp_header.timestamp += m_encoder_ptr->GetPacketSize();
+    // batch holds codes of a packet, as Encode() writes them
+    std::memcpy(rtp_data_ptr, batch_payload->codes, callLeg.m_rtp_data_size);
 
-        // increment ip identification field
-        m_ipv4_header.id++;
+    return callLeg.CompletePacket(eth_hdr_ptr, OnesComplementShortSummation(rtp_data_ptr, callLeg.m_rtp_data_size), consumer);
+}
+
+template <typename Encoder, typename Generator>
+bool CallLeg::SendFusedPacket(CallLeg& callLeg, IConsumer& consumer)
+{
+    // types are checked at selection, so that calls below are resolved at compile time and inlined
+    Generator& generator = static_cast<Generator&>(*callLeg.m_generator);
+    unsigned char* eth_hdr_ptr = consumer.Acquire(PacketTemplate::headers_size + callLeg.m_rtp_data_size);
+    unsigned char* rtp_data_ptr = eth_hdr_ptr + PacketTemplate::headers_size;
+
+    // samples are encoded as they are generated, pcm is never written to memory
+    for (unsigned int k = 0; k < callLeg.m_rtp_data_size; ++k) {
+        rtp_data_ptr[k] = Encoder::EncodeSample(generator.Generator::NextSample());
     }
+    generator.Generator::FinishPacket();
+
+    return callLeg.CompletePacket(eth_hdr_ptr, OnesComplementShortSummation(rtp_data_ptr, callLeg.m_rtp_data_size), consumer);
+}
+
+bool CallLeg::CompletePacket(unsigned char* eth_hdr_ptr, unsigned short int payload_sum, IConsumer& consumer)
+{
+    m_packet_template.Write(eth_hdr_ptr, m_rtp_header.seq_num, m_rtp_header.timestamp, m_ipv4_header.id, payload_sum);
+
+    const bool is_committed = consumer.Commit(PacketTemplate::headers_size + m_rtp_data_size);
+
+    // update necessary fields for the next packet, timestamp advances by packet duration, also when packet is dropped
+    m_rtp_header.seq_num++;
+    m_rtp_header.timestamp += m_timestamp_step;
+
+    // increment ip identification field
+    m_ipv4_header.id++;
+
+    return is_committed;
+}
+
+void CallLeg::SkipPacket()
+{
+    m_rtp_header.seq_num++;
+    m_rtp_header.timestamp += m_timestamp_step;
+    m_ipv4_header.id++;
+}
+
+G722EncoderType* CallLeg::GetBatchEncoder() const
+{
+    return (&CallLeg::SendBatchedPacket == m_send_function) ? static_cast<G722EncoderType*>(m_encoder.get()) : nullptr;
+}
+
+bool CallLeg::GenerateBatchPcm(short int* pcm_data_ptr)
+{
+    if (!m_generator->Generate(pcm_data_ptr, m_pcm_size)) {
+        std::cerr << __FILE__ << " " << __LINE__ << "m_generator->Generate() failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+unsigned int CallLeg::GetPacketInterval() const
+{
+    // clip packets are of default duration
+    return (m_encoder ? m_encoder->GetPacketDuration() : PACKET_DURATION) * 1000;
 }
 
 CallParameters::StreamParameters CallLeg::GetParameters() const
@@ -151,35 +330,47 @@ CallParameters::StreamParameters CallLeg::GetParameters() const
              m_rtp_header.timestamp,
              m_rtp_header.ssrc,
              m_rtp_header.seq_num,
-             m_generator_ptr->GetParameters() };
+             m_generator ? m_generator->GetParameters() : std::vector<CallParameters::StreamParameters::ToneParameters>() };
 }
 
-Call::Call(unsigned int duration, const std::shared_ptr<ICallLogger>& callLogger) : m_duration(duration * 1000), _callLogger(callLogger)
+Call::Call(unsigned int duration, const std::shared_ptr<ICallLogger>& callLogger)
+    : m_number_of_call_legs(0), m_duration(duration * 1000), _callLogger(callLogger), m_index(0), m_work_stamp(0), m_consumer(0)
 {
 }
 
-bool Call::Step(unsigned int step_duration)
+void* Call::operator new(std::size_t size)
 {
-    bool still_has_time = true;
-    if (m_duration < step_duration) {
-        // change step duration to whatever time call has
-        step_duration = m_duration;
-        still_has_time = false;
-    }
+    return GetCallSlab().Allocate(size);
+}
+
+void Call::operator delete(void* ptr)
+{
+    GetCallSlab().Deallocate(ptr);
+}
+
+void Call::ReserveSlots(unsigned int numberOfCalls, unsigned int numberOfCallLegs)
+{
+    GetCallSlab().Reserve(numberOfCalls);
+    GetCallLegSlab().Reserve(numberOfCalls * numberOfCallLegs);
+}
 
-    for (auto& cl : m_call_leg_ptr_vector) {
-        cl->Step(step_duration);
+bool Call::AddCallLeg(std::unique_ptr<CallLeg> call_leg)
+{
+    if (MAX_CALL_LEGS == m_number_of_call_legs) {
+        std::cerr << __FILE__ << " " << __LINE__ << " call can not have more than " << MAX_CALL_LEGS << " legs" << std::endl;
+        return false;
     }
 
-    m_duration -= step_duration;
-    return still_has_time;
+    call_leg->SetCall(this);
+    m_call_legs[m_number_of_call_legs++] = std::move(call_leg);
+    return true;
 }
 
 void Call::Log()
 {
     CallParameters parameters;
 
-    for (const auto& cl : m_call_leg_ptr_vector) {
+    for (const auto& cl : GetCallLegs()) {
         parameters.streams.push_back(cl->GetParameters());
     }
 
@@ -245,9 +436,11 @@ DRLinkCall::DRLinkCall(std::vector<IpPort>& dst_inf, unsigned int src_ip, const
                                                   seq_num,
                                                   options.encoder_factory_ptr,
                                                   options.generator_factory_ptr,
-                                                  options.consumer);
+                                                  options.consumer,
+                                                  options.payload_cache_ptr,
+                                                  options.clip_library_ptr);
 
-        m_call_leg_ptr_vector.push_back(std::move(call_leg));
+        AddCallLeg(std::move(call_leg));
 
         src_port += 2;
         id += id_offset;
@@ -293,8 +486,10 @@ MirrorCall::MirrorCall(unsigned int src_ip, unsigned int dst_ip, const Call::Opt
                                                   seq_num,
                                                   options.encoder_factory_ptr,
                                                   options.generator_factory_ptr,
-                                                  options.consumer);
-    m_call_leg_ptr_vector.push_back(std::move(src_call_leg));
+                                                  options.consumer,
+                                                  options.payload_cache_ptr,
+                                                  options.clip_library_ptr);
+    AddCallLeg(std::move(src_call_leg));
 
     id += id_offset;
     timestamp = uint_distribution(generator);
@@ -311,8 +506,10 @@ MirrorCall::MirrorCall(unsigned int src_ip, unsigned int dst_ip, const Call::Opt
                                                   seq_num,
                                                   options.encoder_factory_ptr,
                                                   options.generator_factory_ptr,
-                                                  options.consumer);
-    m_call_leg_ptr_vector.push_back(std::move(dst_call_leg));
+                                                  options.consumer,
+                                                  options.payload_cache_ptr,
+                                                  options.clip_library_ptr);
+    AddCallLeg(std::move(dst_call_leg));
 
     Call::Log();
 }
@@ -326,11 +523,16 @@ std::unique_ptr<Call> MirrorCallFactory::CreateCall(const Call::Options& options
 
 std::unique_ptr<ICallFactory> CallFactoryFactory::CreateCallFactory(const Options& options)
 {
+    std::unique_ptr<ICallFactory> call_factory;
     if (options.traffic == ddgen::Traffic::DrLink) {
-        return std::make_unique<ddgen::DRLinkCallFactory>(options.drlinkIpPortVector, options.startIp);
+        call_factory = std::make_unique<ddgen::DRLinkCallFactory>(options.drlinkIpPortVector, options.startIp);
     } else {
-        return std::make_unique<ddgen::MirrorCallFactory>(options.startIp);
+        call_factory = std::make_unique<ddgen::MirrorCallFactory>(options.startIp);
     }
+
+    Call::ReserveSlots(options.numberOfCalls, call_factory->GetNumberOfCallLegs());
+
+    return call_factory;
 }
 
 } // namespace ddgen
@@ -1,7 +1,9 @@
 #include "consumer.h"
 
 #include <cerrno>
+#include <climits>
 #include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <netinet/in.h>
 #include <string>
@@ -10,6 +12,40 @@
 
 namespace ddgen {
 
+namespace {
+/**
+ * @brief Write all of given vectors, continuing after partial writes
+ *
+ * @param vectors INPUT vectors, modified as they are written
+ * @return false if file could not be written
+ */
+bool WriteVectors(int fd, iovec* vectors, std::size_t numberOfVectors)
+{
+    while (numberOfVectors > 0) {
+        const ssize_t written_size = writev(fd, vectors, (numberOfVectors < IOV_MAX) ? (int)numberOfVectors : IOV_MAX);
+        if (written_size < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return false;
+        }
+
+        std::size_t remaining_size = written_size;
+        while ((numberOfVectors > 0) && (remaining_size >= vectors->iov_len)) {
+            remaining_size -= vectors->iov_len;
+            vectors++;
+            numberOfVectors--;
+        }
+        if (remaining_size > 0) {
+            vectors->iov_base = static_cast<unsigned char*>(vectors->iov_base) + remaining_size;
+            vectors->iov_len -= remaining_size;
+        }
+    }
+
+    return true;
+}
+} // namespace
+
 void GetCurrentTimeInTv(unsigned int& sec, unsigned int& usec)
 {
     timeval tv;
@@ -20,6 +56,31 @@ void GetCurrentTimeInTv(unsigned int& sec, unsigned int& usec)
         std::cerr << __FILE__ << " " << __LINE__ << " unable to obtain time info" << std::endl;
 }
 
+unsigned char* IConsumer::Acquire(unsigned short int data_size)
+{
+    // buffer only grows, so after first packets no allocation is done
+    if (_acquired.size() < data_size) {
+        _acquired.resize(data_size);
+    }
+
+    return _acquired.data();
+}
+
+bool IConsumer::Commit(unsigned short int data_size)
+{
+    return Consume(_acquired.data(), data_size);
+}
+
+bool IConsumer::ConsumeBatch(const PacketDescriptor* packets, std::size_t numberOfPackets)
+{
+    bool success = true;
+    for (std::size_t k = 0; k < numberOfPackets; ++k) {
+        success = Consume(packets[k].data, packets[k].size) && success;
+    }
+
+    return success;
+}
+
 SocketConsumer::SocketConsumer(const std::vector<IpPort>& dstIpPort)
 {
     for (std::vector<IpPort>::const_iterator it = dstIpPort.begin(); it != dstIpPort.end(); ++it) {
@@ -65,81 +126,142 @@ SocketConsumer::~SocketConsumer()
     }
 }
 
-bool SocketConsumer::Consume(const unsigned char* data_ptr, unsigned short int data_size)
+int SocketConsumer::FindDestination(const unsigned char* data_ptr) const
 {
-    // first determine the socket
-    unsigned int dst_ip = *((unsigned int*)(data_ptr + eth_header_size + 16));
-    unsigned short int dst_port = *((unsigned short int*)(data_ptr + eth_header_size + ipv4_header_size + 2));
-
-    std::vector<int>::iterator sock_it = m_dst_sock_vector.begin();
-
-    for (std::vector<sockaddr_in>::iterator it = m_dst_sockaddr_vector.begin(); it != m_dst_sockaddr_vector.end(); ++it, ++sock_it) {
-        if ((it->sin_port == dst_port) && (it->sin_addr.s_addr == dst_ip)) {
-            const auto sended_data_size = sendto(*sock_it,
-                                                 (const char*)(data_ptr + eth_header_size),
-                                                 (data_size - eth_header_size),
-                                                 0,
-                                                 (struct sockaddr*)(&(*it)),
-                                                 (socklen_t)sizeof(*it));
-            if (-1 == sended_data_size) {
-                std::cerr << __FILE__ << " " << __LINE__ << " unable to send data of size : " << data_size << " to socket : " << *sock_it
-                          << std::endl;
-                return false;
-            } else {
-                return true;
-            }
+    unsigned int dst_ip;
+    unsigned short int dst_port;
+    std::memcpy(&dst_ip, data_ptr + eth_header_size + 16, sizeof(dst_ip));
+    std::memcpy(&dst_port, data_ptr + eth_header_size + ipv4_header_size + 2, sizeof(dst_port));
+
+    for (std::size_t destination = 0; destination < m_dst_sock_vector.size(); ++destination) {
+        const sockaddr_in& dst_sockaddr = m_dst_sockaddr_vector[destination];
+        if ((dst_sockaddr.sin_port == dst_port) && (dst_sockaddr.sin_addr.s_addr == dst_ip)) {
+            return (int)destination;
         }
     }
 
     // if not able to find a match, send it to the first socket, possible pair mode
-    std::vector<sockaddr_in>::iterator net_it = m_dst_sockaddr_vector.begin();
-    sock_it = m_dst_sock_vector.begin();
-
-    if ((net_it != m_dst_sockaddr_vector.end()) && (sock_it != m_dst_sock_vector.end())) {
-        const auto sended_data_size = sendto(*sock_it,
-                                             (const char*)(data_ptr + eth_header_size),
-                                             (data_size - eth_header_size),
-                                             0,
-                                             (struct sockaddr*)(&(*net_it)),
-                                             (socklen_t)sizeof(*net_it));
-        if (-1 == sended_data_size) {
-            std::cerr << __FILE__ << " " << __LINE__ << " unable to send data of size : " << data_size << " to socket : " << *sock_it << std::endl;
-            return false;
-        } else {
-            return true;
+    if (m_dst_sock_vector.empty()) {
+        std::cerr << __FILE__ << " " << __LINE__ << " unable to find socket to send for destination: " << std::hex << dst_ip << std::dec << ":"
+                  << dst_port << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+bool SocketConsumer::Consume(const unsigned char* data_ptr, unsigned short int data_size)
+{
+    const int destination = FindDestination(data_ptr);
+    if (destination < 0) {
+        return false;
+    }
+
+    const auto sended_data_size = sendto(m_dst_sock_vector[destination],
+                                         (const char*)(data_ptr + eth_header_size),
+                                         (data_size - eth_header_size),
+                                         0,
+                                         (struct sockaddr*)(&m_dst_sockaddr_vector[destination]),
+                                         (socklen_t)sizeof(sockaddr_in));
+    if (-1 == sended_data_size) {
+        std::cerr << __FILE__ << " " << __LINE__ << " unable to send data of size : " << data_size
+                  << " to socket : " << m_dst_sock_vector[destination] << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool SocketConsumer::ConsumeBatch(const PacketDescriptor* packets, std::size_t numberOfPackets)
+{
+    bool success = true;
+
+    // messages are grouped per socket, packets of a destination keep their order
+    m_messages.resize(m_dst_sock_vector.size());
+    for (auto& messages : m_messages) {
+        messages.clear();
+    }
+    m_iovecs.resize(numberOfPackets);
+
+    for (std::size_t k = 0; k < numberOfPackets; ++k) {
+        const PacketDescriptor& packet = packets[k];
+        const int destination = (packet.destination < 0) ? FindDestination(packet.data) : packet.destination;
+        if ((destination < 0) || (destination >= (int)m_dst_sock_vector.size())) {
+            success = false;
+            continue;
         }
+
+        m_iovecs[k].iov_base = const_cast<unsigned char*>(packet.data + eth_header_size);
+        m_iovecs[k].iov_len = packet.size - eth_header_size;
+
+        mmsghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_hdr.msg_name = &m_dst_sockaddr_vector[destination];
+        message.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        message.msg_hdr.msg_iov = &m_iovecs[k];
+        message.msg_hdr.msg_iovlen = 1;
+        m_messages[destination].push_back(message);
     }
 
-    std::cerr << __FILE__ << " " << __LINE__ << " unable to find socket to send for destination: " << std::hex << dst_ip << std::dec << ":"
-              << dst_port << std::endl;
-    return false;
+    for (std::size_t destination = 0; destination < m_messages.size(); ++destination) {
+        std::vector<mmsghdr>& messages = m_messages[destination];
+        std::size_t sent_messages = 0;
+
+        while (sent_messages < messages.size()) {
+            const std::size_t remaining_messages = messages.size() - sent_messages;
+            const int result = sendmmsg(m_dst_sock_vector[destination],
+                                        messages.data() + sent_messages,
+                                        (remaining_messages < UIO_MAXIOV) ? (unsigned int)remaining_messages : UIO_MAXIOV,
+                                        0);
+            if (result < 0) {
+                if (EINTR == errno) {
+                    continue;
+                }
+                std::cerr << __FILE__ << " " << __LINE__ << " unable to send " << remaining_messages << " packets to socket : "
+                          << m_dst_sock_vector[destination] << " " << strerror(errno) << std::endl;
+                success = false;
+                break;
+            }
+            sent_messages += result;
+        }
+    }
+
+    return success;
 }
 
-PcapConsumer::PcapConsumer(const std::shared_ptr<ICallStorage>& callStorage) : _callStorage(callStorage), _fileSize(0)
+PcapConsumer::PcapConsumer(const std::shared_ptr<ICallStorage>& callStorage, const std::string& tag, const std::shared_ptr<IClock>& clock)
+    : _callStorage(callStorage)
+    , _clock(clock ? clock : std::make_shared<SystemClock>())
+    , _tag(tag)
+    , _fileDescriptor(-1)
+    , _fileSize(0)
+    , _block(PCAP_BLOCK_SIZE)
+    , _blockUsed(0)
 {
     GenerateFileName();
 
-    _fileStream.open(_fileName.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::app);
-
-    if (!(_fileStream.is_open())) {
-        std::cerr << __FILE__ << " " << __LINE__ << " output stream is not able to be added. Filename : " << _fileName << std::endl;
+    if (!OpenFile()) {
         return;
     }
 
-    int pcap_file_hdr_size = sizeof(_pcapFileHeader);
-    _fileStream.write((char*)(&_pcapFileHeader), pcap_file_hdr_size);
-    _fileSize = pcap_file_hdr_size;
+    // file header goes through block, so that it is written together with first records
+    std::memcpy(_block.data(), &_pcapFileHeader, sizeof(_pcapFileHeader));
+    _blockUsed = sizeof(_pcapFileHeader);
+    _fileSize = sizeof(_pcapFileHeader);
 }
 
 PcapConsumer::~PcapConsumer()
 {
-    if (_fileStream.is_open())
-        _fileStream.close();
+    FlushBlock();
+
+    if (_fileDescriptor >= 0) {
+        close(_fileDescriptor);
+        _fileDescriptor = -1;
+    }
 
     _callStorage->Store(_fileName);
 
     _fileName.clear();
-    _fileStream.clear();
     _fileSize = 0;
 }
 
@@ -166,39 +288,103 @@ void PcapConsumer::GenerateFileName()
 
     if ((snprintf_result <= 0) || (snprintf_result >= time_part_size)) {
         std::cerr << __FILE__ << " " << __LINE__ << "unable to execute snprintf" << std::endl;
-        _fileName = "TestFile.pcap";
+        _fileName = "TestFile" + _tag + ".pcap";
         return;
     }
 
-    _fileName = std::string(time_part) + ".pcap";
+    _fileName = std::string(time_part) + _tag + ".pcap";
+}
+
+bool PcapConsumer::OpenFile()
+{
+    if (_fileDescriptor >= 0) {
+        return true;
+    }
+
+    _fileDescriptor = open(_fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666);
+    if (_fileDescriptor < 0) {
+        std::cerr << __FILE__ << " " << __LINE__ << " output file is not able to be opened. Filename : " << _fileName << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool PcapConsumer::FlushBlock()
+{
+    iovec block = { _block.data(), _blockUsed };
+    _blockUsed = 0;
+
+    if (!OpenFile()) {
+        return false;
+    }
+
+    if (!WriteVectors(_fileDescriptor, &block, 1)) {
+        std::cerr << __FILE__ << " " << __LINE__ << " unable to write pcap file : " << _fileName << " " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    return true;
 }
 
 bool PcapConsumer::Consume(const unsigned char* data_ptr, unsigned short int data_size)
+{
+    std::memcpy(Acquire(data_size), data_ptr, data_size);
+    return Commit(data_size);
+}
+
+unsigned char* PcapConsumer::Acquire(unsigned short int data_size)
+{
+    // block is larger than any record, so that after flushing a record always fits
+    if (_blockUsed + sizeof(PcapPacHdrType) + data_size > _block.size()) {
+        FlushBlock();
+    }
+
+    return _block.data() + _blockUsed + sizeof(PcapPacHdrType);
+}
+
+bool PcapConsumer::Commit(unsigned short int data_size)
 {
     PcapPacHdrType pcap_packet_header;
 
-    GetCurrentTimeInTv(pcap_packet_header.ts_sec, pcap_packet_header.ts_usec);
+    _clock->GetTime(pcap_packet_header.ts_sec, pcap_packet_header.ts_usec);
     pcap_packet_header.incl_len = data_size;
     pcap_packet_header.orig_len = data_size;
 
-    int pcap_packet_header_size = sizeof(PcapPacHdrType);
+    std::memcpy(_block.data() + _blockUsed, &pcap_packet_header, sizeof(pcap_packet_header));
+    _blockUsed += sizeof(pcap_packet_header) + data_size;
+    _fileSize += sizeof(pcap_packet_header) + data_size;
 
-    if (!(_fileStream.is_open())) {
-        _fileStream.open(_fileName.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::app);
+    return true;
+}
 
-        if (!(_fileStream.is_open())) {
-            std::cerr << __FILE__ << " " << __LINE__ << " output stream is not able to be added. Filename : " << _fileName << std::endl;
-            return false;
-        }
+bool PcapConsumer::ConsumeBatch(const PacketDescriptor* packets, std::size_t numberOfPackets)
+{
+    // packets consumed one by one before batch are written first
+    if (!FlushBlock()) {
+        return false;
     }
 
-    _fileStream.write((char*)(&pcap_packet_header), pcap_packet_header_size);
-    _fileSize += pcap_packet_header_size;
+    _batchHeaders.resize(numberOfPackets);
+    _batchVectors.resize(2 * numberOfPackets);
 
-    _fileStream.write((const char*)data_ptr, data_size);
-    _fileSize += data_size;
+    for (std::size_t k = 0; k < numberOfPackets; ++k) {
+        const PacketDescriptor& packet = packets[k];
+        PcapPacHdrType& pcap_packet_header = _batchHeaders[k];
+        pcap_packet_header.ts_sec = (unsigned int)(packet.timestamp / 1000000);
+        pcap_packet_header.ts_usec = (unsigned int)(packet.timestamp % 1000000);
+        pcap_packet_header.incl_len = packet.size;
+        pcap_packet_header.orig_len = packet.size;
 
-    _fileStream.flush();
+        _batchVectors[2 * k] = { &pcap_packet_header, sizeof(pcap_packet_header) };
+        _batchVectors[2 * k + 1] = { const_cast<unsigned char*>(packet.data), packet.size };
+        _fileSize += sizeof(pcap_packet_header) + packet.size;
+    }
+
+    if (!WriteVectors(_fileDescriptor, _batchVectors.data(), _batchVectors.size())) {
+        std::cerr << __FILE__ << " " << __LINE__ << " unable to write pcap file : " << _fileName << " " << strerror(errno) << std::endl;
+        return false;
+    }
 
     return true;
 }
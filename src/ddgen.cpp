@@ -1,9 +1,16 @@
+#include "AdmissionController.h"
+#include "CallEngine.h"
 #include "CallLoggerFactory.h"
 #include "CallStorageFactory.h"
+#include "ClipLibrary.h"
 #include "ConsumerFactory.h"
+#include "KernelRegistry.h"
+#include "PayloadCache.h"
 #include "SignalHandler.h"
+#include "TickScheduler.h"
 
 #include "callleg.h"
+#include "g722encoder.h"
 #include "programoptions.h"
 #include "webinterface.h"
 
@@ -15,23 +22,8 @@
 #include <sys/time.h>
 #include <vector>
 
-bool SleepSystemUsec(unsigned long long int sleep_usec)
-{
-    timespec sleep_timespec = { ((time_t)sleep_usec / 1000000), ((long int)((sleep_usec % 1000000) * 1000)) };
-    timespec unused_timespec;
-
-    for (;;) {
-        if (0 == nanosleep(&sleep_timespec, &unused_timespec)) {
-            return true;
-        } else if (EINTR == errno) {
-            std::cerr << "Interrupted sleep with sleep value: " << sleep_usec << " at: bool SleepSystemUsec()" << std::endl;
-            sleep_timespec = unused_timespec;
-        } else {
-            std::cerr << "Errror in nanosleep(), error: " << errno << " sleep value: " << sleep_usec << " at: bool SleepSystemUsec()" << std::endl;
-            return false;
-        }
-    }
-}
+#define PROGRESS_PERIOD 10      /**< period of progress report in seconds */
+#define ADMISSION_BURST_TICKS 2 /**< admission token bucket holds calls of 2 ticks */
 
 int main(int argc, char* argv[])
 {
@@ -39,22 +31,108 @@ int main(int argc, char* argv[])
 
     ddgen::ProgramOptions program_options(argc, argv);
 
+    // kernels are selected before any leg is formed, workers only read selected set
+    const ddgen::KernelIsa best_kernel_isa = ddgen::KernelRegistry::GetBestSupportedIsa();
+    if (!program_options.kernelIsa.empty()) {
+        ddgen::KernelIsa kernel_isa;
+        if (!ddgen::KernelRegistry::Parse(program_options.kernelIsa, kernel_isa)) {
+            std::cout << "unknown kernel isa : " << program_options.kernelIsa << std::endl;
+            ddgen::ProgramOptions::DisplayUsage();
+            return -1;
+        }
+        if (!ddgen::KernelRegistry::Select(kernel_isa)) {
+            std::cout << "kernel isa " << program_options.kernelIsa << " is not supported by cpu, best supported is "
+                      << ddgen::KernelRegistry::GetName(best_kernel_isa) << std::endl;
+            return -1;
+        }
+    }
+    std::cout << "kernels: " << ddgen::KernelRegistry::GetName(ddgen::KernelRegistry::Get().isa) << " (best supported "
+              << ddgen::KernelRegistry::GetName(best_kernel_isa) << ")" << std::endl;
+
     auto callLogger = ddgen::CallLoggerFactory::CreateCallLogger({ program_options.useDb, program_options.dbPath, program_options.stackName });
 
     ddgen::G711aEncoderFactory g711a_encoder_factory;
-    ddgen::SingleToneGeneratorFactory single_tone_generator_factory;
+    ddgen::G711uEncoderFactory g711u_encoder_factory;
+    ddgen::G722EncoderFactory g722_encoder_factory;
+    ddgen::EncoderFactory* encoder_factory_ptr = &g711a_encoder_factory;
+    if (ddgen::Codec::G711u == program_options.codec) {
+        encoder_factory_ptr = &g711u_encoder_factory;
+    } else if (ddgen::Codec::G722 == program_options.codec) {
+        encoder_factory_ptr = &g722_encoder_factory;
+    }
+    ddgen::SingleToneGeneratorFactory single_tone_generator_factory(program_options.shouldCachePayload);
+
+    // tones are periodic when payloads are cached, so legs share encoded payload cycles, that only memoryless encoders can give
+    const bool is_encoder_memoryless = encoder_factory_ptr->CreateEncoder()->IsMemoryless();
+    ddgen::PayloadCache payload_cache;
+    ddgen::PayloadCache* payload_cache_ptr = (program_options.shouldCachePayload && is_encoder_memoryless) ? &payload_cache : nullptr;
+
+    // legs that play clips have no encoder or generator
+    ddgen::ClipLibrary clip_library;
+    ddgen::ClipLibrary* clip_library_ptr = nullptr;
+    if (!program_options.clipDirectory.empty()) {
+        if (!clip_library.Load(program_options.clipDirectory)) {
+            std::cout << "clips can not be loaded from " << program_options.clipDirectory << std::endl;
+            return -1;
+        }
+        clip_library_ptr = &clip_library;
+        payload_cache_ptr = nullptr;
+        std::cout << "clip library: " << clip_library.GetNumberOfClips() << " clips, " << clip_library.GetMappedSize() / 1024 << " KB mapped"
+                  << std::endl;
+    } else if (payload_cache_ptr) {
+        std::cout << "tones: periodic, G711 payloads are cached (--no-payload-cache for continuous random tones)" << std::endl;
+    } else if (program_options.shouldCachePayload) {
+        std::cout << "tones: periodic, payloads are not cached since encoder keeps state (--no-payload-cache for continuous random tones)"
+                  << std::endl;
+    } else {
+        std::cout << "tones: continuous random" << std::endl;
+    }
+
+    if (program_options.isOffline && (ddgen::Output::Pcap != program_options.output)) {
+        std::cout << "--offline is only meaningful for pcap output, running in real time" << std::endl;
+        program_options.isOffline = false;
+    }
+
+    if (program_options.isOffline && program_options.shouldSteal) {
+        std::cout << "--steal needs wall clock, offline mode uses a shard per thread" << std::endl;
+    }
+
+    auto callFactory = ddgen::CallFactoryFactory::CreateCallFactory(
+        { program_options.traffic, program_options.drlinkIpPortVector, program_options.startIp, program_options.numberOfCalls });
 
-    auto callFactory =
-        ddgen::CallFactoryFactory::CreateCallFactory({ program_options.traffic, program_options.drlinkIpPortVector, program_options.startIp });
-    auto consumer = ddgen::ConsumerFactory::CreateConsumer(
-        { program_options.output, program_options.dstIpPortVector, program_options.useS3, program_options.stackName });
+    // encoders and generators of all legs are constructed up front, calls then take them from pools
+    const unsigned int number_of_call_legs = callFactory->GetNumberOfCallLegs() * program_options.numberOfCalls;
+    if (!clip_library_ptr) {
+        encoder_factory_ptr->Reserve(number_of_call_legs);
+        single_tone_generator_factory.Reserve(number_of_call_legs);
+    }
 
-    std::vector<std::unique_ptr<ddgen::Call>> call_ptr_vector;
+    std::cout << "memory per call leg: " << sizeof(ddgen::CallLeg) << " bytes, "
+              << (unsigned long long int)sizeof(ddgen::CallLeg) * callFactory->GetNumberOfCallLegs() * program_options.numberOfCalls / 1024
+              << " KB reserved for call legs" << std::endl;
+
+    // lookahead rings are sized for packets of clips or of selected codec
+    const unsigned int packet_size =
+        ddgen::PacketTemplate::headers_size + (clip_library_ptr ? CLIP_PACKET_SIZE : encoder_factory_ptr->CreateEncoder()->GetPayloadSize());
+    ddgen::CallEngine engine(
+        { program_options.numberOfThreads,
+          { program_options.output, program_options.dstIpPortVector, program_options.useS3, program_options.stackName },
+          { program_options.numberOfCalls,
+            program_options.shouldPace,
+            program_options.overloadPolicy,
+            program_options.maxBurst,
+            program_options.lookahead },
+          program_options.isOffline,
+          program_options.shouldSteal,
+          program_options.shouldBatch,
+          callFactory->GetNumberOfCallLegs(),
+          packet_size });
 
     const auto simulationDuration = program_options.simulationDuration * 1000;
 
     const auto start_time = std::chrono::steady_clock::now();
-    auto last_time = start_time;
+    unsigned long long int virtual_time = 0;
+    long long int last_progress_time_in_ms = 0;
 
     // form a seed
     unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
@@ -68,41 +146,76 @@ int main(int argc, char* argv[])
 
     ddgen::WebInterface web_interface(program_options.shouldUseSecureWebInterface);
 
-    while (true) {
-        if (program_options.shouldStart && (call_ptr_vector.size() < program_options.numberOfCalls)) {
-            unsigned short int call_duration = usint_distribution(generator);
+    ddgen::TickScheduler scheduler(TICK_DURATION * 1000);
+    ddgen::AdmissionController admission_controller(program_options.callsPerSecond,
+                                                    program_options.callsPerSecond * TICK_DURATION * ADMISSION_BURST_TICKS / 1000);
+    unsigned long long int last_progress_admitted_calls = 0;
 
-            std::unique_ptr<ddgen::Call> call =
-                callFactory->CreateCall({ call_duration, callLogger, &g711a_encoder_factory, &single_tone_generator_factory, consumer });
+    engine.Start();
+    scheduler.Start();
 
-            call_ptr_vector.push_back(std::move(call));
-            std::cout << " a call is created with duration " << call_duration << std::endl;
-        }
+    long long int ellapsed_time_in_ms = 0;
 
-        const auto current_time = std::chrono::steady_clock::now();
-        const auto ellapsed_time = std::chrono::duration_cast<std::chrono::microseconds>(current_time - last_time).count();
+    while (true) {
+        const unsigned int number_of_calls = engine.GetNumberOfCalls();
+        if (program_options.shouldStart && (number_of_calls < program_options.numberOfCalls)) {
+            const unsigned int admitted_calls =
+                admission_controller.Acquire(ellapsed_time_in_ms * 1000, program_options.numberOfCalls - number_of_calls);
+
+            for (unsigned int i = 0; i < admitted_calls; ++i) {
+                unsigned short int call_duration = usint_distribution(generator);
+
+                auto& shard = engine.SelectShard();
+                std::unique_ptr<ddgen::Call> call = callFactory->CreateCall({ call_duration,
+                                                                              callLogger,
+                                                                              encoder_factory_ptr,
+                                                                              &single_tone_generator_factory,
+                                                                              shard.GetConsumer(),
+                                                                              payload_cache_ptr,
+                                                                              clip_library_ptr });
+
+                shard.Admit(std::move(call));
+                std::cout << " a call is created with duration " << call_duration << std::endl;
+            }
+        }
 
-        if (ellapsed_time > 40000) {
-            std::clog << __FILE__ << " " << __LINE__ << "... too much lag: " << ellapsed_time / 1000 << " ms " << std::endl;
+        if (program_options.isOffline) {
+            virtual_time += TICK_DURATION * 1000;
+            engine.AdvanceTo(virtual_time);
+        } else {
+            scheduler.WaitNextTick();
         }
 
-        if (ellapsed_time > 20000) {
-            for (std::vector<std::unique_ptr<ddgen::Call>>::iterator it = call_ptr_vector.begin(); it != call_ptr_vector.end(); ++it) {
-                const bool step_result = (*it)->Step(20);
-                if (false == step_result) {
-                    std::clog << "a calltimed out " << std::endl;
-                    it = call_ptr_vector.erase(it);
-                    --it;
-                }
+        const auto current_time = std::chrono::steady_clock::now();
+        ellapsed_time_in_ms =
+            program_options.isOffline ? (long long int)(virtual_time / 1000)
+                                      : std::chrono::duration_cast<std::chrono::milliseconds>(current_time - start_time).count();
+
+        if ((ellapsed_time_in_ms - last_progress_time_in_ms) >= PROGRESS_PERIOD * 1000) {
+            const auto progress = engine.GetProgress();
+            std::cout << "progress: " << progress.activeCalls << " active calls, " << progress.completedCalls << " completed calls, "
+                      << progress.generatedPackets << " packets, " << progress.missedDeadlines << " missed deadlines, " << progress.driftUsec
+                      << " usec drift" << std::endl;
+            std::cout << "overload: " << progress.burstedPackets << " bursted, " << progress.deferredPackets << " deferred, "
+                      << progress.droppedPackets << " dropped packets, " << progress.stretchUsec << " usec stretch, " << progress.stolenTasks
+                      << " stolen tasks" << std::endl;
+            if (payload_cache_ptr) {
+                std::cout << "payload cache: " << payload_cache.GetNumberOfCycles() << " cycles" << std::endl;
+            }
+            if (program_options.lookahead && !program_options.isOffline) {
+                std::cout << "lookahead: " << progress.transmittedPackets << " transmitted, " << progress.overflowPackets
+                          << " overflowed packets" << std::endl;
             }
 
-            last_time = current_time;
-        } else {
-            const auto sleep_time = 20000 - ellapsed_time;
-            SleepSystemUsec(sleep_time);
+            const unsigned long long int admitted_calls = admission_controller.GetAdmittedCalls();
+            std::cout << "admission: requested " << admission_controller.GetCallsPerSecond() << " cps, achieved "
+                      << (admitted_calls - last_progress_admitted_calls) * 1000.0 / (ellapsed_time_in_ms - last_progress_time_in_ms) << " cps"
+                      << std::endl;
+
+            last_progress_admitted_calls = admitted_calls;
+            last_progress_time_in_ms = ellapsed_time_in_ms;
         }
 
-        const auto ellapsed_time_in_ms = std::chrono::duration_cast<std::chrono::milliseconds>(current_time - start_time).count();
         if (ellapsed_time_in_ms > simulationDuration) {
             std::cout << "Simulation time " << program_options.simulationDuration << " is over" << std::endl;
             break;
@@ -114,5 +227,7 @@ int main(int argc, char* argv[])
         }
     }
 
+    engine.Stop();
+
     return 0;
 }
@@ -4,6 +4,22 @@
  * More information about catch may be seen at their site https://github.com/philsquared/Catch
  */
 
+#include "AdmissionController.h"
+#include "BatchConsumer.h"
+#include "ClipLibrary.h"
+#include "EncodeBatcher.h"
+#include "KernelRegistry.h"
+#include "ObjectPool.h"
+#include "PacketRing.h"
+#include "PacketSchedule.h"
+#include "PacketTemplate.h"
+#include "PayloadCache.h"
+#include "SlabAllocator.h"
+#include "TimingWheel.h"
+#include "Transmitter.h"
+#include "WorkStealingPool.h"
+#include "callleg.h"
+#include "g722encoder.h"
 #include "jsontype.h"
 #include "rawsocket.h"
 #include "test.h"
@@ -11,8 +27,14 @@
 #define CATCH_CONFIG_MAIN // provides creation of executable, should be above catch.hpp
 #include "catch.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <unistd.h>
+#include <vector>
 
 TEST_CASE("Rtp Header Tests", "[RtpHeaderType]")
 {
@@ -100,6 +122,426 @@ TEST_CASE("Udp Header Tests", "[UdpHeaderType]")
     }
 }
 
+namespace {
+/**
+ * @brief Word by word reference of ones complement summation, as in RFC 1071
+ */
+unsigned short int ReferenceSummation(const unsigned char* data_ptr, unsigned int data_size)
+{
+    unsigned long long int sum = 0;
+    for (unsigned int i = 0; i < data_size; i += 2) {
+        sum += (data_ptr[i] << 8) + ((i + 1 < data_size) ? data_ptr[i + 1] : 0);
+    }
+    while (sum >> 16) {
+        sum = (sum >> 16) + (sum & 0xffff);
+    }
+    return (unsigned short int)sum;
+}
+
+/**
+ * @brief Kernel sets of all levels that cpu supports, scalar first
+ */
+std::vector<const ddgen::Kernels*> GetSupportedKernels()
+{
+    std::vector<const ddgen::Kernels*> kernel_sets;
+    for (auto isa : { ddgen::KernelIsa::Scalar, ddgen::KernelIsa::Sse42, ddgen::KernelIsa::Avx2, ddgen::KernelIsa::Avx512 }) {
+        if (const ddgen::Kernels* kernels = ddgen::KernelRegistry::GetKernels(isa)) {
+            kernel_sets.push_back(kernels);
+        }
+    }
+    return kernel_sets;
+}
+} // namespace
+
+TEST_CASE("Ones Complement Summation Tests", "[OnesComplementShortSummation]")
+{
+    // all ones data makes every fold carry
+    std::vector<unsigned char> data(65535 + 64);
+    unsigned int seed = 12345;
+    for (auto& byte : data) {
+        seed = seed * 1103515245 + 12345;
+        byte = (unsigned char)(seed >> 16);
+    }
+    std::vector<unsigned char> ones(65535 + 64, 0xff);
+    const auto kernel_sets = GetSupportedKernels();
+
+    SECTION("kernels are equal to reference over lengths and alignments")
+    {
+        unsigned int mismatches = 0;
+        for (const auto* buffer : { &data, &ones }) {
+            for (unsigned int offset = 0; offset < 33; ++offset) {
+                for (unsigned int size : { 0u, 1u, 2u, 3u, 7u, 12u, 15u, 16u, 17u, 20u, 31u, 32u, 33u, 63u, 65u, 172u, 173u, 1499u, 65535u }) {
+                    const unsigned char* data_ptr = buffer->data() + offset;
+                    const unsigned short int reference = ReferenceSummation(data_ptr, size);
+
+                    mismatches += (reference != ddgen::OnesComplementShortSummation(data_ptr, size));
+                    for (const auto* kernels : kernel_sets) {
+                        mismatches += (reference != kernels->onesComplementShortSummation(data_ptr, size));
+                    }
+                }
+            }
+        }
+        REQUIRE(0 == mismatches);
+    }
+
+    SECTION("checksums pass checks for odd lengths and alignments")
+    {
+        unsigned int failures = 0;
+        for (unsigned int offset = 0; offset < 8; ++offset) {
+            for (unsigned short int data_size : { 0, 1, 2, 3, 160, 161, 1471 }) {
+                unsigned char* ipv4_ptr = data.data() + offset;
+                unsigned char* udp_ptr = ipv4_ptr + ddgen::ipv4_header_size;
+
+                ddgen::UdpHeaderType udp_header = sample_udp_header;
+                udp_header.tot_len = ddgen::udp_header_size + data_size;
+                ddgen::Ipv4HeaderType ipv4_header = sample_ipv4_header;
+                ipv4_header.tot_len = ddgen::ipv4_header_size + udp_header.tot_len;
+
+                ddgen::PseudoIpv4HeaderType pseudo_ipv4_header;
+                pseudo_ipv4_header.src_addr = ipv4_header.src_addr;
+                pseudo_ipv4_header.dst_addr = ipv4_header.dst_addr;
+                pseudo_ipv4_header.protocol = ipv4_header.protocol;
+                pseudo_ipv4_header.data_len = udp_header.tot_len;
+
+                ipv4_header.UpdateChecksumWriteToBuffer(ipv4_ptr);
+                udp_header.UpdateChecksumWriteToBuffer(udp_ptr, udp_ptr + ddgen::udp_header_size, pseudo_ipv4_header);
+                failures += !ddgen::CheckIpv4Checksum(ipv4_ptr);
+                failures += !ddgen::CheckUdpChecksum(udp_ptr, pseudo_ipv4_header);
+
+                // a flipped bit of last character should be detected
+                udp_ptr[udp_header.tot_len - 1] ^= 0x01;
+                failures += ddgen::CheckUdpChecksum(udp_ptr, pseudo_ipv4_header);
+                udp_ptr[udp_header.tot_len - 1] ^= 0x01;
+            }
+        }
+        REQUIRE(0 == failures);
+    }
+}
+
+TEST_CASE("Packet Template Tests", "[PacketTemplate]")
+{
+    ddgen::EthHeaderType eth_header;
+    std::memset(&eth_header, 0, sizeof(eth_header));
+    eth_header.eth_type = 0x0800;
+
+    ddgen::RtpHeaderType rtp_header = sample_rtp_header;
+    ddgen::Ipv4HeaderType ipv4_header = sample_ipv4_header;
+    ddgen::UdpHeaderType udp_header = sample_udp_header;
+    const unsigned short int payload_size = 160;
+    udp_header.tot_len = ddgen::udp_header_size + ddgen::rtp_header_size + payload_size;
+    ipv4_header.tot_len = ddgen::ipv4_header_size + udp_header.tot_len;
+
+    ddgen::PseudoIpv4HeaderType pseudo_ipv4_header;
+    pseudo_ipv4_header.src_addr = ipv4_header.src_addr;
+    pseudo_ipv4_header.dst_addr = ipv4_header.dst_addr;
+    pseudo_ipv4_header.protocol = ipv4_header.protocol;
+    pseudo_ipv4_header.data_len = udp_header.tot_len;
+
+    ddgen::PacketTemplate packet_template;
+    packet_template.Build(eth_header, ipv4_header, udp_header, rtp_header);
+
+    SECTION("patched headers are equal to serialized headers")
+    {
+        unsigned char line[ddgen::PacketTemplate::headers_size + payload_size];
+        unsigned char reference[ddgen::PacketTemplate::headers_size + payload_size];
+        unsigned char* ipv4_ptr = reference + ddgen::eth_header_size;
+        unsigned char* udp_ptr = ipv4_ptr + ddgen::ipv4_header_size;
+        unsigned char* rtp_ptr = udp_ptr + ddgen::udp_header_size;
+
+        // ids and sequence numbers wrap, and jumps are as if packets are skipped
+        const unsigned short int steps[] = { 1, 1, 7, 0xfff0, 1, 300 };
+        for (unsigned int k = 0; k < sizeof(steps) / sizeof(steps[0]); ++k) {
+            for (unsigned short int i = 0; i < payload_size; ++i) {
+                line[ddgen::PacketTemplate::headers_size + i] = (unsigned char)(i * 37 + k * 11);
+            }
+            std::memcpy(reference, line, sizeof(line));
+
+            const unsigned short int payload_sum = ddgen::OnesComplementShortSummation(line + ddgen::PacketTemplate::headers_size, payload_size);
+            packet_template.Write(line, rtp_header.seq_num, rtp_header.timestamp, ipv4_header.id, payload_sum);
+
+            eth_header.WriteToBuffer(reference);
+            rtp_header.WriteToBuffer(rtp_ptr);
+            udp_header.UpdateChecksumWriteToBuffer(udp_ptr, rtp_ptr, pseudo_ipv4_header);
+            ipv4_header.UpdateChecksumWriteToBuffer(ipv4_ptr);
+
+            REQUIRE(true == ddgen::CheckIpv4Checksum(line + ddgen::eth_header_size));
+            REQUIRE(true == ddgen::CheckUdpChecksum(line + ddgen::eth_header_size + ddgen::ipv4_header_size, pseudo_ipv4_header));
+            REQUIRE(0 == std::memcmp(reference, line, sizeof(line)));
+
+            rtp_header.seq_num += steps[k];
+            rtp_header.timestamp += steps[k] * payload_size;
+            ipv4_header.id += steps[k];
+        }
+    }
+}
+
+TEST_CASE("G711 Encoder Tests", "[G711EncoderType]")
+{
+    // every 16 bit sample, in order from -32768
+    std::vector<short int> pcm(65536 + 16);
+    for (unsigned int k = 0; k < pcm.size(); ++k) {
+        pcm[k] = (short int)(k + 32768);
+    }
+    std::vector<unsigned char> encoded(pcm.size());
+
+    typedef void (*Kernel)(const short int*, unsigned char*, unsigned int);
+    std::vector<std::pair<Kernel, unsigned char (*)(short int)>> kernels;
+    for (const auto* kernel_set : GetSupportedKernels()) {
+        kernels.push_back({ kernel_set->g711aEncode, &ddgen::G711aEncoderType::EncodeSampleReference });
+        kernels.push_back({ kernel_set->g711uEncode, &ddgen::G711uEncoderType::EncodeSampleReference });
+    }
+
+    SECTION("table encoding is equal to reference for all samples")
+    {
+        unsigned int mismatches = 0;
+        for (unsigned int k = 0; k < 65536; ++k) {
+            mismatches += (ddgen::G711aEncoderType::EncodeSample(pcm[k]) != ddgen::G711aEncoderType::EncodeSampleReference(pcm[k]));
+            mismatches += (ddgen::G711uEncoderType::EncodeSample(pcm[k]) != ddgen::G711uEncoderType::EncodeSampleReference(pcm[k]));
+        }
+        REQUIRE(0 == mismatches);
+    }
+
+    SECTION("kernels are equal to reference for all samples and for lengths that leave remainders")
+    {
+        unsigned int mismatches = 0;
+        for (const auto& kernel : kernels) {
+            for (unsigned int offset : { 0u, 1u, 7u }) {
+                std::fill(encoded.begin(), encoded.end(), 0);
+                kernel.first(pcm.data() + offset, encoded.data(), 65536 + 9 - offset);
+                for (unsigned int k = 0; k < 65536 + 9 - offset; ++k) {
+                    mismatches += (encoded[k] != kernel.second(pcm[k + offset]));
+                }
+            }
+        }
+        REQUIRE(0 == mismatches);
+    }
+
+    SECTION("encoders encode a packet with selected kernel")
+    {
+        ddgen::G711aEncoderType g711a_encoder;
+        ddgen::G711uEncoderType g711u_encoder;
+        unsigned int mismatches = 0;
+        for (unsigned int k = 0; k + G711_PACKET_SIZE <= 65536; k += G711_PACKET_SIZE) {
+            REQUIRE(g711a_encoder.Encode(pcm.data() + k, encoded.data()));
+            for (unsigned int i = 0; i < G711_PACKET_SIZE; ++i) {
+                mismatches += (encoded[i] != ddgen::G711aEncoderType::EncodeSampleReference(pcm[k + i]));
+            }
+            REQUIRE(g711u_encoder.Encode(pcm.data() + k, encoded.data()));
+            for (unsigned int i = 0; i < G711_PACKET_SIZE; ++i) {
+                mismatches += (encoded[i] != ddgen::G711uEncoderType::EncodeSampleReference(pcm[k + i]));
+            }
+        }
+        REQUIRE(0 == mismatches);
+    }
+}
+
+TEST_CASE("Kernel Registry Tests", "[KernelRegistry]")
+{
+    const auto kernel_sets = GetSupportedKernels();
+
+    SECTION("scalar and best supported levels can be selected by name")
+    {
+        const ddgen::KernelIsa best_isa = ddgen::KernelRegistry::GetBestSupportedIsa();
+        REQUIRE(ddgen::KernelRegistry::IsSupported(ddgen::KernelIsa::Scalar));
+        REQUIRE(ddgen::KernelRegistry::IsSupported(best_isa));
+        REQUIRE(kernel_sets.back()->isa == best_isa);
+
+        ddgen::KernelIsa isa = ddgen::KernelIsa::Avx512;
+        REQUIRE(ddgen::KernelRegistry::Parse("scalar", isa));
+        REQUIRE(ddgen::KernelIsa::Scalar == isa);
+        REQUIRE(ddgen::KernelRegistry::Parse(ddgen::KernelRegistry::GetName(best_isa), isa));
+        REQUIRE(best_isa == isa);
+        REQUIRE_FALSE(ddgen::KernelRegistry::Parse("sse5", isa));
+
+        REQUIRE(ddgen::KernelRegistry::Select(ddgen::KernelIsa::Scalar));
+        REQUIRE(ddgen::KernelIsa::Scalar == ddgen::KernelRegistry::Get().isa);
+        REQUIRE(ddgen::KernelRegistry::Select(best_isa));
+        REQUIRE(best_isa == ddgen::KernelRegistry::Get().isa);
+    }
+
+    SECTION("qmf kernels are equal to scalar kernel when a packet is split over calls")
+    {
+        std::vector<short int> pcm(G722_PACKET_SIZE * 8);
+        unsigned int seed = 12345;
+        for (unsigned int k = 0; k < pcm.size(); ++k) {
+            seed = seed * 1103515245 + 12345;
+            // full scale square wave saturates filter, noise follows it
+            pcm[k] = (k < G722_PACKET_SIZE * 2) ? (((k / 5) & 1) ? SHRT_MAX : SHRT_MIN) : (short int)(seed >> 16);
+        }
+
+        const unsigned int number_of_pairs = pcm.size() / 2;
+        short int reference_delay_line[24] = {};
+        std::vector<short int> reference_low(number_of_pairs);
+        std::vector<short int> reference_high(number_of_pairs);
+        ddgen::G722QmfTxScalar(pcm.data(), number_of_pairs, reference_delay_line, reference_low.data(), reference_high.data());
+
+        unsigned int mismatches = 0;
+        for (const auto* kernels : kernel_sets) {
+            short int delay_line[24] = {};
+            std::vector<short int> low(number_of_pairs);
+            std::vector<short int> high(number_of_pairs);
+            for (unsigned int pair = 0, chunk = 1; pair < number_of_pairs; pair += chunk, chunk = chunk * 3 + 1) {
+                chunk = std::min(chunk, number_of_pairs - pair);
+                kernels->g722QmfTx(pcm.data() + 2 * pair, chunk, delay_line, low.data() + pair, high.data() + pair);
+            }
+            mismatches += (low != reference_low) + (high != reference_high);
+            mismatches += !std::equal(delay_line, delay_line + 24, reference_delay_line);
+        }
+        REQUIRE(0 == mismatches);
+    }
+
+    SECTION("g722 encoders give the same payloads on every level, and again after reset")
+    {
+        std::vector<short int> pcm(G722_PACKET_SIZE * 20);
+        for (unsigned int k = 0; k < pcm.size(); ++k) {
+            pcm[k] = (short int)(20000 * sin(0.05 * k + 0.0001 * k * k));
+        }
+
+        std::vector<unsigned char> reference;
+        for (const auto* kernels : kernel_sets) {
+            REQUIRE(ddgen::KernelRegistry::Select(kernels->isa));
+            ddgen::G722EncoderType encoder;
+            for (unsigned int pass = 0; pass < 2; ++pass) {
+                std::vector<unsigned char> encoded(pcm.size() / 2);
+                for (unsigned int k = 0; k < pcm.size(); k += G722_PACKET_SIZE) {
+                    REQUIRE(encoder.Encode(pcm.data() + k, encoded.data() + k / 2));
+                }
+                if (reference.empty()) {
+                    reference = encoded;
+                }
+                REQUIRE(encoded == reference);
+                encoder.Reset();
+            }
+        }
+        REQUIRE(ddgen::KernelRegistry::Select(ddgen::KernelRegistry::GetBestSupportedIsa()));
+    }
+
+    SECTION("g722 batch kernels give payloads of encoders encoded one by one, for full and partial batches")
+    {
+        // encoders take a full scale square wave, noise, a tone or silence, and start from different memories
+        const unsigned int number_of_encoders = G722_BATCH_LANES + 5;
+        const unsigned int number_of_packets = 6;
+        std::vector<std::vector<short int>> pcm(number_of_encoders, std::vector<short int>(G722_PACKET_SIZE * number_of_packets));
+        unsigned int seed = 54321;
+        for (unsigned int k = 0; k < number_of_encoders; ++k) {
+            for (unsigned int t = 0; t < pcm[k].size(); ++t) {
+                seed = seed * 1103515245 + 12345;
+                const short int samples[] = { (short int)(((t / (3 + k)) & 1) ? SHRT_MAX : SHRT_MIN), (short int)(seed >> 16),
+                                              (short int)(20000 * sin(0.01 * (k + 1) * t)), 0 };
+                pcm[k][t] = samples[k % 4];
+            }
+        }
+
+        unsigned int mismatches = 0;
+        for (const auto* kernels : kernel_sets) {
+            std::vector<ddgen::G722EncoderType> reference(number_of_encoders);
+            std::vector<ddgen::G722EncoderType> batched(number_of_encoders);
+            std::vector<unsigned char> reference_encoded(G722_PACKET_SIZE / 2);
+            std::vector<std::vector<unsigned char>> encoded(number_of_encoders, std::vector<unsigned char>(G722_PACKET_SIZE / 2));
+            for (unsigned int k = 0; k < number_of_encoders; ++k) {
+                for (unsigned int packet = 0; packet < k % 3; ++packet) {
+                    REQUIRE(reference[k].Encode(pcm[(k + 1) % number_of_encoders].data() + packet * G722_PACKET_SIZE, reference_encoded.data()));
+                    REQUIRE(batched[k].Encode(pcm[(k + 1) % number_of_encoders].data() + packet * G722_PACKET_SIZE, reference_encoded.data()));
+                }
+            }
+
+            for (unsigned int packet = 0; packet < number_of_packets; ++packet) {
+                std::vector<ddgen::G722EncoderType*> encoders;
+                std::vector<const short int*> pcm_data_ptrs;
+                std::vector<unsigned char*> encoded_data_ptrs;
+                for (unsigned int k = 0; k < number_of_encoders; ++k) {
+                    encoders.push_back(&batched[k]);
+                    pcm_data_ptrs.push_back(pcm[k].data() + packet * G722_PACKET_SIZE);
+                    encoded_data_ptrs.push_back(encoded[k].data());
+                }
+                kernels->g722EncodeBatch(encoders.data(), pcm_data_ptrs.data(), encoded_data_ptrs.data(), G722_BATCH_LANES);
+                kernels->g722EncodeBatch(encoders.data() + G722_BATCH_LANES,
+                                         pcm_data_ptrs.data() + G722_BATCH_LANES,
+                                         encoded_data_ptrs.data() + G722_BATCH_LANES,
+                                         number_of_encoders - G722_BATCH_LANES);
+
+                for (unsigned int k = 0; k < number_of_encoders; ++k) {
+                    REQUIRE(reference[k].Encode(pcm_data_ptrs[k], reference_encoded.data()));
+                    mismatches += (encoded[k] != reference_encoded);
+                }
+            }
+
+            // memories are left as encoding one by one leaves them
+            for (unsigned int k = 0; k < number_of_encoders; ++k) {
+                REQUIRE(reference[k].Encode(pcm[k].data(), reference_encoded.data()));
+                REQUIRE(batched[k].Encode(pcm[k].data(), encoded[k].data()));
+                mismatches += (encoded[k] != reference_encoded);
+            }
+        }
+        REQUIRE(0 == mismatches);
+
+        REQUIRE_FALSE(ddgen::G722EncoderType::EncodeBatch(nullptr, nullptr, nullptr, 1));
+    }
+
+    SECTION("tone kernels are equal to scalar kernel, over calls that leave partial blocks and pass renormalization")
+    {
+        for (unsigned int size : { 1u, G711_PACKET_SIZE - 3u, 1000u }) {
+            ddgen::ToneOscillator reference_oscillator;
+            ddgen::SeedToneOscillator(reference_oscillator, 0.8f, 2.1f, -3.0);
+            std::vector<short int> reference(3 * size);
+            for (unsigned int call = 0; call < 3; ++call) {
+                ddgen::GenerateToneScalar(reference.data() + call * size, size, reference_oscillator);
+            }
+
+            for (const auto* kernels : kernel_sets) {
+                // every level above scalar has a kernel of its own, so comparison is not of scalar with itself
+                REQUIRE((ddgen::KernelIsa::Scalar == kernels->isa) == (&ddgen::GenerateToneScalar == kernels->generateTone));
+
+                ddgen::ToneOscillator oscillator;
+                ddgen::SeedToneOscillator(oscillator, 0.8f, 2.1f, -3.0);
+                std::vector<short int> pcm(3 * size);
+                for (unsigned int call = 0; call < 3; ++call) {
+                    kernels->generateTone(pcm.data() + call * size, size, oscillator);
+                }
+                REQUIRE(pcm == reference);
+            }
+        }
+    }
+
+    SECTION("tones stay within a sample of sin() over an hour of packets, and over packets of any size")
+    {
+        const float amplitude = 0.8f;
+        const float frequency = 2.1f;
+        const unsigned int number_of_packets = 3600 * 8000 / G711_PACKET_SIZE;
+        ddgen::ToneOscillator oscillator;
+        ddgen::SeedToneOscillator(oscillator, amplitude, frequency, -3.0);
+        std::vector<short int> pcm(G711_PACKET_SIZE);
+        unsigned int deviations = 0;
+        for (unsigned int packet = 0; packet < number_of_packets; ++packet) {
+            ddgen::KernelRegistry::Get().generateTone(pcm.data(), pcm.size(), oscillator);
+            if ((0 == packet % 1000) || (packet + 1 == number_of_packets)) {
+                for (unsigned int k = 0; k < pcm.size(); ++k) {
+                    const long double sample_phase = -3.0L + (long double)frequency * ((long double)packet * G711_PACKET_SIZE + k);
+                    deviations += (fabsl(pcm[k] - (long double)amplitude * SHRT_MAX * sinl(sample_phase)) >= 1);
+                }
+            }
+        }
+        REQUIRE(0 == deviations);
+
+        // phase is carried over packets whose sizes leave partial blocks
+        ddgen::SingleToneGeneratorType generator(0.5f, 1.3f, 2.0f);
+        const unsigned int sizes[] = { G711_PACKET_SIZE, G711_PACKET_SIZE - 3, 5, G711_PACKET_SIZE };
+        unsigned int generated_samples = 0;
+        for (unsigned int size : sizes) {
+            REQUIRE(generator.Generate(pcm.data(), size));
+            for (unsigned int k = 0; k < size; ++k) {
+                const long double sample_phase = 2.0L + (long double)1.3f * (generated_samples + k);
+                deviations += (fabsl(pcm[k] - (long double)0.5f * SHRT_MAX * sinl(sample_phase)) >= 1);
+            }
+            generated_samples += size;
+
+            const double next_phase = remainder(2.0 + (double)1.3f * generated_samples, 2 * M_PI);
+            REQUIRE(fabs(generator.GetParameters().front().phase - next_phase) < 1e-6);
+        }
+        REQUIRE(0 == deviations);
+    }
+}
+
 TEST_CASE("Json test", "[JsonType]")
 {
     SECTION("reading from string")
@@ -175,3 +617,762 @@ TEST_CASE("Json test", "[JsonType]")
                 == message_in_json_test9.ToString());
     }
 }
+
+TEST_CASE("Timing Wheel Tests", "[TimingWheel]")
+{
+    ddgen::TimingWheel wheel;
+    std::vector<unsigned int> fired_types;
+    std::vector<unsigned long long int> fired_deadlines;
+    auto handler = [&](ddgen::TimerEvent& event, unsigned long long int deadline) {
+        fired_types.push_back(event.type);
+        fired_deadlines.push_back(deadline);
+    };
+
+    SECTION("events are fired in deadline order")
+    {
+        ddgen::TimerEvent events[3];
+        const unsigned long long int deadlines[3] = { 5000, 70, 300000 };
+        for (unsigned int i = 0; i < 3; ++i) {
+            events[i].deadline = deadlines[i];
+            events[i].type = i;
+            wheel.Schedule(events[i]);
+        }
+        REQUIRE(3 == wheel.Size());
+
+        wheel.Advance(4999, handler);
+        REQUIRE(1 == fired_types.size());
+        REQUIRE(1 == fired_types[0]);
+
+        wheel.Advance(1000000, handler);
+        REQUIRE(std::vector<unsigned int>({ 1, 0, 2 }) == fired_types);
+        REQUIRE(std::vector<unsigned long long int>({ 70, 5000, 300000 }) == fired_deadlines);
+        REQUIRE(0 == wheel.Size());
+        REQUIRE(1000000 == wheel.Now());
+    }
+
+    SECTION("periodic events are re-armed till their limit")
+    {
+        ddgen::TimerEvent event;
+        event.deadline = 0;
+        event.period = 20000;
+        event.limit = 100000;
+        wheel.Schedule(event);
+
+        wheel.Advance(1000000, handler);
+        REQUIRE(std::vector<unsigned long long int>({ 0, 20000, 40000, 60000, 80000 }) == fired_deadlines);
+        REQUIRE(false == event.IsScheduled());
+    }
+
+    SECTION("cancelled events are not fired")
+    {
+        ddgen::TimerEvent first, second;
+        first.deadline = 1 << 20;
+        second.deadline = 1 << 21;
+        second.type = 1;
+        wheel.Schedule(first);
+        wheel.Schedule(second);
+
+        wheel.Cancel(first);
+        REQUIRE(false == first.IsScheduled());
+        REQUIRE(1 == wheel.Size());
+
+        wheel.Advance(1ULL << 22, handler);
+        REQUIRE(std::vector<unsigned int>({ 1 }) == fired_types);
+    }
+
+    SECTION("far events are cascaded and fired at exact deadline")
+    {
+        ddgen::TimerEvent event;
+        event.deadline = 123456789012ULL;
+        wheel.Schedule(event);
+
+        wheel.Advance(event.deadline - 1, handler);
+        REQUIRE(fired_deadlines.empty());
+        REQUIRE(event.deadline == wheel.NextEventTime());
+
+        wheel.Advance(event.deadline, handler);
+        REQUIRE(std::vector<unsigned long long int>({ 123456789012ULL }) == fired_deadlines);
+        REQUIRE(TIMING_WHEEL_NEVER == wheel.NextEventTime());
+    }
+}
+
+TEST_CASE("Admission Controller Tests", "[AdmissionController]")
+{
+    SECTION("bucket starts full and is limited by burst")
+    {
+        ddgen::AdmissionController admission_controller(1000, 40);
+
+        REQUIRE(40 == admission_controller.Acquire(0, 100));
+        REQUIRE(0 == admission_controller.Acquire(0, 100));
+
+        // an idle period does not accumulate more than burst
+        REQUIRE(40 == admission_controller.Acquire(10000000, 100));
+    }
+
+    SECTION("calls are admitted at requested rate")
+    {
+        ddgen::AdmissionController admission_controller(1000, 40);
+        admission_controller.Acquire(0, 100);
+
+        unsigned long long int admitted_calls = 0;
+        for (unsigned long long int now = 20000; now <= 10000000; now += 20000) {
+            admitted_calls += admission_controller.Acquire(now, 100);
+        }
+        REQUIRE(10000 == admitted_calls);
+        REQUIRE(10040 == admission_controller.GetAdmittedCalls());
+    }
+
+    SECTION("fractional rates carry over between ticks")
+    {
+        ddgen::AdmissionController admission_controller(3, 2);
+        admission_controller.Acquire(0, 2);
+
+        unsigned int admitted_calls = 0;
+        for (unsigned long long int now = 20000; now <= 10000000; now += 20000) {
+            admitted_calls += admission_controller.Acquire(now, 1);
+        }
+        REQUIRE(30 == admitted_calls);
+    }
+}
+
+TEST_CASE("Slab Allocator Tests", "[SlabAllocator]")
+{
+    ddgen::SlabAllocator slab(40);
+    slab.Reserve(2);
+    REQUIRE(2 == slab.GetNumberOfSlots());
+
+    SECTION("slots are reused after deallocation")
+    {
+        void* first = slab.Allocate(40);
+        void* second = slab.Allocate(32);
+        REQUIRE(first != second);
+        REQUIRE(0 == slab.GetOverflowCount());
+
+        slab.Deallocate(first);
+        REQUIRE(first == slab.Allocate(40));
+
+        slab.Deallocate(first);
+        slab.Deallocate(second);
+    }
+
+    SECTION("exhausted slab and large requests overflow to heap")
+    {
+        void* first = slab.Allocate(40);
+        void* second = slab.Allocate(40);
+        void* third = slab.Allocate(40);
+        void* large = slab.Allocate(4000);
+        REQUIRE(2 == slab.GetOverflowCount());
+
+        slab.Deallocate(third);
+        slab.Deallocate(large);
+        slab.Deallocate(second);
+        slab.Deallocate(first);
+
+        // heap blocks should not end up in free list
+        REQUIRE(first == slab.Allocate(40));
+        REQUIRE(second == slab.Allocate(40));
+        REQUIRE(2 == slab.GetOverflowCount());
+    }
+}
+
+namespace {
+void CountTask(void* owner, void* context, unsigned int worker)
+{
+    static_cast<std::atomic<unsigned int>*>(owner)[worker]++;
+    (*static_cast<std::atomic<unsigned int>*>(context))++;
+}
+} // namespace
+
+TEST_CASE("Work Stealing Pool Tests", "[WorkStealingPool]")
+{
+    ddgen::WorkStealingPool pool(4);
+    std::atomic<unsigned int> executed_by_worker[4];
+    std::atomic<unsigned int> executed_tasks[100];
+    for (auto& counter : executed_by_worker) {
+        counter = 0;
+    }
+    for (auto& counter : executed_tasks) {
+        counter = 0;
+    }
+
+    std::vector<ddgen::WorkStealingPool::Task> tasks;
+    for (auto& counter : executed_tasks) {
+        tasks.push_back({ &CountTask, executed_by_worker, &counter });
+    }
+
+    // every task of every batch is executed exactly once
+    for (unsigned int batch = 0; batch < 50; ++batch) {
+        pool.Run(tasks);
+    }
+
+    unsigned int total_tasks = 0;
+    for (auto& counter : executed_by_worker) {
+        total_tasks += counter;
+    }
+    REQUIRE(5000 == total_tasks);
+
+    bool all_executed = true;
+    for (auto& counter : executed_tasks) {
+        all_executed = all_executed && (50 == counter);
+    }
+    REQUIRE(all_executed);
+}
+
+TEST_CASE("Packet Ring Tests", "[PacketRing]")
+{
+    ddgen::PacketRing ring(256);
+    unsigned char packet[100];
+    for (unsigned int i = 0; i < sizeof(packet); ++i) {
+        packet[i] = (unsigned char)i;
+    }
+
+    REQUIRE(nullptr == ring.Front());
+
+    SECTION("packets are read in order with their due time and fill the ring")
+    {
+        REQUIRE(ring.Push(10, packet, 100));
+        REQUIRE(ring.Push(20, packet, 50));
+        REQUIRE_FALSE(ring.Push(30, packet, 100));
+
+        const ddgen::PacketRing::Record* record = ring.Front();
+        REQUIRE(nullptr != record);
+        REQUIRE(10 == record->dueTime);
+        REQUIRE(100 == record->size);
+        REQUIRE(0 == std::memcmp(packet, record->GetData(), 100));
+        ring.Pop();
+
+        REQUIRE(20 == ring.Front()->dueTime);
+        ring.Pop();
+        REQUIRE(nullptr == ring.Front());
+    }
+
+    SECTION("records do not split at end of buffer")
+    {
+        for (unsigned long long int due_time = 0; due_time < 20; ++due_time) {
+            REQUIRE(ring.Push(due_time, packet + due_time, 90));
+
+            const ddgen::PacketRing::Record* record = ring.Front();
+            REQUIRE(nullptr != record);
+            REQUIRE(due_time == record->dueTime);
+            REQUIRE(0 == std::memcmp(packet + due_time, record->GetData(), 90));
+            ring.Pop();
+        }
+        REQUIRE(nullptr == ring.Front());
+    }
+
+    SECTION("packets written in place are published at commit with committed size")
+    {
+        for (unsigned long long int due_time = 0; due_time < 20; ++due_time) {
+            unsigned char* data = ring.Acquire(due_time, 100);
+            REQUIRE(nullptr != data);
+            std::memcpy(data, packet + due_time, 60);
+            REQUIRE(nullptr == ring.Front());
+            ring.Commit(60);
+
+            const ddgen::PacketRing::Record* record = ring.Front();
+            REQUIRE(nullptr != record);
+            REQUIRE(due_time == record->dueTime);
+            REQUIRE(60 == record->size);
+            REQUIRE(0 == std::memcmp(packet + due_time, record->GetData(), 60));
+            ring.Pop();
+        }
+
+        REQUIRE(ring.Push(10, packet, 100));
+        REQUIRE(nullptr == ring.Acquire(20, 100));
+    }
+}
+
+namespace {
+struct PooledObject
+{
+    unsigned int uses = 0;
+
+    void Reset()
+    {
+        uses = 0;
+    }
+};
+} // namespace
+
+TEST_CASE("Object Pool Tests", "[ObjectPool]")
+{
+    unsigned int created_objects = 0;
+    ddgen::ObjectPool<PooledObject> pool([&created_objects]() {
+        created_objects++;
+        return new PooledObject();
+    });
+    pool.Reserve(2);
+    REQUIRE(2 == created_objects);
+
+    PooledObject* first = nullptr;
+    {
+        auto handle = pool.Acquire();
+        first = handle.get();
+        handle->uses = 5;
+    }
+
+    // released object is reset and reused, reserved objects are used before creating new ones
+    auto first_handle = pool.Acquire();
+    REQUIRE(first == first_handle.get());
+    REQUIRE(0 == first_handle->uses);
+
+    auto second_handle = pool.Acquire();
+    auto third_handle = pool.Acquire();
+    REQUIRE(first != second_handle.get());
+    REQUIRE(3 == created_objects);
+    REQUIRE(3 == pool.GetNumberOfObjects());
+}
+
+TEST_CASE("Packet Schedule Tests", "[PacketSchedule]")
+{
+    ddgen::G711aEncoderFactory encoder_factory;
+    ddgen::ZeroGeneratorFactory generator_factory;
+    std::vector<std::unique_ptr<ddgen::CallLeg>> call_legs;
+    for (unsigned int i = 0; i < 3; ++i) {
+        call_legs.push_back(std::make_unique<ddgen::CallLeg>(1, 1, 2, 2, 0, 0, 0, 0, &encoder_factory, &generator_factory, nullptr));
+    }
+
+    ddgen::PacketSchedule schedule;
+    schedule.Add(*call_legs[0], 30, 20, 100);
+    schedule.Add(*call_legs[1], 10, 20, 100);
+    schedule.Add(*call_legs[2], 0, 20, 50);
+
+    std::vector<std::pair<ddgen::CallLeg*, unsigned long long int>> packets;
+    auto handler = [&packets](ddgen::CallLeg& call_leg, unsigned long long int deadline) { packets.push_back({ &call_leg, deadline }); };
+
+    SECTION("due packets are handed in deadline order, once per missed deadline")
+    {
+        schedule.Advance(40, true, handler);
+        REQUIRE(6 == packets.size());
+        REQUIRE(call_legs[2].get() == packets[0].first);
+        REQUIRE(0 == packets[0].second);
+        REQUIRE(10 == packets[1].second);
+        REQUIRE(20 == packets[2].second);
+        REQUIRE(call_legs[0].get() == packets[3].first);
+        REQUIRE(30 == packets[3].second);
+        REQUIRE(call_legs[1].get() == packets[4].first);
+        REQUIRE(30 == packets[4].second);
+        REQUIRE(40 == packets[5].second);
+
+        // no packet at or after limit
+        packets.clear();
+        schedule.Advance(200, true, handler);
+        REQUIRE(6 == packets.size());
+    }
+
+    SECTION("removed legs are not due, moved leg keeps its deadlines")
+    {
+        schedule.Remove(*call_legs[0]);
+        REQUIRE(2 == schedule.Size());
+        REQUIRE(0 == call_legs[2]->GetPacketSlot());
+
+        schedule.Advance(10, false, handler);
+        REQUIRE(2 == packets.size());
+        for (const auto& packet : packets) {
+            REQUIRE(call_legs[0].get() != packet.first);
+        }
+    }
+}
+
+namespace {
+/**
+ * @brief Consumer that keeps copies of packets
+ */
+class CaptureConsumer : public ddgen::IConsumer
+{
+public:
+    bool Consume(const unsigned char* data_ptr, unsigned short int data_size) override
+    {
+        packets.emplace_back(data_ptr, data_ptr + data_size);
+        return true;
+    }
+
+    bool ConsumeBatch(const ddgen::PacketDescriptor* descriptors, std::size_t numberOfPackets) override
+    {
+        batches.push_back(numberOfPackets);
+        for (std::size_t k = 0; k < numberOfPackets; ++k) {
+            timestamps.push_back(descriptors[k].timestamp);
+        }
+        return ddgen::IConsumer::ConsumeBatch(descriptors, numberOfPackets);
+    }
+
+    std::vector<std::vector<unsigned char>> packets;
+    std::vector<std::size_t> batches;
+    std::vector<unsigned long long int> timestamps;
+};
+
+/**
+ * @brief Consumer that hands out memory filled with junk, as a reused buffer may be, and keeps committed packets
+ */
+class NoisyConsumer : public ddgen::IConsumer
+{
+public:
+    unsigned char* Acquire(unsigned short int data_size) override
+    {
+        buffer.assign(data_size + 1024, 0xA5);
+        return buffer.data();
+    }
+
+    bool Commit(unsigned short int data_size) override
+    {
+        packets.emplace_back(buffer.data(), buffer.data() + data_size);
+        return true;
+    }
+
+    bool Consume(const unsigned char* data_ptr, unsigned short int data_size) override
+    {
+        packets.emplace_back(data_ptr, data_ptr + data_size);
+        return true;
+    }
+
+    std::vector<unsigned char> buffer;
+    std::vector<std::vector<unsigned char>> packets;
+};
+} // namespace
+
+TEST_CASE("Payload Cache Tests", "[PayloadCache]")
+{
+    ddgen::PayloadCache payload_cache;
+    ddgen::G711aEncoderType g711a_encoder;
+
+    SECTION("cached payloads are equal to generated payloads")
+    {
+        ddgen::SingleToneGeneratorType generator(true);
+        const ddgen::PayloadCycle* cycle = payload_cache.GetCycle(g711a_encoder, generator);
+        REQUIRE(nullptr != cycle);
+        REQUIRE((TONE_CYCLE_SAMPLES / G711_PACKET_SIZE) == cycle->numberOfPackets);
+
+        unsigned int packet = cycle->FindPacket(generator.GetCycleIndex());
+        REQUIRE(packet < cycle->numberOfPackets);
+
+        unsigned int mismatches = 0;
+        unsigned char payload[G711_PACKET_SIZE];
+        for (unsigned int k = 0; k < 2 * cycle->numberOfPackets + 1; ++k) {
+            for (auto& encoded : payload) {
+                encoded = ddgen::G711aEncoderType::EncodeSample(generator.NextSample());
+            }
+            mismatches += (0 != std::memcmp(payload, cycle->GetPayload(packet), G711_PACKET_SIZE));
+            mismatches += (ddgen::OnesComplementShortSummation(payload, G711_PACKET_SIZE) != cycle->sums[packet]);
+            packet = (packet + 1) % cycle->numberOfPackets;
+        }
+        REQUIRE(0 == mismatches);
+
+        // same codec and tone share cycle
+        REQUIRE(cycle == payload_cache.GetCycle(g711a_encoder, generator));
+        REQUIRE(1 == payload_cache.GetNumberOfCycles());
+    }
+
+    SECTION("stateful encoders and continuous tones are not cached")
+    {
+        ddgen::G722EncoderType g722_encoder;
+        ddgen::SingleToneGeneratorType periodic_generator(true);
+        ddgen::SingleToneGeneratorType continuous_generator(false);
+
+        REQUIRE(nullptr == payload_cache.GetCycle(g722_encoder, periodic_generator));
+        REQUIRE(nullptr == payload_cache.GetCycle(g711a_encoder, continuous_generator));
+        REQUIRE(0 == payload_cache.GetNumberOfCycles());
+    }
+
+    SECTION("legs send cached payloads with valid checksums")
+    {
+        ddgen::G711aEncoderFactory encoder_factory;
+        ddgen::SingleToneGeneratorFactory generator_factory(true);
+        auto consumer = std::make_shared<CaptureConsumer>();
+        ddgen::CallLeg call_leg(0x0a000001, 1000, 0x0a000002, 2000, 7, 1234, 5678, 9, &encoder_factory, &generator_factory, consumer, &payload_cache);
+        REQUIRE(1 == payload_cache.GetNumberOfCycles());
+
+        ddgen::PseudoIpv4HeaderType pseudo_ipv4_header;
+        pseudo_ipv4_header.src_addr = 0x0a000001;
+        pseudo_ipv4_header.dst_addr = 0x0a000002;
+        pseudo_ipv4_header.protocol = 17;
+        pseudo_ipv4_header.data_len = ddgen::udp_header_size + ddgen::rtp_header_size + G711_PACKET_SIZE;
+
+        const unsigned int period = TONE_CYCLE_SAMPLES / G711_PACKET_SIZE;
+        for (unsigned int k = 0; k < 3 * period; ++k) {
+            REQUIRE(call_leg.SendPacket());
+        }
+
+        unsigned int failures = 0;
+        for (unsigned int k = 0; k < consumer->packets.size(); ++k) {
+            const auto& packet = consumer->packets[k];
+            failures += !ddgen::CheckIpv4Checksum(packet.data() + ddgen::eth_header_size);
+            failures += !ddgen::CheckUdpChecksum(packet.data() + ddgen::eth_header_size + ddgen::ipv4_header_size, pseudo_ipv4_header);
+            if (k >= period) {
+                const auto& earlier = consumer->packets[k - period];
+                const unsigned int headers_size = ddgen::PacketTemplate::headers_size;
+                failures += !std::equal(packet.begin() + headers_size, packet.end(), earlier.begin() + headers_size);
+            }
+        }
+        REQUIRE(0 == failures);
+    }
+}
+
+TEST_CASE("Clip Library Tests", "[ClipLibrary]")
+{
+    char directory[] = "/tmp/ddgen_clips_XXXXXX";
+    REQUIRE(nullptr != mkdtemp(directory));
+
+    // two and a half packets of a law clip, a clip shorter than a packet and a file that is not a clip
+    std::vector<unsigned char> clip_data(2 * CLIP_PACKET_SIZE + CLIP_PACKET_SIZE / 2);
+    for (unsigned int i = 0; i < clip_data.size(); ++i) {
+        clip_data[i] = (unsigned char)(i * 13 + 5);
+    }
+    const std::string clip_path = std::string(directory) + "/speech.pcma";
+    const std::string short_path = std::string(directory) + "/short.g722";
+    const std::string other_path = std::string(directory) + "/readme.txt";
+    std::ofstream(clip_path, std::ios::binary).write(reinterpret_cast<const char*>(clip_data.data()), clip_data.size());
+    std::ofstream(short_path, std::ios::binary).write(reinterpret_cast<const char*>(clip_data.data()), CLIP_PACKET_SIZE - 1);
+    std::ofstream(other_path) << "not a clip";
+
+    {
+        ddgen::ClipLibrary clip_library;
+        REQUIRE(clip_library.Load(directory));
+        REQUIRE(1 == clip_library.GetNumberOfClips());
+
+        const ddgen::Clip* clip = clip_library.SelectClip();
+        REQUIRE(G711a_RTP_PAYLOAD_TYPE == clip->payloadType);
+        REQUIRE(2 == clip->numberOfPackets);
+        REQUIRE(ddgen::OnesComplementShortSummation(clip_data.data() + CLIP_PACKET_SIZE, CLIP_PACKET_SIZE) == clip->sums[1]);
+
+        SECTION("legs play clip from their start packet with valid checksums")
+        {
+            auto consumer = std::make_shared<CaptureConsumer>();
+            const unsigned int ssrc = 5679;
+            ddgen::CallLeg call_leg(0x0a000001, 1000, 0x0a000002, 2000, 7, 1234, ssrc, 9, nullptr, nullptr, consumer, nullptr, &clip_library);
+            REQUIRE(1000 * PACKET_DURATION == call_leg.GetPacketInterval());
+
+            ddgen::PseudoIpv4HeaderType pseudo_ipv4_header;
+            pseudo_ipv4_header.src_addr = 0x0a000001;
+            pseudo_ipv4_header.dst_addr = 0x0a000002;
+            pseudo_ipv4_header.protocol = 17;
+            pseudo_ipv4_header.data_len = ddgen::udp_header_size + ddgen::rtp_header_size + CLIP_PACKET_SIZE;
+
+            unsigned int failures = 0;
+            for (unsigned int k = 0; k < 5; ++k) {
+                REQUIRE(call_leg.SendPacket());
+                const auto& packet = consumer->packets.back();
+                const unsigned char* expected = clip_data.data() + ((ssrc + k) % clip->numberOfPackets) * CLIP_PACKET_SIZE;
+                failures += (CLIP_PACKET_SIZE != packet.size() - ddgen::PacketTemplate::headers_size);
+                failures += (0 != std::memcmp(expected, packet.data() + ddgen::PacketTemplate::headers_size, CLIP_PACKET_SIZE));
+                failures += !ddgen::CheckUdpChecksum(packet.data() + ddgen::eth_header_size + ddgen::ipv4_header_size, pseudo_ipv4_header);
+            }
+            REQUIRE(0 == failures);
+        }
+    }
+
+    std::remove(clip_path.c_str());
+    std::remove(short_path.c_str());
+    std::remove(other_path.c_str());
+    rmdir(directory);
+}
+
+TEST_CASE("Encode Batcher Tests", "[EncodeBatcher]")
+{
+    ddgen::G722EncoderFactory g722_encoder_factory;
+    ddgen::G711aEncoderFactory g711a_encoder_factory;
+    ddgen::SingleToneGeneratorFactory generator_factory;
+    auto consumer = std::make_shared<CaptureConsumer>();
+
+    SECTION("legs send payloads that their own encoders would give, whether they are batched or not")
+    {
+        // two full batches and a partial one, each leg has a reference encoder fed by the same tone
+        const unsigned int number_of_legs = 2 * G722_BATCH_LANES + 3;
+        std::vector<std::unique_ptr<ddgen::CallLeg>> call_legs;
+        std::vector<std::unique_ptr<ddgen::SingleToneGeneratorType>> reference_generators;
+        std::vector<ddgen::G722EncoderType> reference_encoders(number_of_legs);
+        for (unsigned int k = 0; k < number_of_legs; ++k) {
+            call_legs.emplace_back(new ddgen::CallLeg(
+                0x0a000001, 1000 + k, 0x0a000002, 2000, 7, 1234, 5678, 9, &g722_encoder_factory, &generator_factory, consumer));
+            REQUIRE(nullptr != call_legs.back()->GetBatchEncoder());
+            const auto tone = call_legs.back()->GetParameters().toneParameters.front();
+            reference_generators.emplace_back(new ddgen::SingleToneGeneratorType(tone.amplitude, tone.frequency, tone.phase));
+        }
+
+        ddgen::EncodeBatcher batcher;
+        batcher.Reserve(number_of_legs);
+        std::vector<unsigned int> packet_legs;
+        for (unsigned int advance = 0; advance < 4; ++advance) {
+            // some legs are not due and send by themselves, some send a burst of two that is added at once or due by due
+            unsigned int number_of_batched_legs = 0;
+            unsigned int number_of_bursted_legs = 0;
+            for (unsigned int k = 0; k < number_of_legs; ++k) {
+                if (0 == (k + advance) % 5) {
+                    continue;
+                }
+                number_of_batched_legs++;
+                if (0 != k % 7) {
+                    batcher.Add(*call_legs[k], 1);
+                } else if (0 == k % 2) {
+                    batcher.Add(*call_legs[k], 2);
+                    number_of_bursted_legs++;
+                } else {
+                    batcher.Add(*call_legs[k], 1);
+                    batcher.Add(*call_legs[k], 1);
+                    number_of_bursted_legs++;
+                }
+            }
+            REQUIRE((number_of_bursted_legs ? 2U : 1U) == batcher.GetNumberOfRounds());
+            REQUIRE((number_of_batched_legs + G722_BATCH_LANES - 1) / G722_BATCH_LANES == batcher.GetNumberOfBatches(0));
+            if (number_of_bursted_legs) {
+                REQUIRE(1 == batcher.GetNumberOfBatches(1));
+            }
+
+            for (unsigned int round = 0; round < batcher.GetNumberOfRounds(); ++round) {
+                for (unsigned int batch = 0; batch < batcher.GetNumberOfBatches(round); ++batch) {
+                    batcher.EncodeBatch(round, batch);
+                }
+            }
+            for (unsigned int k = 0; k < number_of_legs; ++k) {
+                for (unsigned int packet = 0; packet < ((0 == k % 7) ? 2U : 1U); ++packet) {
+                    REQUIRE(call_legs[k]->SendPacket());
+                    packet_legs.push_back(k);
+                }
+                REQUIRE(nullptr == call_legs[k]->GetBatchPayload());
+            }
+            batcher.Clear();
+        }
+
+        REQUIRE(packet_legs.size() == consumer->packets.size());
+        unsigned int mismatches = 0;
+        std::vector<short int> pcm(G722_PACKET_SIZE);
+        std::vector<unsigned char> encoded(G722_PACKET_SIZE / 2);
+        for (unsigned int k = 0; k < packet_legs.size(); ++k) {
+            const unsigned int leg = packet_legs[k];
+            REQUIRE(reference_generators[leg]->Generate(pcm.data(), pcm.size()));
+            REQUIRE(reference_encoders[leg].Encode(pcm.data(), encoded.data()));
+            mismatches += !std::equal(encoded.begin(), encoded.end(), consumer->packets[k].begin() + ddgen::PacketTemplate::headers_size);
+        }
+        REQUIRE(0 == mismatches);
+    }
+
+    SECTION("G722 packets carry only encoded bytes and step timestamp by 160, whether they are batched or not")
+    {
+        ddgen::CallLeg call_leg(0x0a000001, 1000, 0x0a000002, 2000, 7, 1234, 5678, 9, &g722_encoder_factory, &generator_factory, consumer);
+        const auto tone = call_leg.GetParameters().toneParameters.front();
+        ddgen::SingleToneGeneratorType reference_generator(tone.amplitude, tone.frequency, tone.phase);
+        ddgen::G722EncoderType reference_encoder;
+
+        // packets are built in memory that earlier packets are left in
+        NoisyConsumer noisy_consumer;
+        ddgen::EncodeBatcher batcher;
+        for (unsigned int packet = 0; packet < 4; ++packet) {
+            if (packet % 2) {
+                batcher.Add(call_leg, 1);
+                batcher.EncodeBatch(0, 0);
+            }
+            REQUIRE(call_leg.SendPacket(noisy_consumer));
+            batcher.Clear();
+        }
+
+        ddgen::PseudoIpv4HeaderType pseudo_ipv4_header;
+        pseudo_ipv4_header.src_addr = 0x0a000001;
+        pseudo_ipv4_header.dst_addr = 0x0a000002;
+        pseudo_ipv4_header.protocol = 17;
+        pseudo_ipv4_header.data_len = ddgen::udp_header_size + ddgen::rtp_header_size + G722_PACKET_SIZE / 2;
+
+        std::vector<short int> pcm(G722_PACKET_SIZE);
+        std::vector<unsigned char> encoded(G722_PACKET_SIZE / 2);
+        REQUIRE(4 == noisy_consumer.packets.size());
+        for (unsigned int packet = 0; packet < 4; ++packet) {
+            const std::vector<unsigned char>& data = noisy_consumer.packets[packet];
+            REQUIRE(ddgen::PacketTemplate::headers_size + G722_PACKET_SIZE / 2 == data.size());
+            REQUIRE(reference_generator.Generate(pcm.data(), pcm.size()));
+            REQUIRE(reference_encoder.Encode(pcm.data(), encoded.data()));
+            REQUIRE(std::equal(encoded.begin(), encoded.end(), data.begin() + ddgen::PacketTemplate::headers_size));
+            REQUIRE(ddgen::CheckUdpChecksum(data.data() + ddgen::eth_header_size + ddgen::ipv4_header_size, pseudo_ipv4_header));
+
+            // rtp timestamp is in bytes 4 to 7 of rtp header, in network byte order
+            const unsigned char* timestamp_ptr = data.data() + ddgen::PacketTemplate::headers_size - ddgen::rtp_header_size + 4;
+            const unsigned int timestamp = (timestamp_ptr[0] << 24) | (timestamp_ptr[1] << 16) | (timestamp_ptr[2] << 8) | timestamp_ptr[3];
+            REQUIRE(1234 + packet * 160 == timestamp);
+        }
+    }
+
+    SECTION("legs of other codecs are not batched")
+    {
+        ddgen::CallLeg call_leg(0x0a000001, 1000, 0x0a000002, 2000, 7, 1234, 5678, 9, &g711a_encoder_factory, &generator_factory, consumer);
+        REQUIRE(nullptr == call_leg.GetBatchEncoder());
+
+        ddgen::EncodeBatcher batcher;
+        batcher.Add(call_leg, 2);
+        REQUIRE(0 == batcher.GetNumberOfRounds());
+        REQUIRE(nullptr == call_leg.GetBatchPayload());
+    }
+}
+
+TEST_CASE("Batch Consumer Tests", "[BatchConsumer]")
+{
+    auto capture_consumer = std::make_shared<CaptureConsumer>();
+    auto clock = std::make_shared<ddgen::VirtualClock>(1000000);
+    ddgen::BatchConsumer batch_consumer(capture_consumer, clock);
+
+    SECTION("packets are handed over in order at flush, stamped with time they are committed at")
+    {
+        for (unsigned int k = 0; k < 10; ++k) {
+            clock->SetTime(k * 20000);
+            unsigned char* data = batch_consumer.Acquire(100);
+            std::memset(data, k, 60);
+            REQUIRE(batch_consumer.Commit(60));
+        }
+        REQUIRE(capture_consumer->packets.empty());
+
+        REQUIRE(batch_consumer.Flush());
+        REQUIRE(1 == capture_consumer->batches.size());
+        REQUIRE(10 == capture_consumer->packets.size());
+        for (unsigned int k = 0; k < 10; ++k) {
+            REQUIRE(std::vector<unsigned char>(60, k) == capture_consumer->packets[k]);
+            REQUIRE(1000000 + k * 20000 == capture_consumer->timestamps[k]);
+        }
+
+        // nothing is left to hand over
+        REQUIRE(batch_consumer.Flush());
+        REQUIRE(1 == capture_consumer->batches.size());
+    }
+
+    SECTION("a full buffer is handed over early")
+    {
+        std::vector<unsigned char> packet(60000, 0x5a);
+        const unsigned int number_of_packets = BATCH_BUFFER_SIZE / packet.size() + 1;
+        for (unsigned int k = 0; k < number_of_packets; ++k) {
+            REQUIRE(batch_consumer.Consume(packet.data(), packet.size()));
+        }
+        REQUIRE(1 == capture_consumer->batches.size());
+        REQUIRE(1 == batch_consumer.GetNumberOfPackets());
+
+        REQUIRE(batch_consumer.Flush());
+        REQUIRE(number_of_packets == capture_consumer->packets.size());
+        REQUIRE(packet == capture_consumer->packets.back());
+    }
+}
+
+TEST_CASE("Lookahead Consumer Tests", "[LookaheadConsumer]")
+{
+    ddgen::G711aEncoderFactory g711a_encoder_factory;
+    ddgen::SingleToneGeneratorFactory generator_factory;
+    auto capture_consumer = std::make_shared<CaptureConsumer>();
+    auto lookahead_consumer = std::make_shared<ddgen::LookaheadConsumer>(capture_consumer, 1024);
+
+    SECTION("packets that overflow ring are not reported as sent, but their sequence numbers are consumed")
+    {
+        ddgen::CallLeg call_leg(
+            0x0a000001, 1000, 0x0a000002, 2000, 7, 1234, 5678, 9, &g711a_encoder_factory, &generator_factory, lookahead_consumer);
+
+        unsigned int sent_packets = 0;
+        while (call_leg.SendPacket() && (sent_packets < 100)) {
+            sent_packets++;
+        }
+        REQUIRE(0 < sent_packets);
+        REQUIRE(sent_packets < 100);
+        REQUIRE_FALSE(call_leg.SendPacket());
+        REQUIRE(2 == lookahead_consumer->GetOverflowPackets());
+
+        lookahead_consumer->Transmit((unsigned long long int)(-1));
+        REQUIRE(call_leg.SendPacket());
+        lookahead_consumer->Transmit((unsigned long long int)(-1));
+        REQUIRE(sent_packets + 1 == capture_consumer->packets.size());
+
+        // rtp sequence number is in bytes 2 and 3 of rtp header, in network byte order
+        const unsigned char* seq_num_ptr = capture_consumer->packets.back().data() + ddgen::PacketTemplate::headers_size - ddgen::rtp_header_size + 2;
+        REQUIRE(9 + sent_packets + 2 == ((seq_num_ptr[0] << 8) | seq_num_ptr[1]));
+    }
+}
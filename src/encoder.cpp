@@ -1,49 +1,226 @@
 #include "encoder.h"
+#include "KernelRegistry.h"
 
 #include <iostream>
 
+#if defined(G711_ENCODE_SIMD)
+#include <immintrin.h>
+#endif
+
 namespace ddgen {
 
-bool G711aEncoderType ::Encode(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr)
+constexpr G711EncodingTable<G711a_TABLE_INDEX_BITS> G711aEncoderType::_encodingTable(&G711aEncoderType::EncodeSampleReference);
+constexpr G711EncodingTable<G711u_TABLE_INDEX_BITS> G711uEncoderType::_encodingTable(&G711uEncoderType::EncodeSampleReference);
+
+namespace {
+#if defined(G711_ENCODE_SIMD)
+// a law of 8 samples, in 16 bit lanes
+__attribute__((target("sse4.1"))) __m128i ALawCodesSse41(__m128i pcm)
 {
-    if (!encoded_data_ptr) {
-        std::cerr << __FILE__ << " " << __LINE__ << "encoded_data_ptr is null" << std::endl;
-        return false;
+    // negative samples are complemented, quantization value is 11 bits of magnitude
+    const __m128i sign = _mm_srai_epi16(pcm, 15);
+    const __m128i quantization_value = _mm_srli_epi16(_mm_xor_si128(pcm, sign), 4);
+
+    // exponent and top 4 mantissa bits of float are segment and quantization step of values from 16 on, biased by 2080
+    const __m128i value_lo = _mm_cvtepu16_epi32(quantization_value);
+    const __m128i value_hi = _mm_cvtepu16_epi32(_mm_srli_si128(quantization_value, 8));
+    const __m128i bias = _mm_set1_epi32((127 + 3) << 4);
+    const __m128i code_lo = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(_mm_cvtepi32_ps(value_lo)), 19), bias);
+    const __m128i code_hi = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(_mm_cvtepi32_ps(value_hi)), 19), bias);
+    __m128i code = _mm_packs_epi32(code_lo, code_hi);
+
+    // reference encoder leaves values under 16 as code 0
+    code = _mm_andnot_si128(_mm_cmplt_epi16(quantization_value, _mm_set1_epi16(16)), code);
+
+    code = _mm_or_si128(code, _mm_andnot_si128(sign, _mm_set1_epi16(0x80)));
+    return _mm_xor_si128(code, _mm_set1_epi16(0x55));
+}
+
+// u law of 8 samples, in 16 bit lanes
+__attribute__((target("sse4.1"))) __m128i ULawCodesSse41(__m128i pcm)
+{
+    const __m128i sign = _mm_srai_epi16(pcm, 15);
+    __m128i quantization_value = _mm_srli_epi16(_mm_xor_si128(pcm, sign), 2);
+    quantization_value = _mm_min_epi16(_mm_add_epi16(quantization_value, _mm_set1_epi16(33)), _mm_set1_epi16(0x1FFF));
+
+    // segment is 1 plus bit length of value >> 6, which is exponent of 2 * (value >> 6) + 1 in float
+    const __m128i odd_value = _mm_or_si128(_mm_srli_epi16(quantization_value, 5), _mm_set1_epi16(1));
+    const __m128i exponent_lo = _mm_srli_epi32(_mm_castps_si128(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(odd_value))), 23);
+    const __m128i exponent_hi = _mm_srli_epi32(_mm_castps_si128(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(odd_value, 8)))), 23);
+    const __m128i exponent = _mm_packs_epi32(exponent_lo, exponent_hi);
+
+    // value is always more than segment, so that reference encoder leaves 14 as quantization step
+    __m128i code = _mm_slli_epi16(_mm_sub_epi16(_mm_set1_epi16(127 + 7), exponent), 4);
+    code = _mm_or_si128(code, _mm_set1_epi16(0x0E));
+
+    return _mm_or_si128(code, _mm_andnot_si128(sign, _mm_set1_epi16(0x80)));
+}
+
+// a law of 16 samples, in 16 bit lanes
+__attribute__((target("avx2"))) __m256i ALawCodesAvx2(__m256i pcm)
+{
+    const __m256i sign = _mm256_srai_epi16(pcm, 15);
+    const __m256i quantization_value = _mm256_srli_epi16(_mm256_xor_si256(pcm, sign), 4);
+
+    const __m256i value_lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(quantization_value));
+    const __m256i value_hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(quantization_value, 1));
+    const __m256i bias = _mm256_set1_epi32((127 + 3) << 4);
+    const __m256i code_lo = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(value_lo)), 19), bias);
+    const __m256i code_hi = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(value_hi)), 19), bias);
+
+    // pack works within 128 bit halves, quad words are put back in sample order
+    __m256i code = _mm256_permute4x64_epi64(_mm256_packs_epi32(code_lo, code_hi), 0xD8);
+
+    code = _mm256_andnot_si256(_mm256_cmpgt_epi16(_mm256_set1_epi16(16), quantization_value), code);
+
+    code = _mm256_or_si256(code, _mm256_andnot_si256(sign, _mm256_set1_epi16(0x80)));
+    return _mm256_xor_si256(code, _mm256_set1_epi16(0x55));
+}
+
+// u law of 16 samples, in 16 bit lanes
+__attribute__((target("avx2"))) __m256i ULawCodesAvx2(__m256i pcm)
+{
+    const __m256i sign = _mm256_srai_epi16(pcm, 15);
+    __m256i quantization_value = _mm256_srli_epi16(_mm256_xor_si256(pcm, sign), 2);
+    quantization_value = _mm256_min_epi16(_mm256_add_epi16(quantization_value, _mm256_set1_epi16(33)), _mm256_set1_epi16(0x1FFF));
+
+    const __m256i odd_value = _mm256_or_si256(_mm256_srli_epi16(quantization_value, 5), _mm256_set1_epi16(1));
+    const __m256i value_lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(odd_value));
+    const __m256i value_hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(odd_value, 1));
+    const __m256i exponent_lo = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(value_lo)), 23);
+    const __m256i exponent_hi = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(value_hi)), 23);
+    const __m256i exponent = _mm256_permute4x64_epi64(_mm256_packs_epi32(exponent_lo, exponent_hi), 0xD8);
+
+    __m256i code = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_set1_epi16(127 + 7), exponent), 4);
+    code = _mm256_or_si256(code, _mm256_set1_epi16(0x0E));
+
+    return _mm256_or_si256(code, _mm256_andnot_si256(sign, _mm256_set1_epi16(0x80)));
+}
+
+// a law of 16 samples, in 32 bit lanes, codes are narrowed to bytes
+// masked forms with all lanes set are used, so that no operation has an undefined merge source
+__attribute__((target("avx512f"))) __m128i ALawCodesAvx512(__m512i pcm)
+{
+    const __mmask16 lanes = 0xFFFF;
+    const __m512i sign = _mm512_maskz_srai_epi32(lanes, pcm, 31);
+    const __m512i quantization_value = _mm512_maskz_srli_epi32(lanes, _mm512_xor_si512(pcm, sign), 4);
+
+    const __m512 float_value = _mm512_maskz_cvtepi32_ps(lanes, quantization_value);
+    __m512i code = _mm512_sub_epi32(_mm512_maskz_srli_epi32(lanes, _mm512_castps_si512(float_value), 19), _mm512_set1_epi32((127 + 3) << 4));
+    code = _mm512_maskz_mov_epi32(_mm512_cmpge_epi32_mask(quantization_value, _mm512_set1_epi32(16)), code);
+
+    code = _mm512_or_si512(code, _mm512_maskz_andnot_epi32(lanes, sign, _mm512_set1_epi32(0x80)));
+    return _mm512_maskz_cvtepi32_epi8(lanes, _mm512_xor_si512(code, _mm512_set1_epi32(0x55)));
+}
+
+// u law of 16 samples, in 32 bit lanes, codes are narrowed to bytes
+__attribute__((target("avx512f"))) __m128i ULawCodesAvx512(__m512i pcm)
+{
+    const __mmask16 lanes = 0xFFFF;
+    const __m512i sign = _mm512_maskz_srai_epi32(lanes, pcm, 31);
+    __m512i quantization_value = _mm512_maskz_srli_epi32(lanes, _mm512_xor_si512(pcm, sign), 2);
+    quantization_value = _mm512_maskz_min_epi32(lanes, _mm512_add_epi32(quantization_value, _mm512_set1_epi32(33)), _mm512_set1_epi32(0x1FFF));
+
+    const __m512i odd_value = _mm512_or_si512(_mm512_maskz_srli_epi32(lanes, quantization_value, 5), _mm512_set1_epi32(1));
+    const __m512i exponent = _mm512_maskz_srli_epi32(lanes, _mm512_castps_si512(_mm512_maskz_cvtepi32_ps(lanes, odd_value)), 23);
+
+    __m512i code = _mm512_maskz_slli_epi32(lanes, _mm512_sub_epi32(_mm512_set1_epi32(127 + 7), exponent), 4);
+    code = _mm512_or_si512(code, _mm512_set1_epi32(0x0E));
+
+    return _mm512_maskz_cvtepi32_epi8(lanes, _mm512_or_si512(code, _mm512_maskz_andnot_epi32(lanes, sign, _mm512_set1_epi32(0x80))));
+}
+#endif
+} // namespace
+
+void G711aEncodeScalar(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples)
+{
+    for (unsigned int k = 0; k < number_of_samples; k++) {
+        encoded_data_ptr[k] = G711aEncoderType::EncodeSample(pcm_data_ptr[k]);
+    }
+}
+
+void G711uEncodeScalar(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples)
+{
+    for (unsigned int k = 0; k < number_of_samples; k++) {
+        encoded_data_ptr[k] = G711uEncoderType::EncodeSample(pcm_data_ptr[k]);
     }
+}
 
-    if (!pcm_data_ptr) {
-        std::cerr << __FILE__ << " " << __LINE__ << "pcm_data_ptr is null" << std::endl;
-        return false;
+#if defined(G711_ENCODE_SIMD)
+__attribute__((target("sse4.1"))) void G711aEncodeSse41(const short int* pcm_data_ptr,
+                                                        unsigned char* encoded_data_ptr,
+                                                        unsigned int number_of_samples)
+{
+    for (; number_of_samples >= 16; number_of_samples -= 16, pcm_data_ptr += 16, encoded_data_ptr += 16) {
+        const __m128i code_lo = ALawCodesSse41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm_data_ptr)));
+        const __m128i code_hi = ALawCodesSse41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm_data_ptr + 8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(encoded_data_ptr), _mm_packus_epi16(code_lo, code_hi));
     }
 
-    for (unsigned int k = 0; k < G711_PACKET_SIZE; k++) {
-        unsigned char encoded_data = 0;
-        short int pcm_data = *pcm_data_ptr++;
-        short int quantization_value = (pcm_data < 0) ? ((~pcm_data) >> 4) : (pcm_data >> 4);
+    G711aEncodeScalar(pcm_data_ptr, encoded_data_ptr, number_of_samples);
+}
 
-        if (quantization_value > 15) {
-            short int quantization_segment = 1;
-            while (quantization_value > (16 + 15)) {
-                quantization_value >>= 1;
-                quantization_segment++;
-            }
-            quantization_value -= 16;
+__attribute__((target("sse4.1"))) void G711uEncodeSse41(const short int* pcm_data_ptr,
+                                                        unsigned char* encoded_data_ptr,
+                                                        unsigned int number_of_samples)
+{
+    for (; number_of_samples >= 16; number_of_samples -= 16, pcm_data_ptr += 16, encoded_data_ptr += 16) {
+        const __m128i code_lo = ULawCodesSse41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm_data_ptr)));
+        const __m128i code_hi = ULawCodesSse41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pcm_data_ptr + 8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(encoded_data_ptr), _mm_packus_epi16(code_lo, code_hi));
+    }
 
-            encoded_data = quantization_value + (quantization_segment << 4);
-        }
+    G711uEncodeScalar(pcm_data_ptr, encoded_data_ptr, number_of_samples);
+}
 
-        if (pcm_data >= 0)
-            encoded_data |= 0x80;
+__attribute__((target("avx2"))) void G711aEncodeAvx2(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples)
+{
+    for (; number_of_samples >= 16; number_of_samples -= 16, pcm_data_ptr += 16, encoded_data_ptr += 16) {
+        const __m256i code = ALawCodesAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pcm_data_ptr)));
+        const __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(code), _mm256_extracti128_si256(code, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(encoded_data_ptr), bytes);
+    }
 
-        encoded_data ^= 0x55;
+    G711aEncodeScalar(pcm_data_ptr, encoded_data_ptr, number_of_samples);
+}
 
-        *encoded_data_ptr++ = encoded_data;
+__attribute__((target("avx2"))) void G711uEncodeAvx2(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr, unsigned int number_of_samples)
+{
+    for (; number_of_samples >= 16; number_of_samples -= 16, pcm_data_ptr += 16, encoded_data_ptr += 16) {
+        const __m256i code = ULawCodesAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pcm_data_ptr)));
+        const __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(code), _mm256_extracti128_si256(code, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(encoded_data_ptr), bytes);
     }
 
-    return true;
+    G711uEncodeScalar(pcm_data_ptr, encoded_data_ptr, number_of_samples);
 }
 
-bool G711uEncoderType ::Encode(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr)
+__attribute__((target("avx512f"))) void G711aEncodeAvx512(const short int* pcm_data_ptr,
+                                                          unsigned char* encoded_data_ptr,
+                                                          unsigned int number_of_samples)
+{
+    for (; number_of_samples >= 16; number_of_samples -= 16, pcm_data_ptr += 16, encoded_data_ptr += 16) {
+        const __m512i pcm = _mm512_maskz_cvtepi16_epi32(0xFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pcm_data_ptr)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(encoded_data_ptr), ALawCodesAvx512(pcm));
+    }
+
+    G711aEncodeScalar(pcm_data_ptr, encoded_data_ptr, number_of_samples);
+}
+
+__attribute__((target("avx512f"))) void G711uEncodeAvx512(const short int* pcm_data_ptr,
+                                                          unsigned char* encoded_data_ptr,
+                                                          unsigned int number_of_samples)
+{
+    for (; number_of_samples >= 16; number_of_samples -= 16, pcm_data_ptr += 16, encoded_data_ptr += 16) {
+        const __m512i pcm = _mm512_maskz_cvtepi16_epi32(0xFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pcm_data_ptr)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(encoded_data_ptr), ULawCodesAvx512(pcm));
+    }
+
+    G711uEncodeScalar(pcm_data_ptr, encoded_data_ptr, number_of_samples);
+}
+#endif
+
+bool G711aEncoderType ::Encode(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr)
 {
     if (!encoded_data_ptr) {
         std::cerr << __FILE__ << " " << __LINE__ << "encoded_data_ptr is null" << std::endl;
@@ -55,26 +232,25 @@ bool G711uEncoderType ::Encode(const short int* pcm_data_ptr, unsigned char* enc
         return false;
     }
 
-    for (unsigned int k = 0; k < G711_PACKET_SIZE; k++) {
-        short int pcm_data = *pcm_data_ptr++;
-        short int quantization_value = (pcm_data < 0) ? (((~pcm_data) >> 2) + 33) : ((pcm_data >> 2) + 33);
-
-        if (quantization_value > (0x1FFF)) // clip to 8192
-            quantization_value = (0x1FFF);
-
-        short int quantization_segment = 1;
-        // Determination of quantization segment
-        for (short int i = (quantization_value >> 6); i; i >>= 1)
-            quantization_segment++;
+    KernelRegistry::Get().g711aEncode(pcm_data_ptr, encoded_data_ptr, G711_PACKET_SIZE);
 
-        unsigned char encoded_data = (((0x08 - quantization_segment) << 4) | (0x000F - ((quantization_value > quantization_segment) & 0x000F)));
+    return true;
+}
 
-        if (pcm_data >= 0)
-            encoded_data |= 0x80;
+bool G711uEncoderType ::Encode(const short int* pcm_data_ptr, unsigned char* encoded_data_ptr)
+{
+    if (!encoded_data_ptr) {
+        std::cerr << __FILE__ << " " << __LINE__ << "encoded_data_ptr is null" << std::endl;
+        return false;
+    }
 
-        *encoded_data_ptr++ = encoded_data;
+    if (!pcm_data_ptr) {
+        std::cerr << __FILE__ << " " << __LINE__ << "pcm_data_ptr is null" << std::endl;
+        return false;
     }
 
+    KernelRegistry::Get().g711uEncode(pcm_data_ptr, encoded_data_ptr, G711_PACKET_SIZE);
+
     return true;
 }
 } // namespace ddgen
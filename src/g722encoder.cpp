@@ -1,9 +1,552 @@
 #include "g722encoder.h"
+#include "KernelRegistry.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 namespace ddgen {
 
+#define QMF_TX_TAPS 24         /**< taps of transmit QMF, 12 pairs of samples */
+#define QMF_TX_HISTORY 22      /**< past samples that taps of a pair reach back to */
+#define QMF_TX_CHUNK_PAIRS 160 /**< pairs that are filtered over a window, a G722 packet */
+
+namespace {
+/**
+ * @brief Coefficients of a pair of taps, in time order, as a 32 bit lane of a 16 bit multiply and add
+ *
+ * Older sample of a pair multiplies low half. Low band sums all taps, high band takes taps of older samples negated.
+ * @param tap_pair INPUT pair of taps, 0 for oldest
+ * @param high_band INPUT true for coefficients of high band
+ */
+int GetQmfTxCoefficientPair(unsigned int tap_pair, bool high_band)
+{
+    const short int older = coef_qmf[QMF_TX_TAPS - 1 - 2 * tap_pair];
+    const short int newer = coef_qmf[QMF_TX_TAPS - 2 - 2 * tap_pair];
+    return (int)((unsigned short int)(high_band ? -older : older) | ((unsigned int)(unsigned short int)newer << 16));
+}
+
+short int ClampQmfTxOutput(int sum)
+{
+    return (short int)std::min(std::max(sum >> 15, -16384), 16383);
+}
+
+/**
+ * @brief Low and high band samples of a pair, taps start at window_ptr, oldest first
+ */
+void QmfTxPair(const short int* window_ptr, short int& low_band, short int& high_band)
+{
+    int low_sum = 0;
+    int high_sum = 0;
+    for (unsigned int k = 0; k < QMF_TX_TAPS; ++k) {
+        const int product = (int)coef_qmf[QMF_TX_TAPS - 1 - k] * window_ptr[k];
+        low_sum += product;
+        high_sum += (k & 1) ? product : -product;
+    }
+
+    // reference doubles sums and takes upper 16 bits
+    low_band = ClampQmfTxOutput(low_sum);
+    high_band = ClampQmfTxOutput(high_sum);
+}
+
+typedef void (*QmfTxGroupsKernel)(const short int* window_ptr, unsigned int number_of_groups, short int* low_band_ptr, short int* high_band_ptr);
+
+/**
+ * @brief Filter pairs over a window that holds history of delay line followed by samples
+ *
+ * Groups of pairs are filtered by vector kernel, remaining pairs of a chunk one by one.
+ */
+template <QmfTxGroupsKernel groups_kernel, unsigned int group_pairs>
+void QmfTxOverWindow(const short int* pcm_data_ptr,
+                     unsigned int number_of_pairs,
+                     short int* delay_line_ptr,
+                     short int* low_band_ptr,
+                     short int* high_band_ptr)
+{
+    if (0 == number_of_pairs) {
+        return;
+    }
+
+    // delay line holds newest sample first from its third entry on
+    short int window[QMF_TX_HISTORY + 2 * QMF_TX_CHUNK_PAIRS];
+    for (unsigned int k = 0; k < QMF_TX_HISTORY; ++k) {
+        window[k] = delay_line_ptr[QMF_TX_TAPS - 1 - k];
+    }
+
+    while (number_of_pairs) {
+        const unsigned int chunk_pairs = std::min(number_of_pairs, (unsigned int)QMF_TX_CHUNK_PAIRS);
+        std::memcpy(window + QMF_TX_HISTORY, pcm_data_ptr, 2 * chunk_pairs * sizeof(short int));
+
+        const unsigned int number_of_groups = chunk_pairs / group_pairs;
+        groups_kernel(window, number_of_groups, low_band_ptr, high_band_ptr);
+        for (unsigned int pair = number_of_groups * group_pairs; pair < chunk_pairs; ++pair) {
+            QmfTxPair(window + 2 * pair, low_band_ptr[pair], high_band_ptr[pair]);
+        }
+
+        // newest samples are history of next chunk
+        std::memmove(window, window + 2 * chunk_pairs, QMF_TX_HISTORY * sizeof(short int));
+        pcm_data_ptr += 2 * chunk_pairs;
+        low_band_ptr += chunk_pairs;
+        high_band_ptr += chunk_pairs;
+        number_of_pairs -= chunk_pairs;
+    }
+
+    // as left by reference, first two entries repeat newest pair
+    for (unsigned int k = 0; k < QMF_TX_HISTORY; ++k) {
+        delay_line_ptr[QMF_TX_TAPS - 1 - k] = window[k];
+    }
+    delay_line_ptr[0] = delay_line_ptr[2];
+    delay_line_ptr[1] = delay_line_ptr[3];
+}
+
+#if defined(G722_QMF_SIMD)
+// 4 pairs, a lane of a 16 bit multiply and add covers a pair of taps of a pair of samples
+__attribute__((target("sse2"))) void QmfTxGroupsSse2(const short int* window_ptr,
+                                                     unsigned int number_of_groups,
+                                                     short int* low_band_ptr,
+                                                     short int* high_band_ptr)
+{
+    __m128i low_coefficients[QMF_TX_TAPS / 2];
+    __m128i high_coefficients[QMF_TX_TAPS / 2];
+    for (unsigned int t = 0; t < QMF_TX_TAPS / 2; ++t) {
+        low_coefficients[t] = _mm_set1_epi32(GetQmfTxCoefficientPair(t, false));
+        high_coefficients[t] = _mm_set1_epi32(GetQmfTxCoefficientPair(t, true));
+    }
+    const __m128i min_output = _mm_set1_epi16(-16384);
+    const __m128i max_output = _mm_set1_epi16(16383);
+
+    for (; number_of_groups; --number_of_groups, window_ptr += 8, low_band_ptr += 4, high_band_ptr += 4) {
+        __m128i low_sum = _mm_setzero_si128();
+        __m128i high_sum = _mm_setzero_si128();
+        for (unsigned int t = 0; t < QMF_TX_TAPS / 2; ++t) {
+            const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(window_ptr + 2 * t));
+            low_sum = _mm_add_epi32(low_sum, _mm_madd_epi16(samples, low_coefficients[t]));
+            high_sum = _mm_add_epi32(high_sum, _mm_madd_epi16(samples, high_coefficients[t]));
+        }
+
+        __m128i bands = _mm_packs_epi32(_mm_srai_epi32(low_sum, 15), _mm_srai_epi32(high_sum, 15));
+        bands = _mm_min_epi16(_mm_max_epi16(bands, min_output), max_output);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(low_band_ptr), bands);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(high_band_ptr), _mm_unpackhi_epi64(bands, bands));
+    }
+}
+
+// 8 pairs
+__attribute__((target("avx2"))) void QmfTxGroupsAvx2(const short int* window_ptr,
+                                                     unsigned int number_of_groups,
+                                                     short int* low_band_ptr,
+                                                     short int* high_band_ptr)
+{
+    __m256i low_coefficients[QMF_TX_TAPS / 2];
+    __m256i high_coefficients[QMF_TX_TAPS / 2];
+    for (unsigned int t = 0; t < QMF_TX_TAPS / 2; ++t) {
+        low_coefficients[t] = _mm256_set1_epi32(GetQmfTxCoefficientPair(t, false));
+        high_coefficients[t] = _mm256_set1_epi32(GetQmfTxCoefficientPair(t, true));
+    }
+    const __m256i min_output = _mm256_set1_epi16(-16384);
+    const __m256i max_output = _mm256_set1_epi16(16383);
+
+    for (; number_of_groups; --number_of_groups, window_ptr += 16, low_band_ptr += 8, high_band_ptr += 8) {
+        __m256i low_sum = _mm256_setzero_si256();
+        __m256i high_sum = _mm256_setzero_si256();
+        for (unsigned int t = 0; t < QMF_TX_TAPS / 2; ++t) {
+            const __m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(window_ptr + 2 * t));
+            low_sum = _mm256_add_epi32(low_sum, _mm256_madd_epi16(samples, low_coefficients[t]));
+            high_sum = _mm256_add_epi32(high_sum, _mm256_madd_epi16(samples, high_coefficients[t]));
+        }
+
+        // pack works within 128 bit halves, quad words are put back so that low band is in lower half
+        __m256i bands = _mm256_packs_epi32(_mm256_srai_epi32(low_sum, 15), _mm256_srai_epi32(high_sum, 15));
+        bands = _mm256_permute4x64_epi64(bands, 0xD8);
+        bands = _mm256_min_epi16(_mm256_max_epi16(bands, min_output), max_output);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(low_band_ptr), _mm256_castsi256_si128(bands));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(high_band_ptr), _mm256_extracti128_si256(bands, 1));
+    }
+}
+
+// 16 pairs
+__attribute__((target("avx512f,avx512bw"))) void QmfTxGroupsAvx512(const short int* window_ptr,
+                                                                   unsigned int number_of_groups,
+                                                                   short int* low_band_ptr,
+                                                                   short int* high_band_ptr)
+{
+    __m512i low_coefficients[QMF_TX_TAPS / 2];
+    __m512i high_coefficients[QMF_TX_TAPS / 2];
+    for (unsigned int t = 0; t < QMF_TX_TAPS / 2; ++t) {
+        low_coefficients[t] = _mm512_set1_epi32(GetQmfTxCoefficientPair(t, false));
+        high_coefficients[t] = _mm512_set1_epi32(GetQmfTxCoefficientPair(t, true));
+    }
+    const __m256i min_output = _mm256_set1_epi16(-16384);
+    const __m256i max_output = _mm256_set1_epi16(16383);
+    const __mmask16 lanes = 0xFFFF; // masked forms with all lanes set, so that no operation has an undefined merge source
+
+    for (; number_of_groups; --number_of_groups, window_ptr += 32, low_band_ptr += 16, high_band_ptr += 16) {
+        __m512i low_sum = _mm512_setzero_si512();
+        __m512i high_sum = _mm512_setzero_si512();
+        for (unsigned int t = 0; t < QMF_TX_TAPS / 2; ++t) {
+            const __m512i samples = _mm512_loadu_si512(window_ptr + 2 * t);
+            low_sum = _mm512_add_epi32(low_sum, _mm512_madd_epi16(samples, low_coefficients[t]));
+            high_sum = _mm512_add_epi32(high_sum, _mm512_madd_epi16(samples, high_coefficients[t]));
+        }
+
+        const __m256i low_band = _mm512_maskz_cvtsepi32_epi16(lanes, _mm512_maskz_srai_epi32(lanes, low_sum, 15));
+        const __m256i high_band = _mm512_maskz_cvtsepi32_epi16(lanes, _mm512_maskz_srai_epi32(lanes, high_sum, 15));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(low_band_ptr), _mm256_min_epi16(_mm256_max_epi16(low_band, min_output), max_output));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(high_band_ptr), _mm256_min_epi16(_mm256_max_epi16(high_band, min_output), max_output));
+    }
+}
+#endif
+
+#if defined(G722_BATCH_AVX2)
+/**
+ * @brief Memory of a band of G722_BATCH_LANES encoders, each 16 bit lane holds an encoder
+ *
+ * Fields are those of lower or upper band of FullBandType, det is detl or deth, a is al or ah and so on.
+ */
+struct AdpcmLanes
+{
+    __m256i det;
+    __m256i nb;
+    __m256i s;
+    __m256i sp;
+    __m256i sz;
+    __m256i a[3];
+    __m256i p[3];
+    __m256i r[3];
+    __m256i b[7];
+    __m256i d[7];
+};
+
+/**
+ * @brief Offsets of fields of a band in FullBandType
+ */
+struct AdpcmOffsets
+{
+    std::size_t det;
+    std::size_t nb;
+    std::size_t s;
+    std::size_t sp;
+    std::size_t sz;
+    std::size_t a;
+    std::size_t p;
+    std::size_t r;
+    std::size_t b;
+    std::size_t d;
+};
+
+const AdpcmOffsets lower_band_offsets = { offsetof(FullBandType, detl), offsetof(FullBandType, nbl), offsetof(FullBandType, sl),
+                                          offsetof(FullBandType, spl),  offsetof(FullBandType, szl), offsetof(FullBandType, al),
+                                          offsetof(FullBandType, plt),  offsetof(FullBandType, rlt), offsetof(FullBandType, bl),
+                                          offsetof(FullBandType, dlt) };
+
+const AdpcmOffsets upper_band_offsets = { offsetof(FullBandType, deth), offsetof(FullBandType, nbh), offsetof(FullBandType, sh),
+                                          offsetof(FullBandType, sph),  offsetof(FullBandType, szh), offsetof(FullBandType, ah),
+                                          offsetof(FullBandType, ph),   offsetof(FullBandType, rh),  offsetof(FullBandType, bh),
+                                          offsetof(FullBandType, dh) };
+
+/**
+ * @brief A table of up to 16 entries of 16 bit values, split into low and high bytes for byte shuffles
+ */
+struct ShuffleTable
+{
+    __m256i low_bytes;
+    __m256i high_bytes;
+};
+
+/**
+ * @brief Tables of ADPCM of both bands, derived once from tables of reference
+ */
+struct AdpcmTables
+{
+    __m256i quantl_thresholds[29]; /**< q6[1] to q6[29] shifted so that a multiply high by detl gives ScaledMult(q6 << 3, detl) */
+    ShuffleTable invqal;           /**< signed output of Invqal() before scaling, by il >> 2 */
+    ShuffleTable logscl;           /**< wl of Logscl(), by il >> 2 */
+    ShuffleTable invqah;           /**< signed output of Invqah() before scaling, by ih */
+    ShuffleTable logsch;           /**< wh of Logsch(), by ih */
+    const int* scale_factors;      /**< output of Scalel() and Scaleh() by their index into ila */
+};
+
+/**
+ * @brief (ila + 1) << 2 of each entry of ila, as 32 bit values for gathers
+ */
+const int* GetScaleFactors()
+{
+    struct ScaleFactors
+    {
+        int values[sizeof(ila) / sizeof(ila[0])];
+
+        ScaleFactors()
+        {
+            for (unsigned int k = 0; k < sizeof(ila) / sizeof(ila[0]); ++k) {
+                values[k] = (ila[k] + 1) << 2;
+            }
+        }
+    };
+
+    static const ScaleFactors scale_factors;
+    return scale_factors.values;
+}
+
+__attribute__((target("avx2"))) ShuffleTable MakeShuffleTable(const short int* table, unsigned int size)
+{
+    alignas(16) unsigned char low_bytes[16] = {};
+    alignas(16) unsigned char high_bytes[16] = {};
+    for (unsigned int k = 0; k < size; ++k) {
+        low_bytes[k] = (unsigned char)((unsigned short int)table[k] & 0xff);
+        high_bytes[k] = (unsigned char)((unsigned short int)table[k] >> 8);
+    }
+    return { _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(low_bytes))),
+             _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(high_bytes))) };
+}
+
+__attribute__((target("avx2"))) AdpcmTables MakeAdpcmTables()
+{
+    AdpcmTables tables;
+    for (unsigned int m = 1; m < 30; ++m) {
+        tables.quantl_thresholds[m - 1] = _mm256_set1_epi16((short int)(q6[m] << 4));
+    }
+
+    short int invqal_table[16];
+    short int logscl_table[16];
+    for (unsigned int ril = 0; ril < 16; ++ril) {
+        const short int wd1 = oq4[ril4[ril]] << 3;
+        invqal_table[ril] = risil[ril] ? -wd1 : wd1;
+        logscl_table[ril] = wl[ril4[ril]];
+    }
+
+    short int invqah_table[4];
+    short int logsch_table[4];
+    for (unsigned int ih = 0; ih < 4; ++ih) {
+        const short int wd1 = oq2[ih2[ih]] << 3;
+        invqah_table[ih] = sih[ih] ? -wd1 : wd1;
+        logsch_table[ih] = wh[ih2[ih]];
+    }
+
+    tables.invqal = MakeShuffleTable(invqal_table, 16);
+    tables.logscl = MakeShuffleTable(logscl_table, 16);
+    tables.invqah = MakeShuffleTable(invqah_table, 4);
+    tables.logsch = MakeShuffleTable(logsch_table, 4);
+    tables.scale_factors = GetScaleFactors();
+    return tables;
+}
+
+/**
+ * @brief Tables of ADPCM, built by first batch and shared by all later ones
+ */
+__attribute__((target("avx2"))) const AdpcmTables& GetAdpcmTables()
+{
+    static const AdpcmTables tables = MakeAdpcmTables();
+    return tables;
+}
+
+/**
+ * @brief Entry of table for each lane, lanes of index should be less than 16
+ */
+__attribute__((target("avx2"))) __m256i LookupLanes(__m256i index, const ShuffleTable& table)
+{
+    // an index byte with its top bit set gives zero, so each shuffle fills only its own byte of a lane
+    const __m256i low_index = _mm256_or_si256(index, _mm256_set1_epi16((short int)0x8000));
+    const __m256i high_index = _mm256_or_si256(_mm256_slli_epi16(index, 8), _mm256_set1_epi16(0x0080));
+    return _mm256_or_si256(_mm256_shuffle_epi8(table.low_bytes, low_index), _mm256_shuffle_epi8(table.high_bytes, high_index));
+}
+
+/**
+ * @brief Scale factor for each lane, lanes of index should be less than size of ila
+ */
+__attribute__((target("avx2"))) __m256i ScaleFactorLanes(__m256i index, const int* scale_factors)
+{
+    const __m256i low = _mm256_i32gather_epi32(scale_factors, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(index)), 4);
+    const __m256i high = _mm256_i32gather_epi32(scale_factors, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(index, 1)), 4);
+
+    // packing works within 128 bit halves, quadwords are put back into lane order
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+}
+
+/**
+ * @brief ScaledMult() of each lane, low 16 bits of product shifted right by 15
+ */
+__attribute__((target("avx2"))) __m256i ScaledMultLanes(__m256i op1, __m256i op2)
+{
+    return _mm256_or_si256(_mm256_slli_epi16(_mm256_mulhi_epi16(op1, op2), 1), _mm256_srli_epi16(_mm256_mullo_epi16(op1, op2), 15));
+}
+
+__attribute__((target("avx2"))) __m256i LoadLanes(FullBandType* const* bands, std::size_t offset)
+{
+    alignas(32) short int lanes[G722_BATCH_LANES];
+    for (unsigned int k = 0; k < G722_BATCH_LANES; ++k) {
+        std::memcpy(&lanes[k], reinterpret_cast<const unsigned char*>(bands[k]) + offset, sizeof(short int));
+    }
+    return _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes));
+}
+
+__attribute__((target("avx2"))) void StoreLanes(__m256i value, FullBandType* const* bands, unsigned int number_of_bands, std::size_t offset)
+{
+    alignas(32) short int lanes[G722_BATCH_LANES];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), value);
+    for (unsigned int k = 0; k < number_of_bands; ++k) {
+        std::memcpy(reinterpret_cast<unsigned char*>(bands[k]) + offset, &lanes[k], sizeof(short int));
+    }
+}
+
+__attribute__((target("avx2"))) void LoadBand(AdpcmLanes& band, FullBandType* const* bands, const AdpcmOffsets& offsets)
+{
+    band.det = LoadLanes(bands, offsets.det);
+    band.nb = LoadLanes(bands, offsets.nb);
+    band.s = LoadLanes(bands, offsets.s);
+    band.sp = LoadLanes(bands, offsets.sp);
+    band.sz = LoadLanes(bands, offsets.sz);
+    for (unsigned int i = 0; i < 3; ++i) {
+        band.a[i] = LoadLanes(bands, offsets.a + i * sizeof(short int));
+        band.p[i] = LoadLanes(bands, offsets.p + i * sizeof(short int));
+        band.r[i] = LoadLanes(bands, offsets.r + i * sizeof(short int));
+    }
+    for (unsigned int i = 0; i < 7; ++i) {
+        band.b[i] = LoadLanes(bands, offsets.b + i * sizeof(short int));
+        band.d[i] = LoadLanes(bands, offsets.d + i * sizeof(short int));
+    }
+}
+
+__attribute__((target("avx2"))) void StoreBand(const AdpcmLanes& band,
+                                               FullBandType* const* bands,
+                                               unsigned int number_of_bands,
+                                               const AdpcmOffsets& offsets)
+{
+    StoreLanes(band.det, bands, number_of_bands, offsets.det);
+    StoreLanes(band.nb, bands, number_of_bands, offsets.nb);
+    StoreLanes(band.s, bands, number_of_bands, offsets.s);
+    StoreLanes(band.sp, bands, number_of_bands, offsets.sp);
+    StoreLanes(band.sz, bands, number_of_bands, offsets.sz);
+    for (unsigned int i = 0; i < 3; ++i) {
+        StoreLanes(band.a[i], bands, number_of_bands, offsets.a + i * sizeof(short int));
+        StoreLanes(band.p[i], bands, number_of_bands, offsets.p + i * sizeof(short int));
+        StoreLanes(band.r[i], bands, number_of_bands, offsets.r + i * sizeof(short int));
+    }
+    for (unsigned int i = 0; i < 7; ++i) {
+        StoreLanes(band.b[i], bands, number_of_bands, offsets.b + i * sizeof(short int));
+        StoreLanes(band.d[i], bands, number_of_bands, offsets.d + i * sizeof(short int));
+    }
+}
+
+/**
+ * @brief Adapt predictor of a band to quantized difference, as LsbCod() and HsbCod() do after quantization
+ *
+ * Steps of Upzero(), Uppol2(), Uppol1(), Filtez() and Filtep() are kept in order, so that saturations are the same.
+ */
+__attribute__((target("avx2"))) void AdaptLanes(AdpcmLanes& band, __m256i dq)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    band.d[0] = dq;
+    band.p[0] = _mm256_adds_epi16(dq, band.sz); /* parrec */
+    band.r[0] = _mm256_adds_epi16(band.s, dq);  /* recons */
+
+    // upzero
+    const __m256i step = _mm256_andnot_si256(_mm256_cmpeq_epi16(dq, zero), _mm256_set1_epi16(128));
+    const __m256i sg0 = _mm256_srai_epi16(dq, 15);
+    for (unsigned int i = 6; i > 0; --i) {
+        const __m256i same_sign = _mm256_cmpeq_epi16(sg0, _mm256_srai_epi16(band.d[i], 15));
+        const __m256i wd2 = _mm256_blendv_epi8(_mm256_sub_epi16(zero, step), step, same_sign);
+        band.b[i] = _mm256_adds_epi16(wd2, ScaledMultLanes(band.b[i], _mm256_set1_epi16(32640)));
+        band.d[i] = band.d[i - 1];
+    }
+
+    // uppol2, shift left by 2 saturates as two saturating doublings
+    const __m256i sgp0 = _mm256_srai_epi16(band.p[0], 15);
+    const __m256i same_sign_1 = _mm256_cmpeq_epi16(sgp0, _mm256_srai_epi16(band.p[1], 15));
+    const __m256i same_sign_2 = _mm256_cmpeq_epi16(sgp0, _mm256_srai_epi16(band.p[2], 15));
+    __m256i wd2 = _mm256_adds_epi16(band.a[1], band.a[1]);
+    wd2 = _mm256_adds_epi16(wd2, wd2);
+    wd2 = _mm256_srai_epi16(_mm256_blendv_epi8(wd2, _mm256_subs_epi16(zero, wd2), same_sign_1), 7);
+    const __m256i wd3 = _mm256_blendv_epi8(_mm256_set1_epi16(-128), _mm256_set1_epi16(128), same_sign_2);
+    __m256i apl2 = _mm256_adds_epi16(_mm256_adds_epi16(wd2, wd3), ScaledMultLanes(band.a[2], _mm256_set1_epi16(32512)));
+    apl2 = _mm256_min_epi16(_mm256_max_epi16(apl2, _mm256_set1_epi16(-12288)), _mm256_set1_epi16(12288));
+    band.a[2] = apl2;
+
+    // uppol1
+    const __m256i wd1 = _mm256_blendv_epi8(_mm256_set1_epi16(-192), _mm256_set1_epi16(192), same_sign_1);
+    __m256i apl1 = _mm256_adds_epi16(wd1, ScaledMultLanes(band.a[1], _mm256_set1_epi16(32640)));
+    const __m256i limit = _mm256_subs_epi16(_mm256_set1_epi16(15360), apl2);
+    apl1 = _mm256_min_epi16(_mm256_max_epi16(apl1, _mm256_sub_epi16(zero, limit)), limit);
+    band.p[2] = band.p[1];
+    band.p[1] = band.p[0];
+    band.a[1] = apl1;
+
+    // filtez
+    __m256i sz = zero;
+    for (unsigned int i = 6; i > 0; --i) {
+        sz = _mm256_adds_epi16(sz, ScaledMultLanes(_mm256_adds_epi16(band.d[i], band.d[i]), band.b[i]));
+    }
+    band.sz = sz;
+
+    // filtep
+    band.r[2] = band.r[1];
+    band.r[1] = band.r[0];
+    const __m256i wd4 = ScaledMultLanes(band.a[1], _mm256_adds_epi16(band.r[1], band.r[1]));
+    const __m256i wd5 = ScaledMultLanes(band.a[2], _mm256_adds_epi16(band.r[2], band.r[2]));
+    band.sp = _mm256_adds_epi16(wd4, wd5);
+    band.s = _mm256_adds_epi16(band.sp, band.sz); /* predic */
+}
+
+/**
+ * @brief LsbCod() of each lane
+ *
+ * Quantl() searches thresholds till one exceeds magnitude of difference, here all thresholds are compared and mil is
+ * one plus number of thresholds that magnitude reaches. Magnitude is el, or ~el if el is negative, as in reference.
+ */
+__attribute__((target("avx2"))) __m256i LowerBandLanes(AdpcmLanes& band, __m256i xl, const AdpcmTables& tables)
+{
+    const __m256i el = _mm256_subs_epi16(xl, band.s);
+    const __m256i sil = _mm256_srai_epi16(el, 15);
+    const __m256i wd = _mm256_xor_si256(el, sil);
+
+    // thresholds and detl are positive, unsigned multiply high gives ScaledMult() of them
+    __m256i mil = _mm256_set1_epi16(30);
+    for (unsigned int m = 0; m < 29; ++m) {
+        mil = _mm256_add_epi16(mil, _mm256_cmpgt_epi16(_mm256_mulhi_epu16(tables.quantl_thresholds[m], band.det), wd));
+    }
+
+    // misil, positive codes count down from 0x3D, negative ones from 0x3F and then from 0x1F
+    const __m256i negative_base = _mm256_blendv_epi8(_mm256_set1_epi16(0x22), _mm256_set1_epi16(0x40), _mm256_cmpgt_epi16(_mm256_set1_epi16(3), mil));
+    const __m256i il = _mm256_sub_epi16(_mm256_blendv_epi8(_mm256_set1_epi16(0x3E), negative_base, sil), mil);
+
+    const __m256i ril = _mm256_srli_epi16(il, 2);
+    const __m256i dlt = ScaledMultLanes(band.det, LookupLanes(ril, tables.invqal));
+    const __m256i nbpl = _mm256_adds_epi16(ScaledMultLanes(band.nb, _mm256_set1_epi16(32512)), LookupLanes(ril, tables.logscl));
+    band.nb = _mm256_min_epi16(_mm256_max_epi16(nbpl, _mm256_setzero_si256()), _mm256_set1_epi16(18432));
+    band.det = ScaleFactorLanes(_mm256_add_epi16(_mm256_srli_epi16(band.nb, 6), _mm256_set1_epi16(64)), tables.scale_factors);
+    AdaptLanes(band, dlt);
+
+    return il;
+}
+
+/**
+ * @brief HsbCod() of each lane
+ */
+__attribute__((target("avx2"))) __m256i UpperBandLanes(AdpcmLanes& band, __m256i xh, const AdpcmTables& tables)
+{
+    const __m256i eh = _mm256_subs_epi16(xh, band.s);
+    const __m256i sih = _mm256_srai_epi16(eh, 15);
+    const __m256i wd = _mm256_xor_si256(eh, sih);
+
+    // misih, ih is 2 or 3 if eh is positive and 0 or 1 if it is negative, the latter when wd is below threshold
+    const __m256i below = _mm256_cmpgt_epi16(_mm256_mulhi_epu16(_mm256_set1_epi16(564 << 4), band.det), wd);
+    const __m256i ih = _mm256_sub_epi16(_mm256_add_epi16(_mm256_set1_epi16(2), _mm256_add_epi16(sih, sih)), below);
+
+    const __m256i dh = ScaledMultLanes(LookupLanes(ih, tables.invqah), band.det);
+    const __m256i nbph = _mm256_adds_epi16(ScaledMultLanes(band.nb, _mm256_set1_epi16(32512)), LookupLanes(ih, tables.logsch));
+    band.nb = _mm256_min_epi16(_mm256_max_epi16(nbph, _mm256_setzero_si256()), _mm256_set1_epi16(22528));
+    band.det = ScaleFactorLanes(_mm256_srli_epi16(band.nb, 6), tables.scale_factors);
+    AdaptLanes(band, dh);
+
+    return ih;
+}
+#endif
+} // namespace
+
 int G722EncoderType::SaturateAdd(int op1, int op2)
 {
     int out = op1 + op2;
@@ -308,39 +851,141 @@ short int G722EncoderType::Filtep(short int* rlt_ptr, short int* al_ptr) const
     return SaturateAddShort(wd1, wd2);
 }
 
-void G722EncoderType::QmfTx(short int xin0, short int xin1, short int& xl, short int& xh)
+void G722QmfTxScalar(const short int* pcm_data_ptr,
+                     unsigned int number_of_pairs,
+                     short int* delay_line_ptr,
+                     short int* low_band_ptr,
+                     short int* high_band_ptr)
+{
+    for (; number_of_pairs; --number_of_pairs) {
+        int accuma;
+        int accumb;
+        int comp_low;
+        int comp_high;
+
+        const short int* pcoef = coef_qmf;
+        short int* pdelayx = delay_line_ptr;
+
+        /* Saving past samples in delay line */
+        delay_line_ptr[1] = *pcm_data_ptr++;
+        delay_line_ptr[0] = *pcm_data_ptr++;
+
+        accuma = ((int)*pcoef++) * ((int)*pdelayx++);
+        accumb = ((int)*pcoef++) * ((int)*pdelayx++);
+
+        for (short int i = 1; i < 12; i++) {
+            accuma = G722EncoderType::MultiplyAdd(accuma, *pcoef++, *pdelayx++);
+            accumb = G722EncoderType::MultiplyAdd(accumb, *pcoef++, *pdelayx++);
+        }
+
+        /* Descaling and shift of the delay line */
+        for (short int i = 0; i < 22; i++)
+            delay_line_ptr[23 - i] = delay_line_ptr[21 - i];
+
+        comp_low = G722EncoderType::SaturateAdd(accuma, accumb);
+        comp_low = G722EncoderType::SaturateAdd(comp_low, comp_low);
+        comp_high = G722EncoderType::SaturateSubtract(accuma, accumb);
+        comp_high = G722EncoderType::SaturateAdd(comp_high, comp_high);
+        *low_band_ptr++ = G722EncoderType::Clamp15ToBits(G722EncoderType::ShiftRight(comp_low, 16));
+        *high_band_ptr++ = G722EncoderType::Clamp15ToBits(G722EncoderType::ShiftRight(comp_high, 16));
+    }
+}
+
+#if defined(G722_QMF_SIMD)
+void G722QmfTxSse2(const short int* pcm_data_ptr,
+                   unsigned int number_of_pairs,
+                   short int* delay_line_ptr,
+                   short int* low_band_ptr,
+                   short int* high_band_ptr)
+{
+    QmfTxOverWindow<&QmfTxGroupsSse2, 4>(pcm_data_ptr, number_of_pairs, delay_line_ptr, low_band_ptr, high_band_ptr);
+}
+
+void G722QmfTxAvx2(const short int* pcm_data_ptr,
+                   unsigned int number_of_pairs,
+                   short int* delay_line_ptr,
+                   short int* low_band_ptr,
+                   short int* high_band_ptr)
+{
+    QmfTxOverWindow<&QmfTxGroupsAvx2, 8>(pcm_data_ptr, number_of_pairs, delay_line_ptr, low_band_ptr, high_band_ptr);
+}
+
+void G722QmfTxAvx512(const short int* pcm_data_ptr,
+                     unsigned int number_of_pairs,
+                     short int* delay_line_ptr,
+                     short int* low_band_ptr,
+                     short int* high_band_ptr)
 {
-    int accuma;
-    int accumb;
-    int comp_low;
-    int comp_high;
+    QmfTxOverWindow<&QmfTxGroupsAvx512, 16>(pcm_data_ptr, number_of_pairs, delay_line_ptr, low_band_ptr, high_band_ptr);
+}
+#endif
 
-    const short int* pcoef = coef_qmf;
-    short int* pdelayx = band.qmf_tx_delayx;
+void G722EncodeBatchScalar(G722EncoderType* const* encoders,
+                           const short int* const* pcm_data_ptrs,
+                           unsigned char* const* encoded_data_ptrs,
+                           unsigned int number_of_encoders)
+{
+    for (unsigned int k = 0; k < number_of_encoders; ++k) {
+        encoders[k]->Encode(pcm_data_ptrs[k], encoded_data_ptrs[k]);
+    }
+}
 
-    /* Saving past samples in delay line */
-    band.qmf_tx_delayx[1] = xin1;
-    band.qmf_tx_delayx[0] = xin0;
+#if defined(G722_BATCH_AVX2)
+__attribute__((target("avx2"))) void G722EncodeBatchAvx2(G722EncoderType* const* encoders,
+                                                         const short int* const* pcm_data_ptrs,
+                                                         unsigned char* const* encoded_data_ptrs,
+                                                         unsigned int number_of_encoders)
+{
+    const unsigned int number_of_codes = G722_PACKET_SIZE / 2;
 
-    accuma = ((int)*pcoef++) * ((int)*pdelayx++);
-    accumb = ((int)*pcoef++) * ((int)*pdelayx++);
+    // lanes that have no encoder run on memory of first encoder, their codes and memories are dropped
+    FullBandType* bands[G722_BATCH_LANES];
+    for (unsigned int k = 0; k < G722_BATCH_LANES; ++k) {
+        bands[k] = &encoders[(k < number_of_encoders) ? k : 0]->band;
+    }
 
-    for (short int i = 1; i < 12; i++) {
-        accuma = MultiplyAdd(accuma, *pcoef++, *pdelayx++);
-        accumb = MultiplyAdd(accumb, *pcoef++, *pdelayx++);
+    // a row holds a band sample of every lane
+    alignas(32) short int low_band[number_of_codes][G722_BATCH_LANES];
+    alignas(32) short int high_band[number_of_codes][G722_BATCH_LANES];
+    short int xl[number_of_codes];
+    short int xh[number_of_codes];
+    const Kernels& kernels = KernelRegistry::Get();
+    for (unsigned int k = 0; k < G722_BATCH_LANES; ++k) {
+        if (k < number_of_encoders) {
+            kernels.g722QmfTx(pcm_data_ptrs[k], number_of_codes, bands[k]->qmf_tx_delayx, xl, xh);
+        }
+        for (unsigned int index = 0; index < number_of_codes; ++index) {
+            low_band[index][k] = xl[index];
+            high_band[index][k] = xh[index];
+        }
     }
 
-    /* Descaling and shift of the delay line */
-    for (short int i = 0; i < 22; i++)
-        band.qmf_tx_delayx[23 - i] = band.qmf_tx_delayx[21 - i];
+    const AdpcmTables& tables = GetAdpcmTables();
+    AdpcmLanes lower_band;
+    AdpcmLanes upper_band;
+    LoadBand(lower_band, bands, lower_band_offsets);
+    LoadBand(upper_band, bands, upper_band_offsets);
+
+    alignas(16) unsigned char codes[number_of_codes][G722_BATCH_LANES];
+    for (unsigned int index = 0; index < number_of_codes; ++index) {
+        const __m256i il = LowerBandLanes(lower_band, _mm256_load_si256(reinterpret_cast<const __m256i*>(low_band[index])), tables);
+        const __m256i ih = UpperBandLanes(upper_band, _mm256_load_si256(reinterpret_cast<const __m256i*>(high_band[index])), tables);
+
+        // ih in bits 6 and 7, il in bits 0 to 5, packed to a byte per lane
+        const __m256i code = _mm256_or_si256(_mm256_slli_epi16(ih, 6), il);
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(code, code), 0x08);
+        _mm_store_si128(reinterpret_cast<__m128i*>(codes[index]), _mm256_castsi256_si128(packed));
+    }
 
-    comp_low = SaturateAdd(accuma, accumb);
-    comp_low = SaturateAdd(comp_low, comp_low);
-    comp_high = SaturateSubtract(accuma, accumb);
-    comp_high = SaturateAdd(comp_high, comp_high);
-    xl = Clamp15ToBits(ShiftRight(comp_low, 16));
-    xh = Clamp15ToBits(ShiftRight(comp_high, 16));
+    StoreBand(lower_band, bands, number_of_encoders, lower_band_offsets);
+    StoreBand(upper_band, bands, number_of_encoders, upper_band_offsets);
+    for (unsigned int k = 0; k < number_of_encoders; ++k) {
+        for (unsigned int index = 0; index < number_of_codes; ++index) {
+            encoded_data_ptrs[k][index] = codes[index][k];
+        }
+    }
 }
+#endif
 
 short int G722EncoderType::LsbCod(short int xl)
 {
@@ -395,7 +1040,7 @@ void G722EncoderType::ResetBand()
     band.nbl = 0;
     band.nbh = 0;
 
-    for (int i = 0; i < 2; i++) {
+    for (int i = 0; i < 3; i++) {
         band.al[i] = 0;
         band.ah[i] = 0;
         band.plt[i] = 0;
@@ -438,22 +1083,17 @@ bool G722EncoderType ::Encode(const short int* pcm_data_ptr, unsigned char* enco
         return false;
     }
 
-    short int xl;
-    short int xh;
-
-    for (unsigned int index = 0; index < G722_PACKET_SIZE; index += 2) {
-        short int xin1 = *pcm_data_ptr++;
-        short int xin0 = *pcm_data_ptr++;
-
-        // Calculation of the synthesis QMF samples
-        // qmf_tx (xin0, xin1, &xl, &xh, encoder);
-        QmfTx(xin0, xin1, xl, xh);
+    // Calculation of the synthesis QMF samples of whole packet, band encoders below do not feed back into QMF
+    short int xl[G722_PACKET_SIZE / 2];
+    short int xh[G722_PACKET_SIZE / 2];
+    KernelRegistry::Get().g722QmfTx(pcm_data_ptr, G722_PACKET_SIZE / 2, band.qmf_tx_delayx, xl, xh);
 
+    for (unsigned int index = 0; index < G722_PACKET_SIZE / 2; ++index) {
         // Call the upper and lower band ADPCM encoders
         // il = lsbcod (xl, 0, encoder);
-        short int il = LsbCod(xl);
+        short int il = LsbCod(xl[index]);
         // ih = hsbcod (xh, 0, encoder);
-        short int ih = HsbCod(xh);
+        short int ih = HsbCod(xh[index]);
 
         // Mount the output G722 codeword: bits 0 to 5 are the lower-band
         // portion of the encoding, and bits 6 and 7 are the upper-band
@@ -466,4 +1106,30 @@ bool G722EncoderType ::Encode(const short int* pcm_data_ptr, unsigned char* enco
 
     return true;
 }
+
+bool G722EncoderType::EncodeBatch(G722EncoderType* const* encoders,
+                                  const short int* const* pcm_data_ptrs,
+                                  unsigned char* const* encoded_data_ptrs,
+                                  unsigned int number_of_encoders)
+{
+    if (!encoders || !pcm_data_ptrs || !encoded_data_ptrs) {
+        std::cerr << __FILE__ << " " << __LINE__ << "encoders, pcm_data_ptrs or encoded_data_ptrs is null" << std::endl;
+        return false;
+    }
+
+    for (unsigned int k = 0; k < number_of_encoders; ++k) {
+        if (!encoders[k] || !pcm_data_ptrs[k] || !encoded_data_ptrs[k]) {
+            std::cerr << __FILE__ << " " << __LINE__ << "encoder, pcm or encoded data " << k << " of batch is null" << std::endl;
+            return false;
+        }
+    }
+
+    const Kernels& kernels = KernelRegistry::Get();
+    for (unsigned int first = 0; first < number_of_encoders; first += G722_BATCH_LANES) {
+        const unsigned int size = std::min(number_of_encoders - first, (unsigned int)G722_BATCH_LANES);
+        kernels.g722EncodeBatch(encoders + first, pcm_data_ptrs + first, encoded_data_ptrs + first, size);
+    }
+
+    return true;
+}
 } // namespace ddgen
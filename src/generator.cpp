@@ -1,4 +1,5 @@
 #include "generator.h"
+#include "KernelRegistry.h"
 
 #include <chrono>
 #include <climits>
@@ -6,8 +7,267 @@
 #include <math.h>
 #include <random>
 
+#if defined(TONE_GENERATE_SIMD)
+#include <immintrin.h>
+#endif
+
 namespace ddgen {
 
+namespace {
+/**
+ * @brief Rotate oscillator to its next block, simd kernels do the same operations in the same order
+ */
+void AdvanceToneOscillator(ToneOscillator& oscillator)
+{
+    for (unsigned int k = 0; k < TONE_OSCILLATOR_LANES; ++k) {
+        const double cosine = oscillator.cosine[k] * oscillator.stepCosine - oscillator.sine[k] * oscillator.stepSine;
+        oscillator.sine[k] = oscillator.sine[k] * oscillator.stepCosine + oscillator.cosine[k] * oscillator.stepSine;
+        oscillator.cosine[k] = cosine;
+    }
+
+    if (TONE_RENORMALIZE_BLOCKS == ++oscillator.blocks) {
+        // a newton step of 1 / sqrt(cos^2 + sin^2), magnitude is within rounding of 1
+        for (unsigned int k = 0; k < TONE_OSCILLATOR_LANES; ++k) {
+            const double correction = 1.5 - 0.5 * (oscillator.cosine[k] * oscillator.cosine[k] + oscillator.sine[k] * oscillator.sine[k]);
+            oscillator.cosine[k] *= correction;
+            oscillator.sine[k] *= correction;
+        }
+        oscillator.blocks = 0;
+    }
+}
+
+/**
+ * @brief Start next block at a lane of current block, after first lane samples of it are used
+ */
+void RebaseToneOscillator(ToneOscillator& oscillator, unsigned int lane)
+{
+    const double cosine = oscillator.cosine[lane];
+    const double sine = oscillator.sine[lane];
+    for (unsigned int k = 0; k < TONE_OSCILLATOR_LANES; ++k) {
+        oscillator.cosine[k] = cosine * oscillator.laneCosine[k] - sine * oscillator.laneSine[k];
+        oscillator.sine[k] = sine * oscillator.laneCosine[k] + cosine * oscillator.laneSine[k];
+    }
+}
+
+/**
+ * @brief Sample of a lane of next block of oscillator
+ */
+short int GetToneSample(const ToneOscillator& oscillator, unsigned int lane)
+{
+    return (short int)(oscillator.gain * oscillator.sine[lane]);
+}
+} // namespace
+
+void SeedToneOscillator(ToneOscillator& oscillator, float amplitude, float frequency, double phase)
+{
+    const double frequency_cosine = cos((double)frequency);
+    const double frequency_sine = sin((double)frequency);
+
+    // lanes are a chain of rotations by frequency
+    oscillator.laneCosine[0] = 1;
+    oscillator.laneSine[0] = 0;
+    for (unsigned int k = 1; k < TONE_OSCILLATOR_LANES; ++k) {
+        oscillator.laneCosine[k] = oscillator.laneCosine[k - 1] * frequency_cosine - oscillator.laneSine[k - 1] * frequency_sine;
+        oscillator.laneSine[k] = oscillator.laneSine[k - 1] * frequency_cosine + oscillator.laneCosine[k - 1] * frequency_sine;
+    }
+
+    // step is rotation by frequency squared till it spans the lanes
+    double step_cosine = frequency_cosine;
+    double step_sine = frequency_sine;
+    for (unsigned int k = 1; k < TONE_OSCILLATOR_LANES; k <<= 1) {
+        const double squared_cosine = step_cosine * step_cosine - step_sine * step_sine;
+        step_sine = 2 * step_cosine * step_sine;
+        step_cosine = squared_cosine;
+    }
+    oscillator.stepCosine = step_cosine;
+    oscillator.stepSine = step_sine;
+
+    oscillator.gain = (double)amplitude * SHRT_MAX;
+    oscillator.blocks = 0;
+
+    oscillator.cosine[0] = cos(phase);
+    oscillator.sine[0] = sin(phase);
+    RebaseToneOscillator(oscillator, 0);
+}
+
+void GenerateToneScalar(short int* pcm_data_ptr, unsigned int size, ToneOscillator& oscillator)
+{
+    for (; TONE_OSCILLATOR_LANES <= size; size -= TONE_OSCILLATOR_LANES) {
+        for (unsigned int lane = 0; lane < TONE_OSCILLATOR_LANES; ++lane) {
+            *pcm_data_ptr++ = GetToneSample(oscillator, lane);
+        }
+        AdvanceToneOscillator(oscillator);
+    }
+
+    if (size) {
+        for (unsigned int lane = 0; lane < size; ++lane) {
+            *pcm_data_ptr++ = GetToneSample(oscillator, lane);
+        }
+        RebaseToneOscillator(oscillator, size);
+    }
+}
+
+#if defined(TONE_GENERATE_SIMD)
+namespace {
+/**
+ * @brief Rotate lanes to next block with the operations of AdvanceToneOscillator(), lanes are kept in registers
+ */
+__attribute__((target("sse2"))) inline void RotateLanesSse2(__m128d& cosine, __m128d& sine, __m128d step_cosine, __m128d step_sine, bool renormalize)
+{
+    __m128d next_cosine = _mm_sub_pd(_mm_mul_pd(cosine, step_cosine), _mm_mul_pd(sine, step_sine));
+    __m128d next_sine = _mm_add_pd(_mm_mul_pd(sine, step_cosine), _mm_mul_pd(cosine, step_sine));
+    if (renormalize) {
+        const __m128d magnitude = _mm_add_pd(_mm_mul_pd(next_cosine, next_cosine), _mm_mul_pd(next_sine, next_sine));
+        const __m128d correction = _mm_sub_pd(_mm_set1_pd(1.5), _mm_mul_pd(_mm_set1_pd(0.5), magnitude));
+        next_cosine = _mm_mul_pd(next_cosine, correction);
+        next_sine = _mm_mul_pd(next_sine, correction);
+    }
+    cosine = next_cosine;
+    sine = next_sine;
+}
+
+__attribute__((target("avx2"))) inline void RotateLanesAvx2(__m256d& cosine, __m256d& sine, __m256d step_cosine, __m256d step_sine, bool renormalize)
+{
+    __m256d next_cosine = _mm256_sub_pd(_mm256_mul_pd(cosine, step_cosine), _mm256_mul_pd(sine, step_sine));
+    __m256d next_sine = _mm256_add_pd(_mm256_mul_pd(sine, step_cosine), _mm256_mul_pd(cosine, step_sine));
+    if (renormalize) {
+        const __m256d magnitude = _mm256_add_pd(_mm256_mul_pd(next_cosine, next_cosine), _mm256_mul_pd(next_sine, next_sine));
+        const __m256d correction = _mm256_sub_pd(_mm256_set1_pd(1.5), _mm256_mul_pd(_mm256_set1_pd(0.5), magnitude));
+        next_cosine = _mm256_mul_pd(next_cosine, correction);
+        next_sine = _mm256_mul_pd(next_sine, correction);
+    }
+    cosine = next_cosine;
+    sine = next_sine;
+}
+
+__attribute__((target("avx512f"))) inline void
+RotateLanesAvx512(__m512d& cosine, __m512d& sine, __m512d step_cosine, __m512d step_sine, bool renormalize)
+{
+    __m512d next_cosine = _mm512_sub_pd(_mm512_mul_pd(cosine, step_cosine), _mm512_mul_pd(sine, step_sine));
+    __m512d next_sine = _mm512_add_pd(_mm512_mul_pd(sine, step_cosine), _mm512_mul_pd(cosine, step_sine));
+    if (renormalize) {
+        const __m512d magnitude = _mm512_add_pd(_mm512_mul_pd(next_cosine, next_cosine), _mm512_mul_pd(next_sine, next_sine));
+        const __m512d correction = _mm512_sub_pd(_mm512_set1_pd(1.5), _mm512_mul_pd(_mm512_set1_pd(0.5), magnitude));
+        next_cosine = _mm512_mul_pd(next_cosine, correction);
+        next_sine = _mm512_mul_pd(next_sine, correction);
+    }
+    cosine = next_cosine;
+    sine = next_sine;
+}
+
+/**
+ * @brief Trailing partial block, same as GenerateToneScalar() gives
+ */
+void GenerateTonePartialBlock(short int* pcm_data_ptr, unsigned int size, ToneOscillator& oscillator)
+{
+    if (size) {
+        for (unsigned int lane = 0; lane < size; ++lane) {
+            pcm_data_ptr[lane] = GetToneSample(oscillator, lane);
+        }
+        RebaseToneOscillator(oscillator, size);
+    }
+}
+} // namespace
+
+// kernels below hold the 8 lanes of a block in registers
+static_assert(8 == TONE_OSCILLATOR_LANES, "simd tone kernels expect 8 lanes");
+
+__attribute__((target("sse2"))) void GenerateToneSse2(short int* pcm_data_ptr, unsigned int size, ToneOscillator& oscillator)
+{
+    __m128d cosine0 = _mm_loadu_pd(oscillator.cosine);
+    __m128d cosine1 = _mm_loadu_pd(oscillator.cosine + 2);
+    __m128d cosine2 = _mm_loadu_pd(oscillator.cosine + 4);
+    __m128d cosine3 = _mm_loadu_pd(oscillator.cosine + 6);
+    __m128d sine0 = _mm_loadu_pd(oscillator.sine);
+    __m128d sine1 = _mm_loadu_pd(oscillator.sine + 2);
+    __m128d sine2 = _mm_loadu_pd(oscillator.sine + 4);
+    __m128d sine3 = _mm_loadu_pd(oscillator.sine + 6);
+    const __m128d step_cosine = _mm_set1_pd(oscillator.stepCosine);
+    const __m128d step_sine = _mm_set1_pd(oscillator.stepSine);
+    const __m128d gain = _mm_set1_pd(oscillator.gain);
+
+    for (; TONE_OSCILLATOR_LANES <= size; size -= TONE_OSCILLATOR_LANES, pcm_data_ptr += TONE_OSCILLATOR_LANES) {
+        const __m128i low = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_mul_pd(gain, sine0)), _mm_cvttpd_epi32(_mm_mul_pd(gain, sine1)));
+        const __m128i high = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_mul_pd(gain, sine2)), _mm_cvttpd_epi32(_mm_mul_pd(gain, sine3)));
+        _mm_storeu_si128((__m128i*)pcm_data_ptr, _mm_packs_epi32(low, high));
+
+        const bool renormalize = (TONE_RENORMALIZE_BLOCKS == ++oscillator.blocks);
+        RotateLanesSse2(cosine0, sine0, step_cosine, step_sine, renormalize);
+        RotateLanesSse2(cosine1, sine1, step_cosine, step_sine, renormalize);
+        RotateLanesSse2(cosine2, sine2, step_cosine, step_sine, renormalize);
+        RotateLanesSse2(cosine3, sine3, step_cosine, step_sine, renormalize);
+        if (renormalize) {
+            oscillator.blocks = 0;
+        }
+    }
+
+    _mm_storeu_pd(oscillator.cosine, cosine0);
+    _mm_storeu_pd(oscillator.cosine + 2, cosine1);
+    _mm_storeu_pd(oscillator.cosine + 4, cosine2);
+    _mm_storeu_pd(oscillator.cosine + 6, cosine3);
+    _mm_storeu_pd(oscillator.sine, sine0);
+    _mm_storeu_pd(oscillator.sine + 2, sine1);
+    _mm_storeu_pd(oscillator.sine + 4, sine2);
+    _mm_storeu_pd(oscillator.sine + 6, sine3);
+    GenerateTonePartialBlock(pcm_data_ptr, size, oscillator);
+}
+
+__attribute__((target("avx2"))) void GenerateToneAvx2(short int* pcm_data_ptr, unsigned int size, ToneOscillator& oscillator)
+{
+    __m256d cosine0 = _mm256_loadu_pd(oscillator.cosine);
+    __m256d cosine1 = _mm256_loadu_pd(oscillator.cosine + 4);
+    __m256d sine0 = _mm256_loadu_pd(oscillator.sine);
+    __m256d sine1 = _mm256_loadu_pd(oscillator.sine + 4);
+    const __m256d step_cosine = _mm256_set1_pd(oscillator.stepCosine);
+    const __m256d step_sine = _mm256_set1_pd(oscillator.stepSine);
+    const __m256d gain = _mm256_set1_pd(oscillator.gain);
+
+    for (; TONE_OSCILLATOR_LANES <= size; size -= TONE_OSCILLATOR_LANES, pcm_data_ptr += TONE_OSCILLATOR_LANES) {
+        const __m128i samples = _mm_packs_epi32(_mm256_cvttpd_epi32(_mm256_mul_pd(gain, sine0)), _mm256_cvttpd_epi32(_mm256_mul_pd(gain, sine1)));
+        _mm_storeu_si128((__m128i*)pcm_data_ptr, samples);
+
+        const bool renormalize = (TONE_RENORMALIZE_BLOCKS == ++oscillator.blocks);
+        RotateLanesAvx2(cosine0, sine0, step_cosine, step_sine, renormalize);
+        RotateLanesAvx2(cosine1, sine1, step_cosine, step_sine, renormalize);
+        if (renormalize) {
+            oscillator.blocks = 0;
+        }
+    }
+
+    _mm256_storeu_pd(oscillator.cosine, cosine0);
+    _mm256_storeu_pd(oscillator.cosine + 4, cosine1);
+    _mm256_storeu_pd(oscillator.sine, sine0);
+    _mm256_storeu_pd(oscillator.sine + 4, sine1);
+    GenerateTonePartialBlock(pcm_data_ptr, size, oscillator);
+}
+
+__attribute__((target("avx512f"))) void GenerateToneAvx512(short int* pcm_data_ptr, unsigned int size, ToneOscillator& oscillator)
+{
+    // a register holds all lanes
+    __m512d cosine = _mm512_loadu_pd(oscillator.cosine);
+    __m512d sine = _mm512_loadu_pd(oscillator.sine);
+    const __m512d step_cosine = _mm512_set1_pd(oscillator.stepCosine);
+    const __m512d step_sine = _mm512_set1_pd(oscillator.stepSine);
+    const __m512d gain = _mm512_set1_pd(oscillator.gain);
+
+    for (; TONE_OSCILLATOR_LANES <= size; size -= TONE_OSCILLATOR_LANES, pcm_data_ptr += TONE_OSCILLATOR_LANES) {
+        // masked form with all lanes set, so that conversion has no undefined merge source
+        const __m256i samples = _mm512_maskz_cvttpd_epi32(0xFF, _mm512_mul_pd(gain, sine));
+        _mm_storeu_si128((__m128i*)pcm_data_ptr, _mm_packs_epi32(_mm256_castsi256_si128(samples), _mm256_extracti128_si256(samples, 1)));
+
+        const bool renormalize = (TONE_RENORMALIZE_BLOCKS == ++oscillator.blocks);
+        RotateLanesAvx512(cosine, sine, step_cosine, step_sine, renormalize);
+        if (renormalize) {
+            oscillator.blocks = 0;
+        }
+    }
+
+    _mm512_storeu_pd(oscillator.cosine, cosine);
+    _mm512_storeu_pd(oscillator.sine, sine);
+    GenerateTonePartialBlock(pcm_data_ptr, size, oscillator);
+}
+#endif
+
 bool ZeroGeneratorType::Generate(short int* pcm_data_ptr, unsigned short int size, unsigned short int duration)
 {
     for (; size; --size)
@@ -22,6 +282,7 @@ std::vector<CallParameters::StreamParameters::ToneParameters> ZeroGeneratorType:
 }
 
 SingleToneGeneratorType::SingleToneGeneratorType(float amplitude, float frequency, float phase)
+    : _periodic(false), _cycleFrequency(0), _cycleAmplitude(0), _cycleIndex(0)
 {
     // form a seed
     unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
@@ -39,30 +300,37 @@ SingleToneGeneratorType::SingleToneGeneratorType(float amplitude, float frequenc
     }
 
     // check frequency to be between 0.2PI to 0.2PI
-    if ((((0.2) * PI) < frequency) && (frequency < ((0.8) * PI)))
+    if ((((0.2) * M_PI) < frequency) && (frequency < ((0.8) * M_PI)))
         _generatorParams.frequency = frequency;
     else {
         // generate frequency between 0.2PI to 0.8PI
-        std::uniform_real_distribution<float> frequency_distribution(0.2 * PI, 0.8 * PI);
+        std::uniform_real_distribution<float> frequency_distribution(0.2 * M_PI, 0.8 * M_PI);
         _generatorParams.frequency = frequency_distribution(generator);
     }
 
     // check phase to be between -PI to PI
-    if ((-PI < phase) && (phase < PI))
+    if ((-M_PI < phase) && (phase < M_PI))
         _generatorParams.phase = phase;
     else {
         // normalize PI
-        if (phase > PI)
-            while (phase > PI)
-                phase -= 2 * PI;
+        if (phase > M_PI)
+            while (phase > M_PI)
+                phase -= 2 * M_PI;
         else
-            while (-PI > phase)
-                phase += 2 * PI;
+            while (-M_PI > phase)
+                phase += 2 * M_PI;
         _generatorParams.phase = phase;
     }
+    SeedToneOscillator(_oscillator, _generatorParams.amplitude, _generatorParams.frequency, _generatorParams.phase);
 }
 
-SingleToneGeneratorType::SingleToneGeneratorType()
+SingleToneGeneratorType::SingleToneGeneratorType(bool periodic)
+    : _periodic(periodic), _cycleFrequency(0), _cycleAmplitude(0), _cycleIndex(0)
+{
+    Reset();
+}
+
+void SingleToneGeneratorType::Reset()
 {
     // form a seed
     unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
@@ -70,17 +338,35 @@ SingleToneGeneratorType::SingleToneGeneratorType()
     // introduce generator
     std::minstd_rand generator(seed);
 
+    if (_periodic) {
+        // same ranges as below, quantized to whole cycles and amplitude levels
+        std::uniform_int_distribution<unsigned int> amplitude_distribution(TONE_AMPLITUDE_LEVELS / 5, TONE_AMPLITUDE_LEVELS * 4 / 5);
+        std::uniform_int_distribution<unsigned int> frequency_distribution(TONE_CYCLE_SAMPLES / 10, TONE_CYCLE_SAMPLES * 4 / 10);
+        std::uniform_int_distribution<unsigned int> phase_distribution(0, TONE_CYCLE_PHASES - 1);
+
+        _cycleAmplitude = amplitude_distribution(generator);
+        _cycleFrequency = frequency_distribution(generator);
+        _cycleIndex = phase_distribution(generator) * (TONE_CYCLE_SAMPLES / TONE_CYCLE_PHASES);
+
+        _generatorParams.amplitude = (float)_cycleAmplitude / TONE_AMPLITUDE_LEVELS;
+        _generatorParams.frequency = 2 * M_PI * _cycleFrequency / TONE_CYCLE_SAMPLES;
+        _generatorParams.phase = 0;
+        return;
+    }
+
     // generate amplitude between 0.2 to 0.8
     std::uniform_real_distribution<float> amplitude_distribution(0.2, 0.8);
     _generatorParams.amplitude = amplitude_distribution(generator);
 
     // generate phase between -PI to PI
-    std::uniform_real_distribution<float> phase_distribution(-PI, PI);
+    std::uniform_real_distribution<float> phase_distribution(-M_PI, M_PI);
     _generatorParams.phase = phase_distribution(generator);
 
     // generate frequency between 0.2PI to 0.8PI
-    std::uniform_real_distribution<float> frequency_distribution(0.2 * PI, 0.8 * PI);
+    std::uniform_real_distribution<float> frequency_distribution(0.2 * M_PI, 0.8 * M_PI);
     _generatorParams.frequency = frequency_distribution(generator);
+
+    SeedToneOscillator(_oscillator, _generatorParams.amplitude, _generatorParams.frequency, _generatorParams.phase);
 }
 
 bool SingleToneGeneratorType::Generate(short int* pcm_data_ptr, unsigned short int size, unsigned short int duration)
@@ -90,21 +376,33 @@ bool SingleToneGeneratorType::Generate(short int* pcm_data_ptr, unsigned short i
         return false;
     }
 
-    for (; size; --size) {
-        *pcm_data_ptr++ = (short int)(_generatorParams.amplitude * SHRT_MAX * sin(_generatorParams.phase));
-        _generatorParams.phase += _generatorParams.frequency;
+    if (_periodic) {
+        for (; size; --size) {
+            *pcm_data_ptr++ = NextSample();
+        }
+    } else {
+        KernelRegistry::Get().generateTone(pcm_data_ptr, size, _oscillator);
     }
 
-    // normalize phase
-    while (_generatorParams.phase > PI)
-        _generatorParams.phase -= 2 * PI;
-
     return true;
 }
 
 std::vector<CallParameters::StreamParameters::ToneParameters> SingleToneGeneratorType::GetParameters() const
 {
-    return { _generatorParams };
+    if (_periodic) {
+        // phase of periodic tone follows its position in cycle, normalized between -PI to PI
+        CallParameters::StreamParameters::ToneParameters parameters = _generatorParams;
+        const unsigned int phase_index = (_cycleFrequency * _cycleIndex) % TONE_CYCLE_SAMPLES;
+        parameters.phase = 2 * M_PI * phase_index / TONE_CYCLE_SAMPLES;
+        if (parameters.phase > M_PI)
+            parameters.phase -= 2 * M_PI;
+        return { parameters };
+    }
+
+    // phase of continuous tone is carried by its oscillator
+    CallParameters::StreamParameters::ToneParameters parameters = _generatorParams;
+    parameters.phase = atan2(_oscillator.sine[0], _oscillator.cosine[0]);
+    return { parameters };
 }
 
 bool SinusoidalGeneratorType::Generate(short int* pcm_data_ptr, unsigned short int size, unsigned short int duration)
@@ -1,4 +1,5 @@
 #include "programoptions.h"
+#include "callleg.h"
 
 #include <arpa/inet.h>
 #include <cstdlib>
@@ -10,8 +11,19 @@ namespace ddgen {
 ProgramOptions::ProgramOptions(int argc, char* argv[])
     : shouldStart(true)
     , numberOfCalls(10)
+    , callsPerSecond(50)
     , callDuration(60)
     , simulationDuration(600)
+    , numberOfThreads(1)
+    , shouldSteal(false)
+    , shouldPace(false)
+    , isOffline(false)
+    , overloadPolicy(OverloadPolicy::CatchUp)
+    , maxBurst(5)
+    , lookahead(0)
+    , shouldCachePayload(true)
+    , shouldBatch(true)
+    , codec(Codec::G711a)
     , startIp(0xac186536)
     , traffic(Traffic::Mirror)
     , output(Output::Pcap)
@@ -26,12 +38,75 @@ ProgramOptions::ProgramOptions(int argc, char* argv[])
         } else if ((0 == strcmp("--nc", argv[argv_index])) && ((argv_index + 1) < argc)) {
             numberOfCalls = std::atoi(argv[argv_index + 1]);
             argv_index++;
+        } else if ((0 == strcmp("--cps", argv[argv_index])) && ((argv_index + 1) < argc)) {
+            callsPerSecond = std::atoi(argv[argv_index + 1]);
+            if (0 == callsPerSecond) {
+                callsPerSecond = 1;
+            }
+            argv_index++;
         } else if ((0 == strcmp("--dc", argv[argv_index])) && ((argv_index + 1) < argc)) {
             callDuration = std::atoi(argv[argv_index + 1]);
             argv_index++;
         } else if ((0 == strcmp("--ds", argv[argv_index])) && ((argv_index + 1) < argc)) {
             simulationDuration = std::atoi(argv[argv_index + 1]);
             argv_index++;
+        } else if ((0 == strcmp("--threads", argv[argv_index])) && ((argv_index + 1) < argc)) {
+            numberOfThreads = std::atoi(argv[argv_index + 1]);
+            if (0 == numberOfThreads) {
+                numberOfThreads = 1;
+            }
+            argv_index++;
+        } else if (0 == strcmp("--steal", argv[argv_index])) {
+            shouldSteal = true;
+        } else if (0 == strcmp("--pacing", argv[argv_index])) {
+            shouldPace = true;
+        } else if (0 == strcmp("--offline", argv[argv_index])) {
+            isOffline = true;
+        } else if ((0 == strcmp("--overload", argv[argv_index])) && ((argv_index + 1) < argc)) {
+            if (0 == strcmp("catchup", argv[argv_index + 1])) {
+                overloadPolicy = OverloadPolicy::CatchUp;
+            } else if (0 == strcmp("skip", argv[argv_index + 1])) {
+                overloadPolicy = OverloadPolicy::Skip;
+            } else if (0 == strcmp("stretch", argv[argv_index + 1])) {
+                overloadPolicy = OverloadPolicy::Stretch;
+            } else {
+                std::cout << "unknown overload policy : " << argv[argv_index + 1] << std::endl;
+                DisplayUsage();
+                exit(-1);
+            }
+            argv_index++;
+        } else if ((0 == strcmp("--max-burst", argv[argv_index])) && ((argv_index + 1) < argc)) {
+            maxBurst = std::atoi(argv[argv_index + 1]);
+            if (0 == maxBurst) {
+                maxBurst = 1;
+            }
+            argv_index++;
+        } else if ((0 == strcmp("--lookahead", argv[argv_index])) && ((argv_index + 1) < argc)) {
+            lookahead = std::atoi(argv[argv_index + 1]);
+            argv_index++;
+        } else if (0 == strcmp("--no-payload-cache", argv[argv_index])) {
+            shouldCachePayload = false;
+        } else if (0 == strcmp("--no-batch", argv[argv_index])) {
+            shouldBatch = false;
+        } else if ((0 == strcmp("--codec", argv[argv_index])) && ((argv_index + 1) < argc)) {
+            if (0 == strcmp("g711a", argv[argv_index + 1])) {
+                codec = Codec::G711a;
+            } else if (0 == strcmp("g711u", argv[argv_index + 1])) {
+                codec = Codec::G711u;
+            } else if (0 == strcmp("g722", argv[argv_index + 1])) {
+                codec = Codec::G722;
+            } else {
+                std::cout << "unknown codec : " << argv[argv_index + 1] << std::endl;
+                DisplayUsage();
+                exit(-1);
+            }
+            argv_index++;
+        } else if ((0 == strcmp("--clips", argv[argv_index])) && ((argv_index + 1) < argc)) {
+            clipDirectory = argv[argv_index + 1];
+            argv_index++;
+        } else if ((0 == strcmp("--kernel-isa", argv[argv_index])) && ((argv_index + 1) < argc)) {
+            kernelIsa = argv[argv_index + 1];
+            argv_index++;
         } else if ((0 == strcmp("--drlink", argv[argv_index])) && ((argv_index + 4) < argc)) {
             in_addr d_inaddr;
             unsigned int dst_ip = 0x691e1bac;
@@ -104,6 +179,14 @@ ProgramOptions::ProgramOptions(int argc, char* argv[])
             exit(-1);
         }
     }
+
+    // every drlink destination is a leg of each call
+    if (drlinkIpPortVector.size() > MAX_CALL_LEGS) {
+        std::cout << "--drlink is given " << drlinkIpPortVector.size() << " destinations, a call can have at most " << MAX_CALL_LEGS
+                  << " legs, so --drlink can be given at most " << MAX_CALL_LEGS / 2 << " times" << std::endl;
+        DisplayUsage();
+        exit(-1);
+    }
 }
 
 void ProgramOptions::DisplayUsage()
@@ -114,6 +197,7 @@ void ProgramOptions::DisplayUsage()
     std::cout << "to generate 10 calls each having random duration (uniform %10) of 60s" << std::endl;
     std::cout << "and send to drlink media address 192.168.126.1:28008 and 192.168.126.1:28009" << std::endl;
     std::cout << "(if omitted) default values are: 127.0.0.1 and 29000 29001" << std::endl;
+    std::cout << "--drlink may be repeated up to " << MAX_CALL_LEGS / 2 << " times, a leg is formed for every destination" << std::endl;
     std::cout << "drlink data is send to drlink socket by default. If want to save as pcap, use --pcap flag" << std::endl;
     std::cout << "ddgen --nc 10 --dc 60 --pacp --drlink 192.168.126.1 28008 192.168.126.1 28009" << std::endl;
     std::cout << " --- mirror --- " << std::endl;
@@ -126,6 +210,30 @@ void ProgramOptions::DisplayUsage()
     std::cout << "To disable db usage (in case it is build) use  --noDb" << std::endl;
     std::cout << "To force a database path use --dbPath http://localhost:8000" << std::endl;
     std::cout << "To push pcap (if any) to s3 (in case it is build with) use --useS3" << std::endl;
+    std::cout << "--- engine ---" << std::endl;
+    std::cout << "--cps 1000 creates up to 1000 calls per second till --nc calls are active (default 50)" << std::endl;
+    std::cout << "--threads 4 shards calls over 4 worker threads, each having its own consumer" << std::endl;
+    std::cout << "--steal shares work of every tick over --threads workers that steal calls from each other, instead of sharding calls"
+              << std::endl;
+    std::cout << "--pacing spreads packets of call legs evenly over packetization interval instead of sending them at start of tick" << std::endl;
+    std::cout << "--overload catchup|skip|stretch decides what happens to packets that are more than a tick late (default catchup)" << std::endl;
+    std::cout << "  catchup sends late packets in bursts of at most --max-burst 5 packets per leg per tick and defers the rest" << std::endl;
+    std::cout << "  skip drops late packets, stretch lets time of worker fall behind wall clock" << std::endl;
+    std::cout << "--lookahead 100 generates packets 100ms ahead into rings, a transmit thread sends them when they are due" << std::endl;
+    std::cout << "--no-payload-cache generates and encodes every payload, instead of reusing encoded cycles of periodic tones"
+              << std::endl;
+    std::cout << "  tones are periodic by default, frequencies are multiples of 10 Hz and amplitudes multiples of 1/50, so that"
+              << std::endl;
+    std::cout << "  encoded payloads repeat every 100ms; --no-payload-cache brings back continuous random tones of earlier releases"
+              << std::endl;
+    std::cout << "--no-batch hands packets to pcap file or socket one by one, instead of a writev or sendmmsg per tick" << std::endl;
+    std::cout << "--codec g711a|g711u|g722 encodes generated payloads of legs with given codec (default g711a)" << std::endl;
+    std::cout << "  g722 legs that are due in a tick are encoded together by batch kernels" << std::endl;
+    std::cout << "--clips ./clips plays pre encoded .pcma .pcmu and .g722 files of a directory, mapped once and shared by all legs"
+              << std::endl;
+    std::cout << "--kernel-isa scalar|sse4.2|avx2|avx512 runs checksum, codec and tone kernels of given instruction set (default best)"
+              << std::endl;
+    std::cout << "--offline generates pcap as fast as possible on a virtual clock, packets are stamped with simulated time" << std::endl;
     std::cout << "--- wait for webstart ---" << std::endl;
     std::cout << "ddgen --webConfig" << std::endl;
 }
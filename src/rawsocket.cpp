@@ -1,29 +1,145 @@
 #include "rawsocket.h"
+#include "KernelRegistry.h"
 
 #include <cstring>
 #include <iostream>
 #include <netinet/in.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 namespace ddgen {
 
-unsigned short int OnesComplementShortSummation(const unsigned char* data_ptr, unsigned short int data_size)
+namespace {
+/**
+ * @brief Fold carries of a wide host byte order sum and convert it to network byte order
+ */
+unsigned short int FoldSummation(unsigned long long int sum)
 {
-    unsigned int sum = 0;
+    while (sum >> 16) {
+        sum = (sum >> 16) + (sum & 0x0000ffff);
+    }
 
-    for (unsigned short int i = 0; i < data_size / 2; i++) {
-        sum += ntohs(*((unsigned short int*)data_ptr));
+    return ntohs((unsigned short int)sum);
+}
+
+/**
+ * @brief Add remaining bytes that a vector kernel has not covered, or all bytes in scalar kernel
+ */
+unsigned long long int SumRemainder(const unsigned char* data_ptr, unsigned int data_size, unsigned long long int sum)
+{
+    // 2^16 is 1 in ones complement arithmetic, so a 32 bit word adds as its two 16 bit halves
+    for (; data_size >= 4; data_size -= 4, data_ptr += 4) {
+        unsigned int word;
+        std::memcpy(&word, data_ptr, sizeof(word));
+        sum += word;
+    }
+
+    if (data_size >= 2) {
+        unsigned short int word;
+        std::memcpy(&word, data_ptr, sizeof(word));
+        sum += word;
         data_ptr += 2;
+        data_size -= 2;
     }
 
-    if (data_size % 2)
-        sum += *data_ptr;
+    if (data_size) {
+        // last character is the higher byte in network order, padded with zero
+        const unsigned char padded[2] = { *data_ptr, 0 };
+        unsigned short int word;
+        std::memcpy(&word, padded, sizeof(word));
+        sum += word;
+    }
 
-    // sum carry
-    sum = (sum >> 16) + (sum & 0x0000ffff);
+    return sum;
+}
+} // namespace
 
-    return (unsigned short int)sum;
+unsigned short int OnesComplementShortSummation(const unsigned char* data_ptr, unsigned short int data_size)
+{
+    return KernelRegistry::Get().onesComplementShortSummation(data_ptr, data_size);
+}
+
+unsigned short int OnesComplementShortSummationScalar(const unsigned char* data_ptr, unsigned short int data_size)
+{
+    return FoldSummation(SumRemainder(data_ptr, data_size, 0));
 }
 
+#if defined(ONES_COMPLEMENT_SIMD)
+__attribute__((target("sse2"))) unsigned short int OnesComplementShortSummationSse2(const unsigned char* data_ptr, unsigned short int data_size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lanes = zero;
+
+    // a lane gets at most 2 words per 16 bytes, so 32 bit lanes can not overflow for a 16 bit data size
+    unsigned int remaining = data_size;
+    for (; remaining >= 16; remaining -= 16, data_ptr += 16) {
+        const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data_ptr));
+        lanes = _mm_add_epi32(lanes, _mm_unpacklo_epi16(words, zero));
+        lanes = _mm_add_epi32(lanes, _mm_unpackhi_epi16(words, zero));
+    }
+
+    unsigned int lane_sums[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lane_sums), lanes);
+
+    unsigned long long int sum = 0;
+    for (unsigned int lane_sum : lane_sums) {
+        sum += lane_sum;
+    }
+
+    return FoldSummation(SumRemainder(data_ptr, remaining, sum));
+}
+
+__attribute__((target("avx2"))) unsigned short int OnesComplementShortSummationAvx2(const unsigned char* data_ptr, unsigned short int data_size)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lanes = zero;
+
+    // unpack works within 128 bit halves, which does not matter as all lanes are added at the end
+    unsigned int remaining = data_size;
+    for (; remaining >= 32; remaining -= 32, data_ptr += 32) {
+        const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data_ptr));
+        lanes = _mm256_add_epi32(lanes, _mm256_unpacklo_epi16(words, zero));
+        lanes = _mm256_add_epi32(lanes, _mm256_unpackhi_epi16(words, zero));
+    }
+
+    unsigned int lane_sums[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_sums), lanes);
+
+    unsigned long long int sum = 0;
+    for (unsigned int lane_sum : lane_sums) {
+        sum += lane_sum;
+    }
+
+    return FoldSummation(SumRemainder(data_ptr, remaining, sum));
+}
+
+__attribute__((target("avx512f,avx512bw"))) unsigned short int OnesComplementShortSummationAvx512(const unsigned char* data_ptr,
+                                                                                                 unsigned short int data_size)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i lanes = zero;
+
+    unsigned int remaining = data_size;
+    for (; remaining >= 64; remaining -= 64, data_ptr += 64) {
+        const __m512i words = _mm512_loadu_si512(data_ptr);
+        lanes = _mm512_add_epi32(lanes, _mm512_unpacklo_epi16(words, zero));
+        lanes = _mm512_add_epi32(lanes, _mm512_unpackhi_epi16(words, zero));
+    }
+
+    unsigned int lane_sums[16];
+    _mm512_storeu_si512(lane_sums, lanes);
+
+    unsigned long long int sum = 0;
+    for (unsigned int lane_sum : lane_sums) {
+        sum += lane_sum;
+    }
+
+    return FoldSummation(SumRemainder(data_ptr, remaining, sum));
+}
+#endif
+
 // *************************************** RtpHeaderType *********************************************
 
 bool RtpHeaderType::ReadFromBuffer(const unsigned char* buffer_ptr)
@@ -272,7 +388,12 @@ bool UdpHeaderType::UpdateChecksumWriteToBuffer(unsigned char* buffer_ptr,
 
     // calculate checksum
     sum += OnesComplementShortSummation(buffer_ptr, udp_header_size);
-    checksum = ~(((sum >> 16) + (sum & 0x0000ffff)));
+    sum = (sum >> 16) + (sum & 0x0000ffff);
+    checksum = ~((sum >> 16) + (sum & 0x0000ffff));
+
+    // a zero checksum means no checksum in udp, so it is sent as 0xffff
+    if (0 == checksum)
+        checksum = 0xffff;
 
     // write it also into buffer_ptr
     *((unsigned short int*)(buffer_ptr + 6)) = htons(checksum);
@@ -329,6 +450,7 @@ bool CheckUdpChecksum(const unsigned char* line_udp_packet_ptr, const PseudoIpv4
 
     sum += OnesComplementShortSummation(line_udp_packet_ptr, ntohs(*((unsigned short int*)(line_udp_packet_ptr + 4))));
 
+    sum = (sum >> 16) + (sum & 0x0000ffff);
     return ((unsigned short int)((sum >> 16) + (sum & 0x0000ffff)) == 0xffff);
 }
 